@@ -0,0 +1,70 @@
+"""
+Builds smbc, the Python module over the DSP engine (see smbc_module.cpp).
+
+It compiles Source/DSP and the JUCE modules the engine needs straight into the
+extension, so it needs:
+  - Core/JuceLibraryCode, which the Projucer writes when Core/SimpleMBCompCore.jucer is saved
+  - the JUCE modules folder, in JUCE_MODULES (defaults to the path the .jucer files use)
+
+    JUCE_MODULES=~/JUCE/modules pip install ./SimpleMBComp/Python
+"""
+
+import glob
+import os
+import sys
+
+from setuptools import Extension, setup
+
+here = os.path.dirname(os.path.abspath(__file__))
+project = os.path.dirname(here)
+library_code = os.path.join(project, "Core", "JuceLibraryCode")
+juce_modules = os.environ.get("JUCE_MODULES", os.path.expanduser("~/Downloads/JUCE/modules"))
+
+if not os.path.isdir(library_code):
+    sys.exit("Core/JuceLibraryCode is missing, save Core/SimpleMBCompCore.jucer in the Projucer first")
+
+# the plugin's parameter names aren't part of the engine
+dsp_sources = [f for f in sorted(glob.glob(os.path.join(project, "Source", "DSP", "*.cpp")))
+               if os.path.basename(f) != "Params.cpp"]
+
+module_sources = sorted(glob.glob(os.path.join(library_code, "include_juce_*.cpp")))
+
+# the DSP only renders the same on every instruction set with contraction off, see CpuDispatch.h
+if sys.platform == "darwin":
+    # JUCE's modules are Objective-C++ on macOS, and distutils doesn't know .mm
+    compile_args = ["-ObjC++", "-std=c++17", "-O3", "-fvisibility=hidden", "-ffp-contract=off"]
+    link_args = [arg for framework in ("Accelerate", "AudioToolbox", "CoreAudio", "CoreFoundation", "CoreMIDI", "Foundation", "IOKit")
+                 for arg in ("-framework", framework)]
+    libraries = []
+elif sys.platform == "win32":
+    compile_args = ["/std:c++17", "/O2", "/EHsc"]
+    link_args = []
+    libraries = []
+else:
+    compile_args = ["-std=c++17", "-O3", "-fvisibility=hidden", "-ffp-contract=off"]
+    link_args = []
+    libraries = ["dl", "pthread"]
+
+smbc = Extension(
+    "smbc",
+    sources=[os.path.join(here, "smbc_module.cpp")] + dsp_sources + module_sources,
+    include_dirs=[library_code, juce_modules],
+    define_macros=[
+        ("NDEBUG", "1"),
+        ("JUCE_GLOBAL_MODULE_SETTINGS_INCLUDED", "1"),
+        ("JUCE_STANDALONE_APPLICATION", "0"),
+        ("JUCE_USE_CURL", "0"),
+        ("JUCE_WEB_BROWSER", "0"),
+    ],
+    extra_compile_args=compile_args,
+    extra_link_args=link_args,
+    libraries=libraries,
+    language="c++",
+)
+
+setup(
+    name="smbc",
+    version="1.0.0",
+    description="SimpleMBComp's multiband compressor over NumPy arrays",
+    ext_modules=[smbc],
+)
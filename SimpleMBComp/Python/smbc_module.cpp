@@ -0,0 +1,506 @@
+/*
+  ==============================================================================
+
+    smbc_module.cpp
+
+  ==============================================================================
+*/
+
+/*
+ The smbc Python module: MultibandCompressor over NumPy arrays, through the C API.
+     
+     import numpy as np, smbc
+     clips = np.zeros((1000, 2, 48000), dtype=np.float32) # clips, channels, samples
+     latencies = smbc.process(clips, 48000, mid_threshold_db=np.random.uniform(-40, 0, 1000), limiter=1)
+ 
+ process() works in place on anything with a writable buffer of float32 or float64,
+ (channels, samples) or (clips, channels, samples), as long as each channel's samples are
+ contiguous. Nothing is copied, float64 runs the double precision chain. Every parameter of
+ smbc_parameters is a keyword, band ones prefixed low_, mid_ or high_, and takes either one
+ value for every clip or a sequence of one per clip. Clips with the same parameters are
+ rendered together as streams of one engine, so they share its lanes. The GIL is released
+ while the audio is processed, so several Python threads can each process their own arrays.
+ 
+ The output is the plugin's, latency included: it's delayed by the latency process() returns.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "../Source/DSP/MultibandCompressorC.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+    // a prepare's worth of streams, so a big batch never holds every clip's DSP state at once
+    constexpr int maxStreamsPerPrepare = 256;
+    constexpr int maxChannels = 16;
+    
+    struct Field
+    {
+        std::string name;
+        size_t offset;
+        bool isInt;
+    };
+    
+    std::vector<Field> fields;
+    
+    void addBandFields()
+    {
+        struct BandField { const char* name; size_t offset; bool isInt; };
+        
+        const BandField bandFields[] =
+        {
+            { "attack_ms", offsetof(smbc_band_parameters, attack_ms), false },
+            { "release_ms", offsetof(smbc_band_parameters, release_ms), false },
+            { "threshold_db", offsetof(smbc_band_parameters, threshold_db), false },
+            { "ratio", offsetof(smbc_band_parameters, ratio), false },
+            { "side_attack_ms", offsetof(smbc_band_parameters, side_attack_ms), false },
+            { "side_release_ms", offsetof(smbc_band_parameters, side_release_ms), false },
+            { "side_threshold_db", offsetof(smbc_band_parameters, side_threshold_db), false },
+            { "side_ratio", offsetof(smbc_band_parameters, side_ratio), false },
+            { "bypass", offsetof(smbc_band_parameters, bypass), true },
+            { "mute", offsetof(smbc_band_parameters, mute), true },
+            { "solo", offsetof(smbc_band_parameters, solo), true },
+            { "lookahead_ms", offsetof(smbc_band_parameters, lookahead_ms), false },
+            { "detector", offsetof(smbc_band_parameters, detector), true },
+            { "detector_window_ms", offsetof(smbc_band_parameters, detector_window_ms), false },
+            { "oversampling", offsetof(smbc_band_parameters, oversampling), true },
+            { "mix", offsetof(smbc_band_parameters, mix), false },
+        };
+        
+        const char* bandNames[] = { "low_", "mid_", "high_" };
+        
+        for(size_t band = 0; band < 3; ++band)
+        {
+            for(auto& field : bandFields)
+            {
+                auto offset = offsetof(smbc_parameters, bands) + band * sizeof(smbc_band_parameters) + field.offset;
+                fields.push_back({ std::string(bandNames[band]) + field.name, offset, field.isInt });
+            }
+        }
+    }
+    
+    void addFields()
+    {
+        addBandFields();
+        
+        fields.push_back({ "low_mid_crossover_hz", offsetof(smbc_parameters, low_mid_crossover_hz), false });
+        fields.push_back({ "mid_high_crossover_hz", offsetof(smbc_parameters, mid_high_crossover_hz), false });
+        fields.push_back({ "crossover_slope", offsetof(smbc_parameters, crossover_slope), true });
+        fields.push_back({ "input_gain_db", offsetof(smbc_parameters, input_gain_db), false });
+        fields.push_back({ "output_gain_db", offsetof(smbc_parameters, output_gain_db), false });
+        fields.push_back({ "mix", offsetof(smbc_parameters, mix), false });
+        fields.push_back({ "link_channels", offsetof(smbc_parameters, link_channels), true });
+        fields.push_back({ "mid_side", offsetof(smbc_parameters, mid_side), true });
+        fields.push_back({ "decimated_bands", offsetof(smbc_parameters, decimated_bands), true });
+        fields.push_back({ "offline_oversampling", offsetof(smbc_parameters, offline_oversampling), true });
+        fields.push_back({ "offline_render_quality", offsetof(smbc_parameters, offline_render_quality), true });
+        fields.push_back({ "limiter", offsetof(smbc_parameters, limiter), true });
+        fields.push_back({ "limiter_ceiling_db", offsetof(smbc_parameters, limiter_ceiling_db), false });
+        fields.push_back({ "limiter_release_ms", offsetof(smbc_parameters, limiter_release_ms), false });
+        fields.push_back({ "spectral", offsetof(smbc_parameters, spectral), true });
+        fields.push_back({ "spectral_bands", offsetof(smbc_parameters, spectral_bands), true });
+        
+        // the sidechain, link bus and worker pool have nothing to do in a batch, see MultibandCompressor::prepareStreams
+    }
+    
+    const Field* findField(const char* name)
+    {
+        for(auto& field : fields)
+        {
+            if( field.name == name )
+                return &field;
+        }
+        
+        return nullptr;
+    }
+    
+    bool setField(smbc_parameters& parameters, const Field& field, PyObject* value)
+    {
+        auto* p = reinterpret_cast<char*>(&parameters) + field.offset;
+        
+        // read as a float either way, so NumPy's bools and integers all convert
+        auto v = PyFloat_AsDouble(value);
+        
+        if( v == -1.0 && PyErr_Occurred() )
+            return false;
+        
+        if( field.isInt )
+            *reinterpret_cast<int*>(p) = static_cast<int>(v);
+        else
+            *reinterpret_cast<float*>(p) = static_cast<float>(v);
+        
+        return true;
+    }
+    
+    PyObject* getField(const smbc_parameters& parameters, const Field& field)
+    {
+        auto* p = reinterpret_cast<const char*>(&parameters) + field.offset;
+        
+        if( field.isInt )
+            return PyLong_FromLong(*reinterpret_cast<const int*>(p));
+        
+        return PyFloat_FromDouble(*reinterpret_cast<const float*>(p));
+    }
+    
+    // a scalar goes to every clip, anything else has to be a sequence of one value per clip
+    bool parseParameter(std::vector<smbc_parameters>& clipParameters, const Field& field, PyObject* value)
+    {
+        auto numClips = static_cast<Py_ssize_t>(clipParameters.size());
+        
+        if( PyNumber_Check(value) && ! PySequence_Check(value) )
+        {
+            for(auto& parameters : clipParameters)
+            {
+                if( ! setField(parameters, field, value) )
+                    return false;
+            }
+            
+            return true;
+        }
+        
+        PyObject* sequence = PySequence_Fast(value, "parameters take a number or a sequence of one per clip");
+        
+        if( sequence == nullptr )
+            return false;
+        
+        auto ok = PySequence_Fast_GET_SIZE(sequence) == numClips;
+        
+        if( ! ok )
+            PyErr_Format(PyExc_ValueError, "%s has %zd values for %zd clips", field.name.c_str(), PySequence_Fast_GET_SIZE(sequence), numClips);
+        
+        for(Py_ssize_t i = 0; ok && i < numClips; ++i)
+            ok = setField(clipParameters[static_cast<size_t>(i)], field, PySequence_Fast_GET_ITEM(sequence, i));
+        
+        Py_DECREF(sequence);
+        return ok;
+    }
+    
+    // the clips of one array, as the engine's streams take them
+    struct Clips
+    {
+        char* data = nullptr;
+        Py_ssize_t clipStride = 0, channelStride = 0; // in bytes
+        int numClips = 1, numChannels = 0, numSamples = 0;
+        bool isDouble = false;
+        
+        template<typename SampleType>
+        SampleType* getChannel(int clip, int channel) const
+        {
+            return reinterpret_cast<SampleType*>(data + clip * clipStride + channel * channelStride);
+        }
+    };
+    
+    bool getClips(Py_buffer& view, Clips& clips)
+    {
+        auto* format = view.format != nullptr ? view.format : "B";
+        
+        // native byte order only
+        if( *format == '@' || *format == '=' || *format == '<' )
+            ++format;
+        
+        clips.isDouble = std::strcmp(format, "d") == 0;
+        
+        if( ! clips.isDouble && std::strcmp(format, "f") != 0 )
+        {
+            PyErr_SetString(PyExc_TypeError, "audio must be float32 or float64");
+            return false;
+        }
+        
+        if( view.ndim != 2 && view.ndim != 3 )
+        {
+            PyErr_SetString(PyExc_ValueError, "audio must be (channels, samples) or (clips, channels, samples)");
+            return false;
+        }
+        
+        auto axis = view.ndim - 2;
+        
+        if( view.strides[axis + 1] != view.itemsize )
+        {
+            PyErr_SetString(PyExc_ValueError, "each channel's samples must be contiguous");
+            return false;
+        }
+        
+        if( view.shape[axis] < 1 || view.shape[axis] > maxChannels || view.shape[axis + 1] > INT_MAX || (axis == 1 && view.shape[0] > INT_MAX) )
+        {
+            PyErr_Format(PyExc_ValueError, "audio needs 1 to %d channels", maxChannels);
+            return false;
+        }
+        
+        clips.data = static_cast<char*>(view.buf);
+        clips.numClips = axis == 1 ? static_cast<int>(view.shape[0]) : 1;
+        clips.clipStride = axis == 1 ? view.strides[0] : 0;
+        clips.numChannels = static_cast<int>(view.shape[axis]);
+        clips.channelStride = view.strides[axis];
+        clips.numSamples = static_cast<int>(view.shape[axis + 1]);
+        return true;
+    }
+    
+    template<typename SampleType>
+    bool processStreams(smbc_compressor* compressor, const Clips& clips, const int* clipIndices, int numStreams)
+    {
+        std::vector<SampleType*> channels(static_cast<size_t>(numStreams * clips.numChannels));
+        std::vector<SampleType* const*> streams(static_cast<size_t>(numStreams));
+        
+        for(int s = 0; s < numStreams; ++s)
+        {
+            for(int ch = 0; ch < clips.numChannels; ++ch)
+                channels[static_cast<size_t>(s * clips.numChannels + ch)] = clips.getChannel<SampleType>(clipIndices[s], ch);
+            
+            streams[static_cast<size_t>(s)] = channels.data() + s * clips.numChannels;
+        }
+        
+        if constexpr (std::is_same_v<SampleType, double>)
+            return smbc_process_streams_f64(compressor, streams.data(), clips.numSamples) != 0;
+        else
+            return smbc_process_streams_f32(compressor, streams.data(), clips.numSamples) != 0;
+    }
+    
+    // no Python in here, it runs without the GIL. Returns false if the engine wouldn't prepare or process
+    bool render(const Clips& clips, const std::vector<smbc_parameters>& clipParameters, double sampleRate, int maximumBlockSize, bool nonRealtime, std::vector<int>& latencies)
+    {
+        // clips with the same parameters end up next to each other
+        std::vector<int> order(static_cast<size_t>(clips.numClips));
+        
+        for(int i = 0; i < clips.numClips; ++i)
+            order[static_cast<size_t>(i)] = i;
+        
+        auto compare = [&](int a, int b)
+        {
+            return std::memcmp(&clipParameters[static_cast<size_t>(a)], &clipParameters[static_cast<size_t>(b)], sizeof(smbc_parameters));
+        };
+        
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return compare(a, b) < 0; });
+        
+        auto* compressor = smbc_create();
+        auto ok = true;
+        
+        for(size_t first = 0; ok && first < order.size();)
+        {
+            auto last = first + 1;
+            
+            while( last < order.size() && last - first < static_cast<size_t>(maxStreamsPerPrepare) && compare(order[first], order[last]) == 0 )
+                ++last;
+            
+            auto numStreams = static_cast<int>(last - first);
+            
+            smbc_set_parameters(compressor, &clipParameters[static_cast<size_t>(order[first])]);
+            smbc_set_non_realtime(compressor, nonRealtime);
+            ok = smbc_prepare_streams(compressor, sampleRate, maximumBlockSize, numStreams, clips.numChannels, clips.isDouble) != 0;
+            
+            if( ok )
+            {
+                if( clips.isDouble )
+                    ok = processStreams<double>(compressor, clips, order.data() + first, numStreams);
+                else
+                    ok = processStreams<float>(compressor, clips, order.data() + first, numStreams);
+                
+                for(auto i = first; i < last; ++i)
+                    latencies[static_cast<size_t>(order[i])] = smbc_get_stream_latency_samples(compressor);
+            }
+            
+            first = last;
+        }
+        
+        smbc_destroy(compressor);
+        return ok;
+    }
+    
+    PyObject* process(PyObject*, PyObject* args, PyObject* kwargs)
+    {
+        PyObject* audio = nullptr;
+        double sampleRate = 0.0;
+        
+        if( ! PyArg_ParseTuple(args, "Od:process", &audio, &sampleRate) )
+            return nullptr;
+        
+        Py_buffer view;
+        
+        if( PyObject_GetBuffer(audio, &view, PyBUF_RECORDS) != 0 )
+            return nullptr;
+        
+        Clips clips;
+        std::vector<smbc_parameters> clipParameters;
+        std::vector<int> latencies;
+        auto maximumBlockSize = 1024;
+        auto nonRealtime = false;
+        auto ok = getClips(view, clips);
+        
+        if( ok )
+        {
+            smbc_parameters defaults;
+            smbc_default_parameters(&defaults);
+            clipParameters.assign(static_cast<size_t>(clips.numClips), defaults);
+            latencies.assign(static_cast<size_t>(clips.numClips), 0);
+        }
+        
+        PyObject* key = nullptr;
+        PyObject* value = nullptr;
+        Py_ssize_t position = 0;
+        
+        while( ok && kwargs != nullptr && PyDict_Next(kwargs, &position, &key, &value) )
+        {
+            auto* name = PyUnicode_AsUTF8(key);
+            
+            if( name == nullptr )
+            {
+                ok = false;
+            }
+            else if( std::strcmp(name, "max_block_size") == 0 )
+            {
+                maximumBlockSize = static_cast<int>(PyLong_AsLong(value));
+                ok = ! PyErr_Occurred();
+                
+                if( ok && maximumBlockSize < 1 )
+                {
+                    PyErr_SetString(PyExc_ValueError, "max_block_size must be positive");
+                    ok = false;
+                }
+            }
+            else if( std::strcmp(name, "offline") == 0 )
+            {
+                auto truth = PyObject_IsTrue(value);
+                nonRealtime = truth == 1;
+                ok = truth != -1;
+            }
+            else if( auto* field = findField(name) )
+            {
+                ok = parseParameter(clipParameters, *field, value);
+            }
+            else
+            {
+                PyErr_Format(PyExc_TypeError, "process() got an unknown parameter '%s'", name);
+                ok = false;
+            }
+        }
+        
+        if( ok && sampleRate <= 0.0 )
+        {
+            PyErr_SetString(PyExc_ValueError, "sample_rate must be positive");
+            ok = false;
+        }
+        
+        if( ok )
+        {
+            auto rendered = false;
+            auto outOfMemory = false;
+            
+            Py_BEGIN_ALLOW_THREADS
+            
+            try
+            {
+                rendered = render(clips, clipParameters, sampleRate, maximumBlockSize, nonRealtime, latencies);
+            }
+            catch (const std::bad_alloc&)
+            {
+                outOfMemory = true;
+            }
+            
+            Py_END_ALLOW_THREADS
+            
+            if( outOfMemory )
+                PyErr_NoMemory();
+            else if( ! rendered )
+                PyErr_SetString(PyExc_ValueError, "the engine can't be prepared for this audio");
+            
+            ok = rendered && ! outOfMemory;
+        }
+        
+        auto isBatch = view.ndim == 3;
+        PyBuffer_Release(&view);
+        
+        if( ! ok )
+            return nullptr;
+        
+        if( ! isBatch )
+            return PyLong_FromLong(latencies.front());
+        
+        auto* result = PyList_New(static_cast<Py_ssize_t>(latencies.size()));
+        
+        for(size_t i = 0; result != nullptr && i < latencies.size(); ++i)
+            PyList_SET_ITEM(result, static_cast<Py_ssize_t>(i), PyLong_FromLong(latencies[i]));
+        
+        return result;
+    }
+    
+    PyObject* defaultParameters(PyObject*, PyObject*)
+    {
+        smbc_parameters parameters;
+        smbc_default_parameters(&parameters);
+        
+        auto* result = PyDict_New();
+        
+        for(auto& field : fields)
+        {
+            auto* value = getField(parameters, field);
+            
+            if( result == nullptr || value == nullptr || PyDict_SetItemString(result, field.name.c_str(), value) != 0 )
+            {
+                Py_XDECREF(value);
+                Py_XDECREF(result);
+                return nullptr;
+            }
+            
+            Py_DECREF(value);
+        }
+        
+        return result;
+    }
+    
+    // held for the module's lifetime, so SharedDsp's tables and FFT plans outlive each call
+    smbc_compressor* keepAlive = nullptr;
+    
+    void freeModule(void*)
+    {
+        smbc_destroy(keepAlive);
+        keepAlive = nullptr;
+    }
+    
+    PyMethodDef methods[] =
+    {
+        { "process", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)(void)>(process)), METH_VARARGS | METH_KEYWORDS,
+          "process(audio, sample_rate, *, offline=False, max_block_size=1024, **parameters)\n"
+          "--\n\n"
+          "Compresses audio in place: float32 or float64, (channels, samples) or (clips, channels, samples).\n"
+          "Each parameter is one value for every clip or a sequence of one per clip, see default_parameters().\n"
+          "Returns the latency in samples, a list of one per clip for a batch." },
+        { "default_parameters", defaultParameters, METH_NOARGS,
+          "default_parameters()\n"
+          "--\n\n"
+          "Every parameter process() takes, with the plugin's defaults." },
+        { nullptr, nullptr, 0, nullptr }
+    };
+    
+    PyModuleDef moduleDef =
+    {
+        PyModuleDef_HEAD_INIT,
+        "smbc",
+        "The SimpleMBComp multiband compressor over NumPy arrays, in place and without the GIL.",
+        -1,
+        methods,
+        nullptr,
+        nullptr,
+        nullptr,
+        freeModule
+    };
+}
+
+PyMODINIT_FUNC PyInit_smbc(void)
+{
+    if( fields.empty() )
+        addFields();
+    
+    if( keepAlive == nullptr )
+        keepAlive = smbc_create();
+    
+    return PyModule_Create(&moduleDef);
+}
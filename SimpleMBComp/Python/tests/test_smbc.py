@@ -0,0 +1,182 @@
+"""
+smbc.process against the C API it's built on, called straight through ctypes on the same
+extension: one compressor per clip, prepared for the clip's channels and processed in one
+call. process() renders clips with the same parameters together as streams of one engine,
+which has to come out sample for sample the same, latency included. That takes the
+-ffp-contract=off setup.py builds the extension with, see Source/DSP/CpuDispatch.h.
+
+    JUCE_MODULES=~/JUCE/modules pip install ./SimpleMBComp/Python
+    pytest SimpleMBComp/Python/tests
+"""
+
+import ctypes
+
+import numpy as np
+import pytest
+
+import smbc
+
+sample_rate = 48000.0
+
+# smbc.process()'s default, the C calls get the same so both cut the clips into the same blocks
+max_block_size = 1024
+
+
+class BandParameters(ctypes.Structure):
+    _fields_ = [(name, ctypes.c_float) for name in ("attack_ms", "release_ms", "threshold_db", "ratio",
+                                                    "side_attack_ms", "side_release_ms", "side_threshold_db", "side_ratio")] + \
+               [(name, ctypes.c_int) for name in ("bypass", "mute", "solo")] + \
+               [("lookahead_ms", ctypes.c_float), ("detector", ctypes.c_int), ("detector_window_ms", ctypes.c_float),
+                ("oversampling", ctypes.c_int), ("mix", ctypes.c_float)]
+
+
+class Parameters(ctypes.Structure):
+    _fields_ = [("bands", BandParameters * 3),
+                ("low_mid_crossover_hz", ctypes.c_float), ("mid_high_crossover_hz", ctypes.c_float),
+                ("crossover_slope", ctypes.c_int),
+                ("input_gain_db", ctypes.c_float), ("output_gain_db", ctypes.c_float), ("mix", ctypes.c_float)] + \
+               [(name, ctypes.c_int) for name in ("link_channels", "mid_side", "external_sidechain", "parallel_processing",
+                                                  "decimated_bands", "offline_oversampling", "offline_render_quality", "limiter")] + \
+               [("limiter_ceiling_db", ctypes.c_float), ("limiter_release_ms", ctypes.c_float)] + \
+               [(name, ctypes.c_int) for name in ("link_bus_send", "link_bus_receive", "spectral", "spectral_bands")]
+
+
+band_names = ("low_", "mid_", "high_")
+band_fields = {name for name, _ in BandParameters._fields_}
+
+# the C API is exported from the extension itself
+lib = ctypes.CDLL(smbc.__file__)
+
+lib.smbc_create.restype = ctypes.c_void_p
+lib.smbc_destroy.argtypes = [ctypes.c_void_p]
+lib.smbc_default_parameters.argtypes = [ctypes.POINTER(Parameters)]
+lib.smbc_set_parameters.argtypes = [ctypes.c_void_p, ctypes.POINTER(Parameters)]
+lib.smbc_set_non_realtime.argtypes = [ctypes.c_void_p, ctypes.c_int]
+lib.smbc_prepare.argtypes = [ctypes.c_void_p, ctypes.c_double, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int]
+lib.smbc_get_latency_samples.argtypes = [ctypes.c_void_p]
+
+for suffix, sample in (("f32", ctypes.c_float), ("f64", ctypes.c_double)):
+    channels = ctypes.POINTER(ctypes.POINTER(sample))
+    getattr(lib, "smbc_process_" + suffix).argtypes = [ctypes.c_void_p, channels, ctypes.c_int, ctypes.c_int, channels, ctypes.c_int]
+
+
+def split_name(name):
+    """(band index or None, field name) of one of process()'s keywords"""
+    for index, prefix in enumerate(band_names):
+        if name.startswith(prefix) and name[len(prefix):] in band_fields:
+            return index, name[len(prefix):]
+
+    return None, name
+
+
+def make_parameters(values):
+    parameters = Parameters()
+    lib.smbc_default_parameters(ctypes.byref(parameters))
+
+    for name, value in values.items():
+        band, field = split_name(name)
+        target = parameters if band is None else parameters.bands[band]
+        setattr(target, field, type(getattr(target, field))(value))
+
+    return parameters
+
+
+def render_with_c_api(clip, values, offline):
+    """renders one (channels, samples) clip in place, returns the latency"""
+    is_double = clip.dtype == np.float64
+    sample = ctypes.c_double if is_double else ctypes.c_float
+    num_channels, num_samples = clip.shape
+
+    compressor = lib.smbc_create()
+
+    try:
+        parameters = make_parameters(values)
+        lib.smbc_set_parameters(compressor, ctypes.byref(parameters))
+        lib.smbc_set_non_realtime(compressor, int(offline))
+        assert lib.smbc_prepare(compressor, sample_rate, max_block_size, num_channels, 0, int(is_double))
+
+        channels = (ctypes.POINTER(sample) * num_channels)(*[channel.ctypes.data_as(ctypes.POINTER(sample)) for channel in clip])
+        process = lib.smbc_process_f64 if is_double else lib.smbc_process_f32
+        assert process(compressor, channels, num_channels, num_samples, None, 0)
+
+        return lib.smbc_get_latency_samples(compressor)
+    finally:
+        lib.smbc_destroy(compressor)
+
+
+def make_clips(dtype, num_clips, num_channels, num_samples):
+    """noise, sweeps and clicks, loud enough to compress, and not a whole number of blocks long"""
+    rng = np.random.default_rng(50)
+    time = np.arange(num_samples) / sample_rate
+    clips = np.empty((num_clips, num_channels, num_samples))
+
+    for clip in range(num_clips):
+        for channel in range(num_channels):
+            kind = (clip + channel) % 3
+
+            if kind == 0:
+                clips[clip, channel] = 0.5 * rng.uniform(-1.0, 1.0, num_samples)
+            elif kind == 1:
+                frequencies = 20.0 * 1000.0 ** (time / time[-1])
+                clips[clip, channel] = 0.5 * np.sin(2.0 * np.pi * np.cumsum(frequencies) / sample_rate)
+            else:
+                clips[clip, channel] = 0.0
+                clips[clip, channel, ::4800] = 0.9
+
+    return clips.astype(dtype)
+
+
+# keywords of process(), each either one value for every clip or one per clip
+cases = {
+    "scalar": ({"low_threshold_db": -30.0, "mid_threshold_db": -24.0, "high_ratio": 8.0, "limiter": 1,
+                "limiter_ceiling_db": -6.0, "high_lookahead_ms": 2.0, "link_channels": 1}, False),
+    # clips 0 and 2, 1 and 3, 4 and 5 share their parameters, so they run as streams together
+    "per_clip": ({"mid_threshold_db": [-10.0, -20.0, -10.0, -20.0, -30.0, -30.0],
+                  "limiter": [0, 1, 0, 1, 1, 1],
+                  "high_lookahead_ms": [0.0, 2.0, 0.0, 2.0, 5.0, 5.0],
+                  "low_detector": [0, 1, 0, 1, 2, 2],
+                  "crossover_slope": 2, "link_channels": 1}, False),
+    "offline": ({"mid_threshold_db": [-20.0, -30.0, -20.0, -30.0, -20.0, -30.0],
+                 "offline_render_quality": 1, "decimated_bands": [0, 0, 0, 0, 2, 2]}, True),
+}
+
+
+@pytest.mark.parametrize("dtype", [np.float32, np.float64])
+@pytest.mark.parametrize("case", sorted(cases))
+@pytest.mark.parametrize("num_channels", [1, 2, 6])
+def test_process_matches_the_c_api(dtype, case, num_channels):
+    values, offline = cases[case]
+    num_clips = 6
+
+    clips = make_clips(dtype, num_clips, num_channels, 20000)
+    expected = clips.copy()
+
+    latencies = smbc.process(clips, sample_rate, offline=offline, **values)
+
+    for clip in range(num_clips):
+        clip_values = {name: value[clip] if isinstance(value, list) else value for name, value in values.items()}
+        latency = render_with_c_api(expected[clip], clip_values, offline)
+
+        assert latencies[clip] == latency
+        assert np.array_equal(clips[clip], expected[clip]), "clip %d differs by up to %g" % (clip, np.abs(clips[clip] - expected[clip]).max())
+
+
+@pytest.mark.parametrize("dtype", [np.float32, np.float64])
+def test_one_clip_matches_the_c_api(dtype):
+    values = cases["scalar"][0]
+    clip = make_clips(dtype, 1, 2, 20000)[0]
+    expected = clip.copy()
+
+    latency = smbc.process(clip, sample_rate, **values)
+
+    assert latency == render_with_c_api(expected, values, False)
+    assert np.array_equal(clip, expected)
+
+
+def test_default_parameters_match_the_c_api():
+    parameters = Parameters()
+    lib.smbc_default_parameters(ctypes.byref(parameters))
+
+    for name, value in smbc.default_parameters().items():
+        band, field = split_name(name)
+        assert getattr(parameters if band is None else parameters.bands[band], field) == pytest.approx(value), name
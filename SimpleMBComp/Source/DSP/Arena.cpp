@@ -0,0 +1,40 @@
+/*
+  ==============================================================================
+
+    Arena.cpp
+
+  ==============================================================================
+*/
+
+#include "Arena.h"
+
+void Arena::beginPass(bool measure)
+{
+    measuring = measure;
+    offset = 0;
+}
+
+void Arena::resize(size_t newNumBytes)
+{
+    if( newNumBytes == numBytes && data != nullptr )
+    {
+        // same layout again, just start from silence
+        std::memset(data, 0, numBytes);
+        return;
+    }
+    
+    numBytes = newNumBytes;
+    
+    // HeapBlock only guarantees malloc alignment, so over-allocate a little and round the start up
+    storage.allocate(numBytes + alignment - 1, true);
+    
+    auto address = reinterpret_cast<juce::pointer_sized_uint>(storage.get());
+    data = storage.get() + (roundUp(address) - address);
+}
+
+void Arena::release()
+{
+    storage.free();
+    data = nullptr;
+    numBytes = offset = 0;
+}
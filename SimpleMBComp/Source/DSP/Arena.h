@@ -0,0 +1,70 @@
+/*
+  ==============================================================================
+
+    Arena.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+ One 64 byte aligned allocation per plugin instance that holds the band buffers
+ and all of the filter and detector state, back to back.
+ 
+ The layout is described once by a function that calls allocate() for every block.
+ build() runs it twice: the first pass only measures, the second hands out pointers
+ into the freshly sized storage. Every block starts on a 64 byte boundary.
+ Only call build() from prepareToPlay, it may reallocate.
+ */
+struct Arena
+{
+    static constexpr size_t alignment = 64;
+    
+    template<typename LayoutFunction>
+    void build(LayoutFunction&& layout)
+    {
+        beginPass(true);
+        layout(*this);
+        
+        resize(offset);
+        
+        beginPass(false);
+        layout(*this);
+        
+        // the layout must not depend on the pointers it gets back
+        jassert(offset == numBytes);
+    }
+    
+    // returns nullptr while measuring
+    template<typename T>
+    T* allocate(size_t numElements)
+    {
+        static_assert(std::is_trivially_destructible_v<T> && alignof(T) <= alignment, "");
+        
+        auto* block = measuring ? nullptr : reinterpret_cast<T*>(data + offset);
+        offset += roundUp(numElements * sizeof(T));
+        return block;
+    }
+    
+    // gives the storage back once nothing is laid out in it any more. Not realtime safe either
+    void release();
+    
+    // the instance's whole DSP footprint
+    size_t getNumBytes() const { return numBytes; }
+    
+    static constexpr size_t roundUp(size_t numBytesToRound)
+    {
+        return (numBytesToRound + alignment - 1) & ~(alignment - 1);
+    }
+private:
+    void beginPass(bool measure);
+    void resize(size_t newNumBytes);
+    
+    juce::HeapBlock<char> storage;
+    char* data = nullptr;
+    size_t numBytes = 0, offset = 0;
+    bool measuring = false;
+};
@@ -0,0 +1,276 @@
+/*
+  ==============================================================================
+
+    BandDecimator.cpp
+
+  ==============================================================================
+*/
+
+#include "BandDecimator.h"
+
+template<typename SampleType>
+const typename BandDecimator<SampleType>::Halfband& BandDecimator<SampleType>::getHalfband()
+{
+    // passband up to 0.2 of each stage's input rate, stopband from 0.3.
+    // Every stage uses the same design, the last one decides the usable band: 0.4 of the band rate
+    static const Halfband halfband = []
+    {
+        auto coefficients = juce::dsp::FilterDesign<SampleType>::designFIRLowpassHalfBandEquirippleMethod(SampleType(0.1), SampleType(-80));
+        
+        Halfband hb;
+        hb.numTaps = static_cast<int>(coefficients->getFilterOrder()) + 1;
+        hb.centre = (hb.numTaps - 1) / 2;
+        
+        const auto* taps = coefficients->getRawCoefficients();
+        hb.centreTap = taps[hb.centre];
+        
+        for( int d = 1; d <= hb.centre; d += 2 )
+        {
+            hb.oddTaps.push_back(taps[hb.centre + d]);
+            jassert(d + 1 > hb.centre || std::abs(taps[hb.centre + d + 1]) < SampleType(1.0e-6));
+        }
+        
+        return hb;
+    }();
+    
+    return halfband;
+}
+
+template<typename SampleType>
+int BandDecimator<SampleType>::getLatencyForStages(int numStages)
+{
+    // stage s delays by centre samples at its input rate on the way down and again on the way up
+    return 2 * getHalfband().centre * ((1 << numStages) - 1);
+}
+
+template<typename SampleType>
+void BandDecimator<SampleType>::allocate(Arena& arena, const juce::dsp::ProcessSpec& spec, int maxNumStages, int maxDelaySamples)
+{
+    jassert(spec.numChannels <= (juce::uint32) ChannelLayout::maxChannels);
+    jassert(juce::isPositiveAndNotGreaterThan(maxNumStages, maxStages));
+    
+    numChannels = static_cast<int>(spec.numChannels);
+    numAllocatedStages = maxNumStages;
+    delayLineSize = maxDelaySamples > 0 ? maxDelaySamples + 1 : 0;
+    
+    const auto numTaps = static_cast<size_t>(getHalfband().numTaps);
+    
+    for( int ch = 0; ch < numChannels; ++ch )
+    {
+        auto& state = channelStates[ch];
+        
+        for( int s = 0; s < numAllocatedStages; ++s )
+        {
+            auto& stage = state.stages[s];
+            stage.down.samples = arena.allocate<SampleType>(2 * numTaps);
+            stage.up.samples = arena.allocate<SampleType>(2 * numTaps);
+            
+            // the phase can let one extra sample through
+            state.levels[s] = arena.allocate<SampleType>((spec.maximumBlockSize >> (s + 1)) + 1);
+        }
+        
+        state.delayLine = delayLineSize > 0 ? arena.allocate<SampleType>(static_cast<size_t>(delayLineSize)) : nullptr;
+    }
+    
+    numStages = delaySamples = 0;
+}
+
+template<typename SampleType>
+void BandDecimator<SampleType>::setNumStages(int newNumStages)
+{
+    jassert(newNumStages <= numAllocatedStages);
+    
+    numStages = juce::jmin(newNumStages, numAllocatedStages);
+    
+    const auto numTaps = getHalfband().numTaps;
+    
+    for( int ch = 0; ch < numChannels; ++ch )
+    {
+        auto& state = channelStates[ch];
+        
+        for( int s = 0; s < numStages; ++s )
+        {
+            auto& stage = state.stages[s];
+            
+            for( auto* history : { &stage.down, &stage.up } )
+            {
+                std::fill(history->samples, history->samples + 2 * numTaps, SampleType(0));
+                history->position = 0;
+            }
+            
+            stage.downPhase = stage.upPhase = 0;
+        }
+        
+        bandChannels[ch] = numStages > 0 ? state.levels[numStages - 1] : nullptr;
+    }
+    
+    clearDelay();
+}
+
+template<typename SampleType>
+void BandDecimator<SampleType>::followPhaseOf(const BandDecimator& band)
+{
+    setNumStages(band.numStages);
+    
+    // every stage keeps the same samples as the band's, otherwise the two would give different block lengths
+    for( int ch = 0; ch < numChannels && ch < band.numChannels; ++ch )
+    {
+        for( int s = 0; s < numStages; ++s )
+            channelStates[ch].stages[s].downPhase = band.channelStates[ch].stages[s].downPhase;
+    }
+}
+
+template<typename SampleType>
+void BandDecimator<SampleType>::setDelaySamples(int newDelaySamples)
+{
+    jassert(newDelaySamples == 0 || newDelaySamples < delayLineSize);
+    
+    auto wasDelaying = delaySamples > 0;
+    delaySamples = newDelaySamples < delayLineSize ? newDelaySamples : 0;
+    
+    // the line isn't written while there is no delay, so it would hold stale samples
+    if( delaySamples > 0 && ! wasDelaying )
+        clearDelay();
+}
+
+template<typename SampleType>
+void BandDecimator<SampleType>::clearDelay()
+{
+    for( int ch = 0; ch < numChannels; ++ch )
+    {
+        auto& state = channelStates[ch];
+        
+        if( state.delayLine != nullptr )
+            std::fill(state.delayLine, state.delayLine + delayLineSize, SampleType(0));
+        
+        state.delayPosition = 0;
+    }
+}
+
+template<typename SampleType>
+const SampleType* BandDecimator<SampleType>::History::push(SampleType x, int numTaps)
+{
+    samples[position] = x;
+    samples[position + numTaps] = x;
+    
+    if( ++position == numTaps )
+        position = 0;
+    
+    // oldest first, the newest sample is at numTaps - 1
+    return samples + position;
+}
+
+template<typename SampleType>
+int BandDecimator<SampleType>::downsample(int channel, const SampleType* input, int numSamples)
+{
+    const auto& hb = getHalfband();
+    const auto numOddTaps = static_cast<int>(hb.oddTaps.size());
+    auto& state = channelStates[channel];
+    
+    for( int s = 0; s < numStages; ++s )
+    {
+        auto& stage = state.stages[s];
+        auto* output = state.levels[s];
+        auto numOutput = 0;
+        
+        for( int i = 0; i < numSamples; ++i )
+        {
+            const auto* w = stage.down.push(input[i], hb.numTaps);
+            
+            // only every other output is kept, so only those get computed
+            if( stage.downPhase == 0 )
+            {
+                auto y = hb.centreTap * w[hb.centre];
+                
+                for( int m = 0; m < numOddTaps; ++m )
+                {
+                    auto d = 2 * m + 1;
+                    y += hb.oddTaps[m] * (w[hb.centre - d] + w[hb.centre + d]);
+                }
+                
+                output[numOutput++] = y;
+            }
+            
+            stage.downPhase ^= 1;
+        }
+        
+        state.levelSizes[s] = numOutput;
+        input = output;
+        numSamples = numOutput;
+    }
+    
+    return numSamples;
+}
+
+template<typename SampleType>
+void BandDecimator<SampleType>::upsample(int channel, SampleType* output, int numSamples)
+{
+    const auto& hb = getHalfband();
+    const auto numOddTaps = static_cast<int>(hb.oddTaps.size());
+    auto& state = channelStates[channel];
+    
+    for( int s = numStages - 1; s >= 0; --s )
+    {
+        auto& stage = state.stages[s];
+        const auto* input = state.levels[s];
+        auto* stageOutput = s == 0 ? output : state.levels[s - 1];
+        auto numOutput = s == 0 ? numSamples : state.levelSizes[s - 1];
+        auto numInput = 0;
+        
+        for( int i = 0; i < numOutput; ++i )
+        {
+            // zero stuffing, x2 to keep unity gain
+            auto u = stage.upPhase == 0 ? SampleType(2) * input[numInput++] : SampleType(0);
+            const auto* w = stage.up.push(u, hb.numTaps);
+            
+            // the stuffed zeros either land on the centre tap or on all the odd ones, so one of the two sums is always zero
+            if( (stage.upPhase + hb.centre) % 2 == 0 )
+            {
+                stageOutput[i] = hb.centreTap * w[hb.centre];
+            }
+            else
+            {
+                auto y = SampleType(0);
+                
+                for( int m = 0; m < numOddTaps; ++m )
+                {
+                    auto d = 2 * m + 1;
+                    y += hb.oddTaps[m] * (w[hb.centre - d] + w[hb.centre + d]);
+                }
+                
+                stageOutput[i] = y;
+            }
+            
+            stage.upPhase ^= 1;
+        }
+        
+        jassert(numInput == state.levelSizes[s]);
+    }
+}
+
+template<typename SampleType>
+void BandDecimator<SampleType>::delay(int channel, SampleType* samples, int numSamples)
+{
+    auto& state = channelStates[channel];
+    auto* line = state.delayLine;
+    auto position = state.delayPosition;
+    
+    for( int i = 0; i < numSamples; ++i )
+    {
+        line[position] = samples[i];
+        
+        auto readPosition = position - delaySamples;
+        if( readPosition < 0 )
+            readPosition += delayLineSize;
+        
+        samples[i] = line[readPosition];
+        
+        if( ++position == delayLineSize )
+            position = 0;
+    }
+    
+    state.delayPosition = position;
+}
+
+template struct BandDecimator<float>;
+template struct BandDecimator<double>;
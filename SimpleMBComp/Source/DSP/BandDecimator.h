@@ -0,0 +1,144 @@
+/*
+  ==============================================================================
+
+    BandDecimator.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChannelLayout.h"
+#include "Arena.h"
+
+/*
+ Runs one band's processing at a lower rate. The band is halved numStages times
+ by a cascade of polyphase halfband FIRs, processed, then interpolated back up
+ through the mirror cascade. The crossover has already band limited the band,
+ so the halfbands only have to keep the aliasing of the compressor's output down.
+ 
+ Both directions are linear phase, so the band comes out delayed by a whole number
+ of host rate samples. Bands that run at a different rate (or at the host rate)
+ add a plain delay on top so every band lines up with the same total latency.
+ 
+ All state is per channel, so disjoint channel subsets can run on different threads.
+ */
+template<typename SampleType>
+struct BandDecimator
+{
+    static constexpr int maxStages = 4;
+    
+    // latency in host rate samples of a cascade with this many stages
+    static int getLatencyForStages(int numStages);
+    
+    // called from Arena::build(), sized for the most stages and the longest alignment delay this band can need
+    void allocate(Arena& arena, const juce::dsp::ProcessSpec& spec, int maxNumStages, int maxDelaySamples);
+    
+    // realtime safe, clears all state. The band's total latency becomes getLatencyForStages(numStages) + the delay
+    void setNumStages(int numStages);
+    
+    // realtime safe, the alignment delay can change every block without clearing anything
+    void setDelaySamples(int newDelaySamples);
+    
+    int getNumStages() const { return numStages; }
+    
+    // realtime safe, for a decimator that runs a detector key alongside band: clears all state,
+    // then takes band's stages and its place in the decimation, so both keep the same samples
+    void followPhaseOf(const BandDecimator& band);
+    
+    // calls processAtBandRate(bandChannels, numBandSamples) with bus channel indexed pointers, like CompressorBand expects
+    template<typename ProcessFunction>
+    void process(SampleType* const* channels, int numSamples, const ChannelLayout::ChannelSubset& subset, ProcessFunction&& processAtBandRate)
+    {
+        if( numStages == 0 )
+        {
+            processAtBandRate(channels, numSamples);
+        }
+        else
+        {
+            auto numBandSamples = 0;
+            
+            for( int i = 0; i < subset.numChannels; ++i )
+                numBandSamples = downsample(subset.channels[i], channels[subset.channels[i]], numSamples);
+            
+            processAtBandRate(bandChannels.data(), numBandSamples);
+            
+            for( int i = 0; i < subset.numChannels; ++i )
+                upsample(subset.channels[i], channels[subset.channels[i]], numSamples);
+        }
+        
+        if( delaySamples > 0 )
+        {
+            for( int i = 0; i < subset.numChannels; ++i )
+                delay(subset.channels[i], channels[subset.channels[i]], numSamples);
+        }
+    }
+    
+    // only the down half, for a detector key: the key comes out exactly as delayed as the band is
+    // inside process(), with bus channel indexed pointers at the band rate
+    const SampleType* const* downsampleOnly(const SampleType* const* channels, int numSamples, const ChannelLayout::ChannelSubset& subset)
+    {
+        if( numStages == 0 )
+            return channels;
+        
+        for( int i = 0; i < subset.numChannels; ++i )
+            downsample(subset.channels[i], channels[subset.channels[i]], numSamples);
+        
+        return bandChannels.data();
+    }
+private:
+    // returns the number of samples at the band rate this block
+    int downsample(int channel, const SampleType* input, int numSamples);
+    void upsample(int channel, SampleType* output, int numSamples);
+    void delay(int channel, SampleType* samples, int numSamples);
+    void clearDelay();
+    
+    /*
+     A halfband's taps are zero at every even distance from the centre, so only the
+     centre tap and the odd ones get stored. Shared by every instance.
+     */
+    struct Halfband
+    {
+        std::vector<SampleType> oddTaps; // taps at distance 1, 3, 5... from the centre
+        SampleType centreTap = 0;
+        int numTaps = 0, centre = 0;
+    };
+    
+    static const Halfband& getHalfband();
+    
+    // history holds numTaps samples twice over, so the newest numTaps are always contiguous
+    struct History
+    {
+        SampleType* samples = nullptr;
+        int position = 0;
+        
+        const SampleType* push(SampleType x, int numTaps);
+    };
+    
+    struct Stage
+    {
+        History down, up;
+        
+        // 0 on the samples that survive decimation. Down and up stay in step
+        int downPhase = 0, upPhase = 0;
+    };
+    
+    struct ChannelState
+    {
+        std::array<Stage, maxStages> stages;
+        
+        // levels[i] holds the output of down stage i, then the input of up stage i
+        std::array<SampleType*, maxStages> levels {};
+        std::array<int, maxStages> levelSizes {};
+        
+        SampleType* delayLine = nullptr;
+        int delayPosition = 0;
+    };
+    
+    std::array<ChannelState, ChannelLayout::maxChannels> channelStates;
+    std::array<SampleType*, ChannelLayout::maxChannels> bandChannels {}; // the last level of every channel
+    
+    int numChannels = 0, numAllocatedStages = 0, delayLineSize = 0;
+    int numStages = 0, delaySamples = 0;
+};
@@ -0,0 +1,61 @@
+/*
+  ==============================================================================
+
+    BandOversampler.cpp
+
+  ==============================================================================
+*/
+
+#include "BandOversampler.h"
+
+template<typename SampleType>
+void BandOversampler<SampleType>::prepare(const juce::dsp::ProcessSpec& spec)
+{
+    jassert(spec.numChannels <= (juce::uint32) ChannelLayout::maxChannels);
+    
+    numChannels = static_cast<int>(spec.numChannels);
+    
+    for( int s = 0; s < maxStages; ++s )
+    {
+        auto& stageOversamplers = oversamplers[static_cast<size_t>(s)];
+        
+        for( int ch = 0; ch < ChannelLayout::maxChannels; ++ch )
+        {
+            if( ch >= numChannels )
+            {
+                stageOversamplers[ch].reset();
+                continue;
+            }
+            
+            stageOversamplers[ch] = std::make_unique<Oversampling>(1, static_cast<size_t>(s + 1), Oversampling::filterHalfBandFIREquiripple, true, true);
+            stageOversamplers[ch]->initProcessing(spec.maximumBlockSize);
+        }
+        
+        latencies[static_cast<size_t>(s + 1)] = numChannels > 0 ? juce::roundToInt(stageOversamplers[0]->getLatencyInSamples()) : 0;
+    }
+    
+    numStages = 0;
+}
+
+template<typename SampleType>
+void BandOversampler<SampleType>::setNumStages(int newNumStages)
+{
+    jassert(juce::isPositiveAndNotGreaterThan(newNumStages, maxStages));
+    
+    numStages = juce::jlimit(0, maxStages, newNumStages);
+    
+    if( numStages == 0 )
+        return;
+    
+    for( int ch = 0; ch < numChannels; ++ch )
+        oversamplers[static_cast<size_t>(numStages - 1)][ch]->reset();
+}
+
+template<typename SampleType>
+int BandOversampler<SampleType>::getMaxLatencySamples() const
+{
+    return *std::max_element(latencies.begin(), latencies.end());
+}
+
+template struct BandOversampler<float>;
+template struct BandOversampler<double>;
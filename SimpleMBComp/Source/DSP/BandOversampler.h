@@ -0,0 +1,101 @@
+/*
+  ==============================================================================
+
+    BandOversampler.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChannelLayout.h"
+
+/*
+ Runs one band's detector and gain stage at 2^numStages times the band rate, so fast
+ attacks at high ratios don't alias the gain modulation back into the band.
+ 
+ Uses juce::dsp::Oversampling with the linear phase FIR halfbands and integer latency.
+ The IIR ones are cheaper but their phase shift would differ from band to band and
+ the bands wouldn't sum back flat. One mono oversampler per channel, so disjoint
+ channel subsets can run on different threads like the rest of the band.
+ 
+ The oversamplers own their buffers, so unlike the rest of the chain they are built
+ in prepare() rather than in the arena. Every stage count is built up front, so
+ switching factors on the audio thread never allocates.
+ */
+template<typename SampleType>
+struct BandOversampler
+{
+    static constexpr int maxStages = 3; // 8x
+    
+    // not realtime safe, builds the oversamplers for every stage count
+    void prepare(const juce::dsp::ProcessSpec& spec);
+    
+    // realtime safe, resets the oversamplers of the new stage count
+    void setNumStages(int numStages);
+    int getNumStages() const { return numStages; }
+    
+    // in band rate samples, whole numbers only
+    int getLatencySamples() const { return latencies[static_cast<size_t>(numStages)]; }
+    int getLatencySamples(int stages) const { return latencies[static_cast<size_t>(stages)]; }
+    int getMaxLatencySamples() const;
+    
+    // calls processOversampled(oversampledChannels, numOversampledSamples) with bus channel indexed pointers, like CompressorBand expects
+    template<typename ProcessFunction>
+    void process(SampleType* const* channels, int numSamples, const ChannelLayout::ChannelSubset& subset, ProcessFunction&& processOversampled)
+    {
+        if( numStages == 0 )
+        {
+            processOversampled(channels, numSamples);
+            return;
+        }
+        
+        auto& stageOversamplers = oversamplers[static_cast<size_t>(numStages - 1)];
+        
+        for( int i = 0; i < subset.numChannels; ++i )
+        {
+            auto ch = subset.channels[i];
+            auto block = juce::dsp::AudioBlock<SampleType>(channels + ch, 1, static_cast<size_t>(numSamples));
+            oversampledChannels[ch] = stageOversamplers[ch]->processSamplesUp(block).getChannelPointer(0);
+        }
+        
+        processOversampled(oversampledChannels.data(), numSamples << numStages);
+        
+        for( int i = 0; i < subset.numChannels; ++i )
+        {
+            auto ch = subset.channels[i];
+            auto block = juce::dsp::AudioBlock<SampleType>(channels + ch, 1, static_cast<size_t>(numSamples));
+            stageOversamplers[ch]->processSamplesDown(block);
+        }
+    }
+    
+    // only the up half, for a detector key: the key comes out exactly as delayed as the band is
+    // inside process(), with bus channel indexed pointers at the oversampled rate
+    const SampleType* const* upsampleOnly(const SampleType* const* channels, int numSamples, const ChannelLayout::ChannelSubset& subset)
+    {
+        if( numStages == 0 )
+            return channels;
+        
+        auto& stageOversamplers = oversamplers[static_cast<size_t>(numStages - 1)];
+        
+        for( int i = 0; i < subset.numChannels; ++i )
+        {
+            auto ch = subset.channels[i];
+            auto block = juce::dsp::AudioBlock<const SampleType>(channels + ch, 1, static_cast<size_t>(numSamples));
+            oversampledChannels[ch] = stageOversamplers[ch]->processSamplesUp(block).getChannelPointer(0);
+        }
+        
+        return oversampledChannels.data();
+    }
+private:
+    using Oversampling = juce::dsp::Oversampling<SampleType>;
+    
+    std::array<std::array<std::unique_ptr<Oversampling>, ChannelLayout::maxChannels>, maxStages> oversamplers;
+    std::array<int, maxStages + 1> latencies {};
+    
+    // every channel writes only its own slot, so subsets on different threads don't collide
+    std::array<SampleType*, ChannelLayout::maxChannels> oversampledChannels {};
+    
+    int numChannels = 0, numStages = 0;
+};
@@ -0,0 +1,81 @@
+/*
+  ==============================================================================
+
+    ChannelLayout.cpp
+
+  ==============================================================================
+*/
+
+#include "ChannelLayout.h"
+
+namespace ChannelLayout
+{
+    ChannelGroups makeChannelGroups(const juce::AudioChannelSet& channelSet)
+    {
+        ChannelGroups groups;
+        groups.numChannels = juce::jmin(channelSet.size(), maxChannels);
+        
+        auto mainGroup = -1;
+        
+        for( int ch = 0; ch < groups.numChannels; ++ch )
+        {
+            auto type = channelSet.getTypeOfChannel(ch);
+            
+            if( type == juce::AudioChannelSet::LFE || type == juce::AudioChannelSet::LFE2 )
+            {
+                groups.groupOfChannel[ch] = groups.numGroups++;
+                continue;
+            }
+            
+            if( mainGroup < 0 )
+                mainGroup = groups.numGroups++;
+            
+            groups.groupOfChannel[ch] = mainGroup;
+        }
+        
+        return groups;
+    }
+    
+    ChannelSubset makeAllChannels(int numChannels)
+    {
+        ChannelSubset subset;
+        subset.numChannels = juce::jmin(numChannels, maxChannels);
+        
+        for( int ch = 0; ch < subset.numChannels; ++ch )
+            subset.channels[ch] = ch;
+        
+        return subset;
+    }
+    
+    std::vector<ChannelSubset> makeWorkSubsets(const ChannelGroups& groups,
+                                               bool linked,
+                                               int channelsPerSubset)
+    {
+        std::vector<ChannelSubset> subsets;
+        
+        if( linked )
+        {
+            subsets.resize(groups.numGroups);
+            
+            for( int ch = 0; ch < groups.numChannels; ++ch )
+            {
+                auto& subset = subsets[groups.groupOfChannel[ch]];
+                subset.channels[subset.numChannels++] = ch;
+            }
+            
+            return subsets;
+        }
+        
+        for( int first = 0; first < groups.numChannels; first += channelsPerSubset )
+        {
+            ChannelSubset subset;
+            
+            for( int ch = first; ch < juce::jmin(first + channelsPerSubset, groups.numChannels); ++ch )
+                subset.channels[subset.numChannels++] = ch;
+            
+            subsets.push_back(subset);
+        }
+        
+        return subsets;
+    }
+}
@@ -0,0 +1,64 @@
+/*
+  ==============================================================================
+
+    ChannelLayout.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace ChannelLayout
+{
+    // widest bus we accept. 7.1.4 is 12 channels, 3rd order ambisonics is 16
+    constexpr int maxChannels = 16;
+    
+    // which detector every channel feeds when the bands are linked.
+    // LFE channels always get a group of their own, everything else is linked together
+    struct ChannelGroups
+    {
+        std::array<int, maxChannels> groupOfChannel {};
+        int numChannels = 0;
+        int numGroups = 0;
+    };
+    
+    ChannelGroups makeChannelGroups(const juce::AudioChannelSet& channelSet);
+    
+    // an arbitrary (not necessarily contiguous) set of bus channels, processed as one unit of work
+    struct ChannelSubset
+    {
+        std::array<int, maxChannels> channels {};
+        int numChannels = 0;
+    };
+    
+    ChannelSubset makeAllChannels(int numChannels);
+    
+    /*
+     Splits the bus into independent pieces of compressor work. Linked channels
+     have to stay together, so each link group becomes one subset. Unlinked
+     channels are cut into runs of channelsPerSubset.
+     */
+    std::vector<ChannelSubset> makeWorkSubsets(const ChannelGroups& groups,
+                                               bool linked,
+                                               int channelsPerSubset);
+    
+    /*
+     Calls kernel with a std::integral_constant holding the channel count for the layouts
+     that get their own specialised kernel (mono, stereo, 5.1, 7.1.4), or 0 for the
+     generic kernel which takes the channel count at runtime.
+     */
+    template<typename Kernel>
+    void dispatch(int numChannels, Kernel&& kernel)
+    {
+        switch (numChannels)
+        {
+            case 1:  kernel(std::integral_constant<int, 1>{});  break;
+            case 2:  kernel(std::integral_constant<int, 2>{});  break;
+            case 6:  kernel(std::integral_constant<int, 6>{});  break;
+            case 12: kernel(std::integral_constant<int, 12>{}); break;
+            default: kernel(std::integral_constant<int, 0>{});  break;
+        }
+    }
+}
@@ -10,25 +10,388 @@
 
 #include "CompressorBand.h"
 
-void CompressorBand::prepare(const juce::dsp::ProcessSpec& spec)
+template<typename SampleType>
+void CompressorBand<SampleType>::allocate(Arena& arena, const juce::dsp::ProcessSpec& spec, int maxOversamplingFactor)
     {
-        compressor.prepare(spec);
+        jassert(spec.numChannels <= (juce::uint32) ChannelLayout::maxChannels);
+        
+        numEnvelopes = static_cast<int>(spec.numChannels);
+        envelopes = arena.allocate<SampleType>(spec.numChannels);
+        
+        maxLookaheadSamples = msToSamples(maxLookaheadMs, spec.sampleRate) * maxOversamplingFactor;
+        
+        for( int i = 0; i < numEnvelopes; ++i )
+        {
+            peakWindows[i].allocate(arena, maxLookaheadSamples);
+            lookaheadDelays[i].allocate(arena, maxLookaheadSamples);
+        }
+        
+        powerWindow.allocate(arena, numEnvelopes, msToSamples(maxDetectorWindowMs, spec.sampleRate));
     }
     
-    void CompressorBand::updateCompressorSettings()
+    template<typename SampleType>
+    void CompressorBand<SampleType>::prepare(const juce::dsp::ProcessSpec& spec, int newOversamplingFactor)
     {
-        compressor.setAttack(attack ->get());
-        compressor.setRelease(release->get());
-        compressor.setThreshold(threshold->get());
-        compressor.setRatio(ratio->getCurrentChoiceName().getFloatValue());
+        jassert(envelopes != nullptr && newOversamplingFactor >= 1);
+        
+        oversamplingFactor = newOversamplingFactor;
+        sampleRate = spec.sampleRate * oversamplingFactor;
+        expFactor = -2.0 * juce::MathConstants<double>::pi * 1000.0 / sampleRate;
+        std::fill(envelopes, envelopes + numEnvelopes, SampleType(0));
+        
+        lookaheadSamples = 0;
+        clearLookahead();
+        powerWindow.clear();
+        powerWindow.setDecimationFactor(oversamplingFactor);
     }
     
-    void CompressorBand::process(juce::AudioBuffer<float>& buffer)
+    template<typename SampleType>
+    void CompressorBand<SampleType>::setChannelGroups(const ChannelLayout::ChannelGroups& groups)
     {
-        auto block = juce::dsp::AudioBlock<float>(buffer);
-        auto context = juce::dsp::ProcessContextReplacing<float>(block);
-
-        context.isBypassed = bypass->get();
-
-        compressor.process(context);
-    }
\ No newline at end of file
+        channelGroups = groups;
+        allChannels = ChannelLayout::makeAllChannels(groups.numChannels);
+        
+        jassert(groups.numChannels <= numEnvelopes);
+        std::fill(envelopes, envelopes + numEnvelopes, SampleType(0));
+        clearLookahead();
+        powerWindow.clear();
+    }
+    
+    template<typename SampleType>
+    void CompressorBand<SampleType>::setMidSide(bool shouldBeMidSide)
+    {
+        if( shouldBeMidSide == midSide )
+            return;
+        
+        // the envelopes and delays were following the other pair of signals
+        midSide = shouldBeMidSide;
+        std::fill(envelopes, envelopes + numEnvelopes, SampleType(0));
+        clearLookahead();
+        powerWindow.clear();
+    }
+    
+    template<typename SampleType>
+    void CompressorBand<SampleType>::clearLookahead()
+    {
+        for( int i = 0; i < numEnvelopes; ++i )
+        {
+            peakWindows[i].clear();
+            lookaheadDelays[i].clear();
+        }
+    }
+    
+    template<typename SampleType>
+    void CompressorBand<SampleType>::updateCompressorSettings(const BandParameters& parameters, bool shouldBeLinked)
+    {
+        // read once per block, so every thread working on this band agrees on it
+        auto wasLinked = linked;
+        linked = shouldBeLinked && ! midSide;
+        bypassed = parameters.bypass;
+        
+        // the delays only run while there is lookahead, so they start from silence again.
+        // Otherwise the window can change length without touching the buffers.
+        // Counted in whole band rate samples, so an oversampled band's latency stays whole
+        auto bandRate = sampleRate / oversamplingFactor;
+        auto newLookaheadSamples = juce::jmin(msToSamples(parameters.lookaheadMs, bandRate) * oversamplingFactor, maxLookaheadSamples);
+        
+        if( newLookaheadSamples > 0 && lookaheadSamples == 0 )
+        {
+            clearLookahead();
+        }
+        else if( linked != wasLinked )
+        {
+            // the windows follow the envelopes, which now mean groups instead of channels or the other way round
+            for( int i = 0; i < numEnvelopes; ++i )
+                peakWindows[i].clear();
+        }
+        
+        lookaheadSamples = newLookaheadSamples;
+        
+        auto newDetectorMode = static_cast<DetectorMode>(parameters.detector);
+        
+        // same as the delays, and a link change re-maps the lanes
+        if( (newDetectorMode != DetectorMode::peak && detectorMode == DetectorMode::peak) || linked != wasLinked )
+            powerWindow.clear();
+        
+        // mean square envelopes hold power, so they get converted rather than jump
+        if( (newDetectorMode == DetectorMode::meanSquare) != (detectorMode == DetectorMode::meanSquare) )
+        {
+            for( int i = 0; i < numEnvelopes; ++i )
+            {
+                envelopes[i] = newDetectorMode == DetectorMode::meanSquare ? envelopes[i] * envelopes[i] : std::sqrt(envelopes[i]);
+                peakWindows[i].clear();
+            }
+        }
+        
+        detectorMode = newDetectorMode;
+        
+        if( detectorMode != DetectorMode::peak )
+            powerWindow.setWindowSize(msToSamples(parameters.detectorWindowMs, bandRate));
+        
+        settings[0] = makeSettings(parameters.attackMs, parameters.releaseMs, parameters.thresholdDecibels, parameters.ratio);
+        settings[1] = makeSettings(parameters.sideAttackMs, parameters.sideReleaseMs, parameters.sideThresholdDecibels, parameters.sideRatio);
+        
+        wetStart = wetEnd;
+        wetEnd = static_cast<SampleType>(parameters.mix * 0.01f);
+    }
+    
+    template<typename SampleType>
+    void CompressorBand<SampleType>::setLinkedLevel(SampleType level)
+    {
+        // mean square envelopes are powers
+        linkedEnvelope = detectorMode == DetectorMode::meanSquare ? level * level : level;
+    }
+    
+    template<typename SampleType>
+    SampleType CompressorBand<SampleType>::getPeakEnvelope() const
+    {
+        auto numActive = linked ? channelGroups.numGroups : channelGroups.numChannels;
+        auto peak = SampleType(0);
+        
+        for( int i = 0; i < numActive; ++i )
+            peak = juce::jmax(peak, envelopes[i]);
+        
+        return detectorMode == DetectorMode::meanSquare ? std::sqrt(peak) : peak;
+    }
+    
+    template<typename SampleType>
+    typename CompressorBand<SampleType>::GainSettings CompressorBand<SampleType>::makeSettings(float attackMs, float releaseMs, float thresholdDecibels, float ratio) const
+    {
+        GainSettings s;
+        s.attackCte = calculateLimitedCte(attackMs);
+        s.releaseCte = calculateLimitedCte(releaseMs);
+        
+        auto thresholdLevel = juce::Decibels::decibelsToGain(static_cast<SampleType>(thresholdDecibels), SampleType(-200));
+        s.gainExponent = SampleType(1) / static_cast<SampleType>(ratio) - SampleType(1);
+        
+        if( detectorMode == DetectorMode::meanSquare )
+        {
+            thresholdLevel *= thresholdLevel;
+            s.gainExponent *= SampleType(0.5);
+        }
+        
+        s.thresholdGain = thresholdLevel;
+        s.thresholdInverse = SampleType(1) / s.thresholdGain;
+        return s;
+    }
+    
+    template<typename SampleType>
+    void CompressorBand<SampleType>::process(juce::AudioBuffer<SampleType>& buffer)
+    {
+        jassert(buffer.getNumChannels() == allChannels.numChannels);
+        process(buffer.getArrayOfWritePointers(), buffer.getNumSamples(), allChannels);
+    }
+    
+    template<typename SampleType>
+    void CompressorBand<SampleType>::process(SampleType* const* busChannels, int numSamples, const ChannelLayout::ChannelSubset& subset, const SampleType* const* keyChannels)
+    {
+        auto numChannels = subset.numChannels;
+        
+        // the band keeps its latency when bypassed
+        if( bypassed )
+        {
+            if( lookaheadSamples > 0 )
+            {
+                for( int i = 0; i < numChannels; ++i )
+                {
+                    auto ch = subset.channels[i];
+                    auto* samples = busChannels[ch];
+                    
+                    for( int s = 0; s < numSamples; ++s )
+                        samples[s] = lookaheadDelays[ch].push(samples[s], lookaheadSamples);
+                }
+            }
+            
+            return;
+        }
+        
+        std::array<SampleType*, ChannelLayout::maxChannels> channels;
+        std::array<const SampleType*, ChannelLayout::maxChannels> detectorChannels;
+        
+        for( int i = 0; i < numChannels; ++i )
+        {
+            channels[i] = busChannels[subset.channels[i]];
+            detectorChannels[i] = keyChannels != nullptr ? keyChannels[subset.channels[i]] : channels[i];
+        }
+        
+        // owning the whole bus means owning every lane of the power window, so all of them can go through SIMD
+        auto ownsAllLanes = numChannels == channelGroups.numChannels;
+        
+        ChannelLayout::dispatch(numChannels, [&](auto channelCount)
+        {
+            constexpr auto NumChannels = decltype(channelCount)::value;
+            
+            if( linked )
+                this->template processLinked<NumChannels>(channels.data(), detectorChannels.data(), subset.channels.data(), numChannels, numSamples, ownsAllLanes);
+            else
+                this->template processUnlinked<NumChannels>(channels.data(), detectorChannels.data(), subset.channels.data(), numChannels, numSamples, ownsAllLanes);
+        });
+        
+        // only touch the envelopes this subset owns, another thread may be running the rest
+        for( int i = 0; i < numChannels; ++i )
+        {
+            auto ch = subset.channels[i];
+            juce::dsp::util::snapToZero(envelopes[linked ? channelGroups.groupOfChannel[ch] : ch]);
+        }
+    }
+    
+    template<typename SampleType>
+    template<int NumChannels>
+    void CompressorBand<SampleType>::processUnlinked(SampleType* const* channels, const SampleType* const* detectorChannels, const int* channelIndex, int numChannels, int numSamples, bool ownsAllLanes)
+    {
+        const auto nc = NumChannels == 0 ? numChannels : NumChannels;
+        const auto usesPower = detectorMode != DetectorMode::peak;
+        
+        // every subset of the band sees the whole block, so they all ramp the mix the same way
+        const auto rampScale = SampleType(1) / static_cast<SampleType>(juce::jmax(1, numSamples));
+        
+        std::array<const GainSettings*, ChannelLayout::maxChannels> channelSettings;
+        std::array<GainTangent, ChannelLayout::maxChannels> tangents;
+        
+        for( int ch = 0; ch < nc; ++ch )
+        {
+            channelSettings[ch] = &getSettings(channelIndex[ch]);
+            tangents[ch] = channelSettings[ch]->makeTangent(envelopes[channelIndex[ch]]);
+        }
+        
+        // lanes past nc stay silent
+        alignas(Arena::alignment) std::array<SampleType, ChannelLayout::maxChannels> powers {}, means {};
+        jassert(! ownsAllLanes || channelIndex[nc - 1] == nc - 1);
+        
+        for( int i = 0; i < numSamples; ++i )
+        {
+            if( usesPower )
+            {
+                if( ownsAllLanes )
+                {
+                    for( int ch = 0; ch < nc; ++ch )
+                        powers[ch] = detectorChannels[ch][i] * detectorChannels[ch][i];
+                    
+                    powerWindow.pushAll(powers.data(), means.data());
+                }
+                else
+                {
+                    for( int ch = 0; ch < nc; ++ch )
+                        means[ch] = powerWindow.push(channelIndex[ch], detectorChannels[ch][i] * detectorChannels[ch][i]);
+                }
+            }
+            
+            for( int ch = 0; ch < nc; ++ch )
+            {
+                auto index = channelIndex[ch];
+                auto x = channels[ch][i];
+                auto level = getLevel(detectorChannels[ch][i], means[ch]);
+                
+                if( lookaheadSamples > 0 )
+                {
+                    level = peakWindows[index].push(level, lookaheadSamples);
+                    x = lookaheadDelays[index].push(x, lookaheadSamples);
+                }
+                
+                auto env = channelSettings[ch]->detect(envelopes[index], juce::jmax(level, linkedEnvelope));
+                channels[ch][i] = mixGain(channelSettings[ch]->computeGain(env, tangents[ch]), i, rampScale) * x;
+            }
+        }
+    }
+    
+    template<typename SampleType>
+    template<int NumChannels>
+    void CompressorBand<SampleType>::processLinked(SampleType* const* channels, const SampleType* const* detectorChannels, const int* channelIndex, int numChannels, int numSamples, bool ownsAllLanes)
+    {
+        const auto nc = NumChannels == 0 ? numChannels : NumChannels;
+        
+        // which groups this call owns, and which of them every channel feeds
+        std::array<int, ChannelLayout::maxChannels> groupOf, groups;
+        std::array<bool, ChannelLayout::maxChannels> ownsGroup {};
+        auto numGroups = 0;
+        
+        for( int ch = 0; ch < nc; ++ch )
+        {
+            groupOf[ch] = channelGroups.groupOfChannel[channelIndex[ch]];
+            
+            if( ! ownsGroup[groupOf[ch]] )
+            {
+                ownsGroup[groupOf[ch]] = true;
+                groups[numGroups++] = groupOf[ch];
+            }
+        }
+        
+        std::array<SampleType, ChannelLayout::maxChannels> peaks {}, gains, groupScales {};
+        std::array<GainTangent, ChannelLayout::maxChannels> tangents;
+        
+        // mid/side never links, so every group shares the one set of settings
+        const auto& s = settings[0];
+        
+        for( int g = 0; g < numGroups; ++g )
+            tangents[groups[g]] = s.makeTangent(envelopes[groups[g]]);
+        
+        // a group's power is the mean over its channels, all of which are in this call
+        for( int ch = 0; ch < nc; ++ch )
+            groupScales[groupOf[ch]] += SampleType(1);
+        
+        for( int g = 0; g < numGroups; ++g )
+            groupScales[groups[g]] = SampleType(1) / groupScales[groups[g]];
+        
+        const auto usesPower = detectorMode != DetectorMode::peak;
+        const auto rampScale = SampleType(1) / static_cast<SampleType>(juce::jmax(1, numSamples));
+        alignas(Arena::alignment) std::array<SampleType, ChannelLayout::maxChannels> powers {}, means {};
+        
+        for( int i = 0; i < numSamples; ++i )
+        {
+            if( usesPower )
+            {
+                for( int g = 0; g < numGroups; ++g )
+                    powers[groups[g]] = 0;
+            
+                for( int ch = 0; ch < nc; ++ch )
+                    powers[groupOf[ch]] += detectorChannels[ch][i] * detectorChannels[ch][i];
+                
+                for( int g = 0; g < numGroups; ++g )
+                    powers[groups[g]] *= groupScales[groups[g]];
+                
+                if( ownsAllLanes )
+                {
+                    powerWindow.pushAll(powers.data(), means.data());
+                }
+                else
+                {
+                    for( int g = 0; g < numGroups; ++g )
+                        means[groups[g]] = powerWindow.push(groups[g], powers[groups[g]]);
+                }
+            }
+            else
+            {
+                peaks.fill(0);
+                
+                for( int ch = 0; ch < nc; ++ch )
+                    peaks[groupOf[ch]] = juce::jmax(peaks[groupOf[ch]], std::abs(detectorChannels[ch][i]));
+            }
+            
+            // the detector and the gain computer only run once per group
+            for( int g = 0; g < numGroups; ++g )
+            {
+                auto group = groups[g];
+                auto level = getLevel(peaks[group], means[group]);
+                
+                if( lookaheadSamples > 0 )
+                    level = peakWindows[group].push(level, lookaheadSamples);
+                
+                auto env = s.detect(envelopes[group], juce::jmax(level, linkedEnvelope));
+                gains[group] = mixGain(s.computeGain(env, tangents[group]), i, rampScale);
+            }
+            
+            if( lookaheadSamples > 0 )
+            {
+                for( int ch = 0; ch < nc; ++ch )
+                    channels[ch][i] = gains[groupOf[ch]] * lookaheadDelays[channelIndex[ch]].push(channels[ch][i], lookaheadSamples);
+            }
+            else
+            {
+                for( int ch = 0; ch < nc; ++ch )
+                    channels[ch][i] *= gains[groupOf[ch]];
+            }
+        }
+    }
+    
+    template struct CompressorBand<float>;
+    template struct CompressorBand<double>;
@@ -11,22 +11,220 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "ChannelLayout.h"
+#include "Arena.h"
+#include "Lookahead.h"
+#include "PowerWindow.h"
 
+// one band's settings as plain values, so the DSP never needs the plugin's parameters. Defaults are the plugin's
+struct BandParameters
+{
+    float attackMs = 5.f, releaseMs = 250.f, thresholdDecibels = 0.f, ratio = 3.f;
+    
+    // the side channel's own settings in mid/side, the mid uses the ones above
+    float sideAttackMs = 5.f, sideReleaseMs = 250.f, sideThresholdDecibels = 0.f, sideRatio = 3.f;
+    
+    bool bypass = false, mute = false, solo = false;
+    float lookaheadMs = 0.f;
+    int detector = 0; // CompressorBand::DetectorMode
+    float detectorWindowMs = 50.f; // for the RMS and mean square detectors
+    int oversampling = 0; // 0 = off, 1 = 2x, 2 = 4x. Read by whoever owns the oversamplers
+    float mix = 100.f; // percent wet
+};
+
+template<typename SampleType>
 struct CompressorBand
 {
-    juce::AudioParameterFloat* attack {nullptr};
-    juce::AudioParameterFloat* release {nullptr};
-    juce::AudioParameterFloat* threshold {nullptr};
-    juce::AudioParameterChoice* ratio {nullptr};
-    juce::AudioParameterBool* bypass {nullptr};
-    juce::AudioParameterBool* mute {nullptr};
-    juce::AudioParameterBool* solo {nullptr};
+    enum class DetectorMode
+    {
+        peak,
+        rms,
+        meanSquare,
+    };
+    
+    static constexpr float maxLookaheadMs = 10.f;
+    static constexpr float maxDetectorWindowMs = 300.f;
+    
+    static int msToSamples(float ms, double sampleRate)
+    {
+        return juce::roundToInt(ms * 0.001 * sampleRate);
+    }
+    
+    // the envelopes, lookahead buffers and power windows live in the arena, called from Arena::build() before prepare().
+    // Sized at the host rate, which is the highest band rate, times the most oversampling the band can run at
+    void allocate(Arena& arena, const juce::dsp::ProcessSpec& spec, int maxOversamplingFactor = 1);
     
-    void prepare(const juce::dsp::ProcessSpec& spec);
+    // spec is at the band rate, the detector and gain stage run oversamplingFactor times faster
+    void prepare(const juce::dsp::ProcessSpec& spec, int oversamplingFactor = 1);
+    void setChannelGroups(const ChannelLayout::ChannelGroups& groups);
     
-    void updateCompressorSettings();
+    // stereo only: bus channels 0 and 1 carry mid and side, which never link. Realtime safe, switching clears the detectors
+    void setMidSide(bool shouldBeMidSide);
     
-    void process(juce::AudioBuffer<float>& buffer);
+    // read once per block. linked is shared by all bands
+    void updateCompressorSettings(const BandParameters& parameters, bool shouldBeLinked);
+    
+    void process(juce::AudioBuffer<SampleType>& buffer);
+    
+    // processes only some of the bus channels, so bands x channel groups can run on different threads.
+    // When linked, the subset has to hold whole link groups.
+    // keyChannels, when given, is what the detector follows instead of the band: bus channel indexed, at the same rate
+    void process(SampleType* const* busChannels, int numSamples, const ChannelLayout::ChannelSubset& subset, const SampleType* const* keyChannels = nullptr);
+    
+    bool isLinked() const { return linked; }
+    
+    // another instance's envelope for this band, see SharedDsp's link bus. The detector follows whichever
+    // of it and the band's own level is louder, so it gets the band's attack and release like any other input
+    // and a new block's level glides in rather than stepping. Set once per block, after updateCompressorSettings()
+    void setLinkedLevel(SampleType level);
+    
+    // the loudest of the band's envelopes, as an amplitude whatever the detector. Between blocks only
+    SampleType getPeakEnvelope() const;
+    
+    // the band's latency, in samples at the band rate it was prepared at. Only changes in updateCompressorSettings()
+    int getLookaheadSamples() const { return lookaheadSamples / oversamplingFactor; }
 private:
-    juce::dsp::Compressor<float> compressor;
-};
\ No newline at end of file
+    /*
+     Same peak detector and gain computer as juce::dsp::Compressor, but the envelopes
+     live in one array so the kernels can be specialised on channel count.
+     When linked, there is one envelope per channel group instead of one per channel.
+     channelIndex maps the kernel's channels back to bus channels, which own the envelopes.
+     
+     The envelope is cheap and runs every sample, the gain computer's pow() is what costs.
+     So pow() only runs when the envelope has moved more than maxEnvelopeDrift away from
+     where it last ran, in between the gain follows the curve's tangent at that point.
+     
+     With lookahead, the detector is fed the maximum over the next lookaheadSamples
+     and the audio is delayed to match, so the gain is already down when a peak arrives.
+     
+     The RMS and mean square detectors feed the envelope with the mean of x^2 over
+     the detector window instead of |x|. RMS takes its square root and stays in the
+     amplitude domain. Mean square keeps the envelope in the power domain, so the
+     threshold is squared and the gain exponent halved. When linked, a group's power
+     is the mean over its channels.
+     
+     The band's dry/wet mix is folded into the gain: dry * x + wet * gain * x. The dry
+     is the very same (delayed) band, so parallel compression can't comb filter.
+     It ramps linearly over each block from the last block's mix.
+     
+     In mid/side the crossover has already encoded the bus, so mid and side are just
+     the two lanes of the stereo kernel, each with its own GainSettings.
+     
+     The detector reads detectorChannels, which are the band's own channels unless
+     there is an external key. They can be the same pointers, so every sample is
+     read from both before the gain is written back.
+     */
+    template<int NumChannels>
+    void processUnlinked(SampleType* const* channels, const SampleType* const* detectorChannels, const int* channelIndex, int numChannels, int numSamples, bool ownsAllLanes);
+    
+    template<int NumChannels>
+    void processLinked(SampleType* const* channels, const SampleType* const* detectorChannels, const int* channelIndex, int numChannels, int numSamples, bool ownsAllLanes);
+    
+    // what the envelope follows, from |x| or from the mean power over the window
+    SampleType getLevel(SampleType x, SampleType meanPower) const
+    {
+        switch (detectorMode)
+        {
+            case DetectorMode::rms: return std::sqrt(meanPower);
+            case DetectorMode::meanSquare: return meanPower;
+            case DetectorMode::peak: break;
+        }
+        
+        return std::abs(x);
+    }
+    
+    /*
+     Above the threshold the gain is envelope^gainExponent, which is convex, so the
+     tangent always sits a little below it: it can only compress slightly more, never
+     let a transient through. The error grows with the square of the drift, up to about
+     0.09 dB at ratio 100 and maxEnvelopeDrift.
+     */
+    static constexpr SampleType maxEnvelopeDrift = SampleType(0.1);
+    
+    struct GainTangent
+    {
+        SampleType low = 0, high = 0; // envelope range the tangent is trusted over
+        SampleType base = 0, gain = 1, slope = 0;
+    };
+    
+    // the detector and gain computer's constants, every channel uses settings[0] but the side in mid/side
+    struct GainSettings
+    {
+        SampleType thresholdGain = 1, thresholdInverse = 1, gainExponent = 0; // gain = (envelope / threshold)^gainExponent above the threshold
+        SampleType attackCte = 0, releaseCte = 0;
+        
+        SampleType detect(SampleType& envelope, SampleType input) const
+        {
+            auto cte = input > envelope ? attackCte : releaseCte;
+            envelope = input + cte * (envelope - input);
+            return envelope;
+        }
+        
+        SampleType computeGain(SampleType envelope) const
+        {
+            return envelope < thresholdGain ? SampleType(1) : std::pow(envelope * thresholdInverse, gainExponent);
+        }
+        
+        GainTangent makeTangent(SampleType envelope) const
+        {
+            GainTangent t;
+            t.base = juce::jmax(envelope, thresholdGain);
+            t.gain = computeGain(t.base);
+            t.slope = t.gain * gainExponent / t.base;
+            t.low = t.base * (SampleType(1) - maxEnvelopeDrift);
+            t.high = t.base * (SampleType(1) + maxEnvelopeDrift);
+            return t;
+        }
+        
+        SampleType computeGain(SampleType envelope, GainTangent& tangent) const
+        {
+            if( envelope < thresholdGain )
+                return SampleType(1);
+            
+            if( envelope < tangent.low || envelope > tangent.high )
+                tangent = makeTangent(envelope);
+            
+            return tangent.gain + tangent.slope * (envelope - tangent.base);
+        }
+    };
+    
+    GainSettings makeSettings(float attackMs, float releaseMs, float thresholdDecibels, float ratio) const;
+    
+    const GainSettings& getSettings(int busChannel) const { return settings[midSide && busChannel == 1 ? 1 : 0]; }
+    
+    // 1 - wet + wet * gain, with wet ramped across the block. rampScale is 1 / the block's length
+    SampleType mixGain(SampleType gain, int sample, SampleType rampScale) const
+    {
+        auto wet = wetStart + (wetEnd - wetStart) * static_cast<SampleType>(sample + 1) * rampScale;
+        return SampleType(1) + wet * (gain - SampleType(1));
+    }
+    
+    SampleType calculateLimitedCte(SampleType timeMs) const
+    {
+        return timeMs < SampleType(1.0e-3) ? SampleType(0) : static_cast<SampleType>(std::exp(expFactor / timeMs));
+    }
+    
+    void clearLookahead();
+    
+    bool linked = false, midSide = false, bypassed = false;
+    double sampleRate = 0.0, expFactor = 0.0; // at the oversampled rate
+    SampleType linkedEnvelope = 0; // in the envelopes' domain, 0 when nothing is linked
+    int oversamplingFactor = 1;
+    std::array<GainSettings, 2> settings;
+    SampleType wetStart = 1, wetEnd = 1;
+    
+    SampleType* envelopes = nullptr; // one per channel, or per group when linked
+    int numEnvelopes = 0;
+    
+    // windows are indexed like the envelopes, delays by bus channel
+    std::array<SlidingMaximum<SampleType>, ChannelLayout::maxChannels> peakWindows;
+    std::array<LookaheadDelay<SampleType>, ChannelLayout::maxChannels> lookaheadDelays;
+    int lookaheadSamples = 0, maxLookaheadSamples = 0;
+    
+    // one lane per envelope, at the band rate
+    PowerWindow<SampleType> powerWindow;
+    DetectorMode detectorMode = DetectorMode::peak;
+    
+    ChannelLayout::ChannelGroups channelGroups;
+    ChannelLayout::ChannelSubset allChannels;
+};
@@ -0,0 +1,215 @@
+/*
+  ==============================================================================
+
+    CpuDispatch.cpp
+
+  ==============================================================================
+*/
+
+#include "CpuDispatch.h"
+
+#if SIMPLEMBCOMP_WIDE_KERNELS
+ // the wide registers only cross calls that SIMPLEMBCOMP_TARGET inlines away, see CpuDispatch.h
+ #pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+namespace
+{
+    std::atomic<int> overrideIndex { -1 };
+    
+    CpuDispatch::InstructionSet detect()
+    {
+        // the builtins look at the OS's saved register state as well as CPUID,
+        // so a CPU with AVX-512 under an OS that doesn't save zmm reads as avx2
+       #if SIMPLEMBCOMP_WIDE_KERNELS
+        __builtin_cpu_init();
+        
+        if( __builtin_cpu_supports("avx512f") )
+            return CpuDispatch::InstructionSet::avx512;
+        
+        if( __builtin_cpu_supports("avx2") )
+            return CpuDispatch::InstructionSet::avx2;
+       #endif
+        
+        return CpuDispatch::InstructionSet::baseline;
+    }
+    
+    CpuDispatch::InstructionSet getDetected()
+    {
+        static const auto detected = detect();
+        return detected;
+    }
+    
+    CpuDispatch::InstructionSet fromEnvironment(CpuDispatch::InstructionSet detected)
+    {
+        auto name = juce::SystemStats::getEnvironmentVariable("SIMPLEMBCOMP_ISA", {}).trim().toLowerCase();
+        
+        for( auto instructionSet : { CpuDispatch::InstructionSet::baseline, CpuDispatch::InstructionSet::avx2, CpuDispatch::InstructionSet::avx512 } )
+        {
+            if( name == juce::String(CpuDispatch::getName(instructionSet)).toLowerCase() )
+                return juce::jmin(instructionSet, detected);
+        }
+        
+        return detected;
+    }
+    
+    template<typename Register>
+    void addRow(typename Register::SampleType* dest, const typename Register::SampleType* source, int numSamples)
+    {
+        auto i = 0;
+        
+        for( ; i + Register::width <= numSamples; i += Register::width )
+            Register::store(dest + i, Register::load(dest + i) + Register::load(source + i));
+        
+        for( ; i < numSamples; ++i )
+            dest[i] += source[i];
+    }
+    
+    template<typename Register>
+    void addMidSideRows(typename Register::SampleType* left,
+                        typename Register::SampleType* right,
+                        const typename Register::SampleType* mid,
+                        const typename Register::SampleType* side,
+                        int numSamples)
+    {
+        auto i = 0;
+        
+        for( ; i + Register::width <= numSamples; i += Register::width )
+        {
+            auto m = Register::load(mid + i), s = Register::load(side + i);
+            Register::store(left + i, Register::load(left + i) + (m + s));
+            Register::store(right + i, Register::load(right + i) + (m - s));
+        }
+        
+        for( ; i < numSamples; ++i )
+        {
+            left[i] += mid[i] + side[i];
+            right[i] += mid[i] - side[i];
+        }
+    }
+   
+   #if SIMPLEMBCOMP_WIDE_KERNELS
+    template<typename SampleType>
+    SIMPLEMBCOMP_TARGET("avx2") void addAvx2(SampleType* dest, const SampleType* source, int numSamples)
+    {
+        addRow<CpuDispatch::WideRegister<SampleType, 32>>(dest, source, numSamples);
+    }
+    
+    template<typename SampleType>
+    SIMPLEMBCOMP_TARGET("avx512f") void addAvx512(SampleType* dest, const SampleType* source, int numSamples)
+    {
+        addRow<CpuDispatch::WideRegister<SampleType, 64>>(dest, source, numSamples);
+    }
+    
+    template<typename SampleType>
+    SIMPLEMBCOMP_TARGET("avx2") void addMidSideAvx2(SampleType* left, SampleType* right, const SampleType* mid, const SampleType* side, int numSamples)
+    {
+        addMidSideRows<CpuDispatch::WideRegister<SampleType, 32>>(left, right, mid, side, numSamples);
+    }
+    
+    template<typename SampleType>
+    SIMPLEMBCOMP_TARGET("avx512f") void addMidSideAvx512(SampleType* left, SampleType* right, const SampleType* mid, const SampleType* side, int numSamples)
+    {
+        addMidSideRows<CpuDispatch::WideRegister<SampleType, 64>>(left, right, mid, side, numSamples);
+    }
+   #endif
+}
+
+namespace CpuDispatch
+{
+    InstructionSet getInstructionSet()
+    {
+        static const auto best = fromEnvironment(getDetected());
+        
+        auto index = overrideIndex.load();
+        return index < 0 ? best : juce::jmin(static_cast<InstructionSet>(index), getDetected());
+    }
+    
+    bool isAvailable(InstructionSet instructionSet)
+    {
+        return instructionSet <= getDetected();
+    }
+    
+    const char* getName(InstructionSet instructionSet)
+    {
+        switch (instructionSet)
+        {
+            case InstructionSet::avx2:   return "AVX2";
+            case InstructionSet::avx512: return "AVX512";
+            case InstructionSet::baseline: break;
+        }
+       
+       #if JUCE_ARM
+        return "NEON";
+       #elif JUCE_INTEL
+        return "SSE2";
+       #else
+        return "Scalar";
+       #endif
+    }
+    
+    void setOverride(InstructionSet instructionSet)
+    {
+        overrideIndex = static_cast<int>(instructionSet);
+    }
+    
+    void clearOverride()
+    {
+        overrideIndex = -1;
+    }
+    
+    template<typename SampleType>
+    int getRegisterWidth(InstructionSet instructionSet)
+    {
+        switch (instructionSet)
+        {
+            case InstructionSet::avx2:   return 32 / static_cast<int>(sizeof(SampleType));
+            case InstructionSet::avx512: return 64 / static_cast<int>(sizeof(SampleType));
+            case InstructionSet::baseline: break;
+        }
+        
+        return BaselineRegister<SampleType>::width;
+    }
+    
+    template<typename SampleType>
+    void add(InstructionSet instructionSet, SampleType* dest, const SampleType* source, int numSamples)
+    {
+       #if SIMPLEMBCOMP_WIDE_KERNELS
+        if( instructionSet == InstructionSet::avx512 )
+            return addAvx512(dest, source, numSamples);
+        
+        if( instructionSet == InstructionSet::avx2 )
+            return addAvx2(dest, source, numSamples);
+       #endif
+        
+        juce::ignoreUnused(instructionSet);
+        juce::FloatVectorOperations::add(dest, source, numSamples);
+    }
+    
+    template<typename SampleType>
+    void addMidSide(InstructionSet instructionSet,
+                    SampleType* left,
+                    SampleType* right,
+                    const SampleType* mid,
+                    const SampleType* side,
+                    int numSamples)
+    {
+       #if SIMPLEMBCOMP_WIDE_KERNELS
+        if( instructionSet == InstructionSet::avx512 )
+            return addMidSideAvx512(left, right, mid, side, numSamples);
+        
+        if( instructionSet == InstructionSet::avx2 )
+            return addMidSideAvx2(left, right, mid, side, numSamples);
+       #endif
+        
+        juce::ignoreUnused(instructionSet);
+        addMidSideRows<ScalarRegister<SampleType>>(left, right, mid, side, numSamples);
+    }
+    
+    template int getRegisterWidth<float>(InstructionSet);
+    template int getRegisterWidth<double>(InstructionSet);
+    template void add<float>(InstructionSet, float*, const float*, int);
+    template void add<double>(InstructionSet, double*, const double*, int);
+    template void addMidSide<float>(InstructionSet, float*, float*, const float*, const float*, int);
+    template void addMidSide<double>(InstructionSet, double*, double*, const double*, const double*, int);
+}
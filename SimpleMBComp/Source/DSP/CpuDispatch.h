@@ -0,0 +1,130 @@
+/*
+  ==============================================================================
+
+    CpuDispatch.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+ The plugin ships as one binary, built for the baseline every machine has (SSE2 on
+ x86, NEON on ARM, through juce::dsp::SIMDRegister). The kernels that get faster
+ with wider registers are also compiled for AVX2 and AVX-512, and the processor
+ picks the best the CPU has once per prepareToPlay.
+ 
+ Each wider build is a function marked with SIMPLEMBCOMP_TARGET. Everything it calls
+ is inlined into it and compiled for that instruction set, so no code the rest of the
+ plugin shares is ever built with instructions an older CPU doesn't have.
+ That needs GCC or Clang attributes, other compilers only get the baseline.
+
+ Wherever the target has FMA (AVX-512 here, every ARM Mac, -march=native builds) the compilers
+ may fuse a multiply and an add, rounding once where code without it rounds twice, and they fuse
+ the scalar and the vector kernels differently. So Source/DSP has to be built with contraction
+ off: every .jucer gives its DSP files the strictFloatingPoint compiler flag scheme
+ (-ffp-contract=off) and setup.py passes the same flag. Then every instruction set and every
+ packing of channels into registers renders bit for bit the same.
+ */
+#if JUCE_INTEL && (JUCE_GCC || JUCE_CLANG)
+ #define SIMPLEMBCOMP_WIDE_KERNELS 1
+ #define SIMPLEMBCOMP_TARGET(isa) __attribute__((target(isa), flatten))
+#else
+ #define SIMPLEMBCOMP_WIDE_KERNELS 0
+#endif
+
+namespace CpuDispatch
+{
+    enum class InstructionSet
+    {
+        baseline,
+        avx2,
+        avx512,
+    };
+    
+    // the widest this CPU and build can run, or the override. Only detected once per process
+    InstructionSet getInstructionSet();
+    
+    bool isAvailable(InstructionSet instructionSet);
+    const char* getName(InstructionSet instructionSet);
+    
+    /*
+     For testing every path on one machine. Anything the CPU can't run falls back to the
+     next one down. Only picked up by the next prepareToPlay. The SIMPLEMBCOMP_ISA
+     environment variable (baseline, avx2 or avx512) does the same for a host.
+     */
+    void setOverride(InstructionSet instructionSet);
+    void clearOverride();
+    
+    // rows and lanes padded to this suit every instruction set, so switching never reallocates
+    constexpr int maxRegisterBytes = 64;
+    
+    template<typename SampleType>
+    constexpr int maxRegisterWidth() { return maxRegisterBytes / static_cast<int>(sizeof(SampleType)); }
+    
+    // lanes per register on an instruction set
+    template<typename SampleType>
+    int getRegisterWidth(InstructionSet instructionSet);
+    
+    /*
+     Loads, stores and broadcasts for one register, so a kernel is written once against
+     Register::Vec and stamped out for every instruction set.
+     */
+    
+    // one lane, for kernels that give every channel its own
+    template<typename Sample>
+    struct ScalarRegister
+    {
+        using SampleType = Sample;
+        using Vec = Sample;
+        static constexpr int width = 1;
+        static Vec load(const SampleType* p) { return *p; }
+        static void store(SampleType* p, Vec v) { *p = v; }
+        static Vec expand(SampleType v) { return v; }
+    };
+    
+    // what every build can count on. Pointers have to be SIMD aligned
+    template<typename Sample>
+    struct BaselineRegister
+    {
+        using SampleType = Sample;
+        using Vec = juce::dsp::SIMDRegister<SampleType>;
+        static constexpr int width = static_cast<int>(Vec::SIMDNumElements);
+        static Vec load(const SampleType* p) { return Vec::fromRawArray(p); }
+        static void store(SampleType* p, Vec v) { v.copyToRawArray(p); }
+        static Vec expand(SampleType v) { return Vec::expand(v); }
+    };
+   
+   #if SIMPLEMBCOMP_WIDE_KERNELS
+    // Bytes wide, in the compiler's vector extensions. Only ever used inside SIMPLEMBCOMP_TARGET functions,
+    // which inline all of this, so no register is ever passed under the baseline ABI the compiler warns about
+   #pragma GCC diagnostic push
+   #pragma GCC diagnostic ignored "-Wpsabi"
+    template<typename Sample, int Bytes>
+    struct WideRegister
+    {
+        using SampleType = Sample;
+        typedef SampleType Vec __attribute__((vector_size(Bytes)));
+        static constexpr int width = Bytes / static_cast<int>(sizeof(SampleType));
+        static Vec load(const SampleType* p) { Vec v; std::memcpy(&v, p, sizeof(Vec)); return v; }
+        static void store(SampleType* p, Vec v) { std::memcpy(p, &v, sizeof(Vec)); }
+        static Vec expand(SampleType v) { return Vec {} + v; }
+    };
+   #pragma GCC diagnostic pop
+   #endif
+    
+    // summing the bands back into the bus. Any alignment
+    template<typename SampleType>
+    void add(InstructionSet instructionSet, SampleType* dest, const SampleType* source, int numSamples);
+    
+    // the same while decoding mid and side back to left and right
+    template<typename SampleType>
+    void addMidSide(InstructionSet instructionSet,
+                    SampleType* left,
+                    SampleType* right,
+                    const SampleType* mid,
+                    const SampleType* side,
+                    int numSamples);
+}
@@ -0,0 +1,922 @@
+/*
+  ==============================================================================
+
+    Crossover.cpp
+
+  ==============================================================================
+*/
+
+#include "Crossover.h"
+
+#if SIMPLEMBCOMP_WIDE_KERNELS
+ // the wide registers only cross calls that SIMPLEMBCOMP_TARGET inlines away, see CpuDispatch.h
+ #pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+namespace
+{
+    // every register the kernels can run on lines up with the lanes, and ranges never split one
+    template<typename SampleType>
+    constexpr bool lanesFillWholeRegisters()
+    {
+        return ChannelLayout::maxChannels % CpuDispatch::maxRegisterWidth<SampleType>() == 0;
+    }
+    
+    static_assert(lanesFillWholeRegisters<float>() && lanesFillWholeRegisters<double>(), "");
+    
+    /*
+     A Linkwitz-Riley crossover of order 2N is an Nth order Butterworth, squared. In TPT sections:
+     LR2 is one critically damped section (the 1st order Butterworth twice over), LR4 is the
+     Butterworth section twice, LR8 is both sections of the 4th order Butterworth, twice.
+     The allpass that matches the crossover takes one section per damping.
+     */
+    template<int Order>
+    struct LinkwitzRileyCascade;
+    
+    template<>
+    struct LinkwitzRileyCascade<2>
+    {
+        static constexpr int numSections = 1; // per lowpass or highpass
+        static constexpr int damping[] = { 0 };
+        static constexpr double R2[] = { 2.0 };
+        
+        // LR2's highpass is half a turn off the lowpass, so it gets flipped to sum flat.
+        // That also makes its allpass first order: LP - HP rather than LP - R2 * BP + HP
+        static constexpr bool invertsHighpass = true;
+    };
+    
+    template<>
+    struct LinkwitzRileyCascade<4>
+    {
+        static constexpr int numSections = 2;
+        static constexpr int damping[] = { 0, 0 };
+        static constexpr double R2[] = { 1.4142135623730951 };
+        static constexpr bool invertsHighpass = false;
+    };
+    
+    template<>
+    struct LinkwitzRileyCascade<8>
+    {
+        static constexpr int numSections = 4;
+        static constexpr int damping[] = { 0, 1, 0, 1 };
+        static constexpr double R2[] = { 1.8477590650225735, 0.7653668647301796 }; // 2 cos(pi / 8), 2 cos(3 pi / 8)
+        static constexpr bool invertsHighpass = false;
+    };
+    
+    // acc += x * taps, bin by bin, for both lowpasses at once. JUCE's real only layout interleaves each bin's real and imaginary parts
+    void multiplyAddSpectra(float* lowMid, float* midHigh, const float* x, const float* lowMidTaps, const float* midHighTaps, int size)
+    {
+        for( int k = 0; k < size; k += 2 )
+        {
+            auto re = x[k], im = x[k + 1];
+            
+            lowMid[k] += re * lowMidTaps[k] - im * lowMidTaps[k + 1];
+            lowMid[k + 1] += re * lowMidTaps[k + 1] + im * lowMidTaps[k];
+            
+            midHigh[k] += re * midHighTaps[k] - im * midHighTaps[k + 1];
+            midHigh[k + 1] += re * midHighTaps[k + 1] + im * midHighTaps[k];
+        }
+    }
+    
+    // one TPT 2nd order section, same maths as juce::dsp::LinkwitzRileyFilter::processSample
+    template<typename Vec>
+    struct Section
+    {
+        Vec yH, yB, yL;
+        
+        Section(Vec x, Vec& s1, Vec& s2, Vec g, Vec R2plusG, Vec h)
+        {
+            yH = (x - R2plusG * s1 - s2) * h;
+            
+            yB = g * yH + s1;
+            s1 = g * yH + yB;
+            
+            yL = g * yB + s2;
+            s2 = g * yB + yL;
+        }
+    };
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::allocate(Arena& arena, const juce::dsp::ProcessSpec& spec)
+{
+    jassert(spec.numChannels <= (juce::uint32) ChannelLayout::maxChannels);
+    
+    // the generic kernel sweeps whole registers, so the lanes are rounded up to the widest one
+    // any instruction set has. That also keeps every section aligned
+    const auto maxWidth = static_cast<juce::uint32>(CpuDispatch::maxRegisterWidth<SampleType>());
+    numLanes = static_cast<int>((spec.numChannels + maxWidth - 1) / maxWidth * maxWidth);
+    numHistoryChannels = static_cast<int>(spec.numChannels);
+    
+    // room for the steepest slope, so switching never allocates
+    numStateSamples = 2 * numLanes * maxSections;
+    state = arena.allocate<SampleType>(static_cast<size_t>(numStateSamples));
+    
+    maxBlockSize = (int) spec.maximumBlockSize;
+    gainRamp = arena.allocate<SampleType>(spec.maximumBlockSize);
+    
+    // ~85 ms either side, enough to resolve the lowest crossover. The FFT is 4 times that
+    // so the magnitude's impulse has decayed before it wraps round
+    linearPhaseLatency = juce::jmin(8192, juce::nextPowerOfTwo(juce::roundToInt(spec.sampleRate / 12.0)));
+    numTaps = 2 * linearPhaseLatency + 1;
+    designOrder = juce::roundToInt(std::log2(4.0 * linearPhaseLatency));
+    
+    // short partitions keep the direct form one cheap, longer ones mean fewer spectra to multiply.
+    // The history holds the centre tap's input, which is always at least two partitions back
+    partitionSize = juce::jlimit(1, 128, linearPhaseLatency / 2);
+    numPartitions = (numTaps + partitionSize - 1) / partitionSize - 1;
+    historySize = linearPhaseLatency + 1;
+    convolutionOrder = juce::roundToInt(std::log2(2.0 * partitionSize));
+    spectrumSize = 2 * (partitionSize + 1);
+}
+
+template<typename SampleType>
+std::unique_ptr<typename Crossover<SampleType>::LinearPhaseBuffers> Crossover<SampleType>::buildLinearPhase() const
+{
+    // sized by allocate(), which has to have seen the same spec
+    jassert(numTaps > 0);
+    
+    auto buffers = std::make_unique<LinearPhaseBuffers>();
+    
+    buffers->arena.build([this, &buffers](Arena& a)
+    {
+        buffers->lowMidTaps = a.allocate<SampleType>(static_cast<size_t>(linearPhaseLatency + 1));
+        buffers->midHighTaps = a.allocate<SampleType>(static_cast<size_t>(linearPhaseLatency + 1));
+        buffers->history = a.allocate<SampleType>(static_cast<size_t>(2 * historySize * numHistoryChannels));
+        buffers->designBuffer = a.allocate<float>(static_cast<size_t>(2 << designOrder));
+        
+        // JUCE's transforms work in place in twice their size
+        const auto spectraSize = static_cast<size_t>(numPartitions * spectrumSize);
+        buffers->lowMidSpectra = a.allocate<float>(spectraSize);
+        buffers->midHighSpectra = a.allocate<float>(spectraSize);
+        buffers->inputSpectra = a.allocate<float>(spectraSize * static_cast<size_t>(numHistoryChannels));
+        buffers->convolutionBuffers = a.allocate<float>(static_cast<size_t>((4 << convolutionOrder) * numHistoryChannels));
+        buffers->tails = a.allocate<SampleType>(static_cast<size_t>(2 * partitionSize * numHistoryChannels));
+    });
+    
+    shared->prepareFFT(designOrder);
+    buffers->designWindow = shared->getBlackmanHalfWindow(linearPhaseLatency + 1);
+    
+    for( int ch = 0; ch < numHistoryChannels; ++ch )
+        buffers->convolutionFFTs[static_cast<size_t>(ch)] = std::make_unique<juce::dsp::FFT>(convolutionOrder);
+    
+    return buffers;
+}
+
+template<typename SampleType>
+std::unique_ptr<typename Crossover<SampleType>::LinearPhaseBuffers> Crossover<SampleType>::swapLinearPhase(std::unique_ptr<LinearPhaseBuffers> newBuffers)
+{
+    // minimum phase while the old buffers are still there, the new ones start from silence
+    setLinearPhase(false);
+    std::swap(linearPhaseBuffers, newBuffers);
+    
+    historyPositions.fill(0);
+    partitionPositions.fill(0);
+    inputSpectraPositions.fill(0);
+    
+    // and the taps have to be designed into them
+    designedLowMid = designedMidHigh = -1.f;
+    
+    return newBuffers;
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::prepare(const juce::dsp::ProcessSpec& spec)
+{
+    jassert(state != nullptr && (int) spec.maximumBlockSize <= maxBlockSize && (int) spec.numChannels == numHistoryChannels);
+    
+    sampleRate = spec.sampleRate;
+    
+    // the table stops short of nyquist, so every entry and its neighbour are on the tan() curve
+    if( warpTableRate != sampleRate )
+    {
+        warpTableTop = juce::jmin(maxWarpCutoff, static_cast<int>(std::ceil(sampleRate * 0.5)) - 1);
+        warpTable = shared->getWarpTable(sampleRate, warpTableTop + 1);
+        warpTableRate = sampleRate;
+    }
+    
+    designedLowMid = designedMidHigh = -1.f;
+    lowMidRamp.cutoff = midHighRamp.cutoff = -1.f;
+    
+    reset();
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::reset()
+{
+    std::fill(state, state + numStateSamples, SampleType(0));
+    
+    if( canBeLinearPhase() )
+        clearLinearPhase();
+    
+    // the filters start over, so there's nothing to glide from
+    snapCoefficients = true;
+    
+    inputGain.reset(sampleRate, inputGainRampDurationSeconds);
+}
+
+template<typename SampleType>
+double Crossover<SampleType>::warp(float cutoff) const
+{
+    jassert(juce::isPositiveAndBelow(cutoff, static_cast<float>(sampleRate * 0.5)));
+    jassert(warpTableRate == sampleRate);
+    
+    if( cutoff >= static_cast<float>(warpTableTop) )
+        return std::tan(juce::MathConstants<double>::pi * cutoff / sampleRate);
+    
+    // whole Hz cutoffs, all the parameters can land on, come straight out of the table
+    auto index = static_cast<int>(cutoff);
+    auto fraction = static_cast<double>(cutoff) - index;
+    
+    return warpTable[index] + fraction * (warpTable[index + 1] - warpTable[index]);
+}
+
+template<typename SampleType>
+typename Crossover<SampleType>::Coefficients Crossover<SampleType>::makeCoefficients(double g, double R2)
+{
+    Coefficients c;
+    c.g  = (SampleType) g;
+    c.R2 = (SampleType) R2;
+    c.h  = (SampleType) (1.0 / (1.0 + R2 * g + g * g));
+    
+    return c;
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::updateCoefficients(CoefficientRamp& ramp, float cutoff)
+{
+    if( cutoff == ramp.cutoff )
+        return;
+    
+    ramp.cutoff = cutoff;
+    
+    // one warp for every damping
+    auto g = warp(cutoff);
+    
+    auto update = [&ramp, g](const auto& dampings)
+    {
+        for( size_t i = 0; i < std::size(dampings); ++i )
+            ramp.target[i] = makeCoefficients(g, dampings[i]);
+    };
+    
+    switch (slope)
+    {
+        case Slope::lr12: update(LinkwitzRileyCascade<2>::R2); break;
+        case Slope::lr24: update(LinkwitzRileyCascade<4>::R2); break;
+        case Slope::lr48: update(LinkwitzRileyCascade<8>::R2); break;
+    }
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::setCrossoverFrequencies(float newLowMidCutoff, float newMidHighCutoff)
+{
+    lowMidCutoff = newLowMidCutoff;
+    midHighCutoff = newMidHighCutoff;
+    
+    // cheap when nothing moved, which is most blocks
+    updateCoefficients(lowMidRamp, lowMidCutoff);
+    updateCoefficients(midHighRamp, midHighCutoff);
+    
+    // the taps cost an FFT each, so only when they are in use and a cutoff has moved
+    auto redesigned = false;
+    
+    if( linearPhase && lowMidCutoff != designedLowMid )
+    {
+        designLinearPhase(linearPhaseBuffers->lowMidTaps, lowMidCutoff);
+        transformPartitions(linearPhaseBuffers->lowMidTaps, linearPhaseBuffers->lowMidSpectra);
+        designedLowMid = lowMidCutoff;
+        redesigned = true;
+    }
+    
+    if( linearPhase && midHighCutoff != designedMidHigh )
+    {
+        designLinearPhase(linearPhaseBuffers->midHighTaps, midHighCutoff);
+        transformPartitions(linearPhaseBuffers->midHighTaps, linearPhaseBuffers->midHighSpectra);
+        designedMidHigh = midHighCutoff;
+        redesigned = true;
+    }
+    
+    // the rest of the current partition comes out of the new taps as well, as it did when the
+    // whole convolution was direct form
+    if( redesigned )
+    {
+        for( int ch = 0; ch < numHistoryChannels; ++ch )
+            convolvePartitions(ch);
+    }
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::setLinearPhase(bool shouldBeLinearPhase)
+{
+    shouldBeLinearPhase = shouldBeLinearPhase && canBeLinearPhase();
+    
+    if( shouldBeLinearPhase == linearPhase )
+        return;
+    
+    linearPhase = shouldBeLinearPhase;
+    
+    // whichever mode takes over starts from silence, like after prepare()
+    if( linearPhase )
+    {
+        clearLinearPhase();
+        setCrossoverFrequencies(lowMidCutoff, midHighCutoff);
+    }
+    else
+    {
+        std::fill(state, state + numStateSamples, SampleType(0));
+    }
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::setSlope(Slope newSlope)
+{
+    if( newSlope == slope )
+        return;
+    
+    // the sections now belong to other filters, and the coefficients and taps have the old dampings
+    slope = newSlope;
+    std::fill(state, state + numStateSamples, SampleType(0));
+    designedLowMid = designedMidHigh = -1.f;
+    lowMidRamp.cutoff = midHighRamp.cutoff = -1.f;
+    snapCoefficients = true;
+    
+    if( lowMidCutoff > 0.f && midHighCutoff > 0.f )
+        setCrossoverFrequencies(lowMidCutoff, midHighCutoff);
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::setInstructionSet(CpuDispatch::InstructionSet newInstructionSet)
+{
+    // the lanes are laid out the same whatever sweeps them, so the state carries over
+    instructionSet = newInstructionSet;
+    channelsPerRange = CpuDispatch::getRegisterWidth<SampleType>(instructionSet);
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::setMidSide(bool shouldBeMidSide)
+{
+    if( shouldBeMidSide == midSide )
+        return;
+    
+    // the filters hold the other pair of signals
+    midSide = shouldBeMidSide;
+    reset();
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::designLinearPhase(SampleType* taps, float cutoff)
+{
+    auto& buffers = *linearPhaseBuffers;
+    const auto fftSize = 1 << designOrder;
+    const auto pi = juce::MathConstants<double>::pi;
+    const auto g = std::tan(pi * cutoff / sampleRate);
+    const auto order = slope == Slope::lr12 ? 2.0 : (slope == Slope::lr24 ? 4.0 : 8.0);
+    
+    // the IIR mode's lowpass magnitude, bilinear warping included: 1 / (1 + (tan(pi f / fs) / g)^order).
+    // Real and even, so the inverse FFT gives a zero phase impulse centred on sample 0
+    std::fill(buffers.designBuffer, buffers.designBuffer + 2 * fftSize, 0.f);
+    
+    for( int k = 0; k <= fftSize / 2; ++k )
+    {
+        auto r = k == fftSize / 2 ? 0.0 : std::tan(pi * k / fftSize) / g;
+        auto magnitude = k == fftSize / 2 ? 0.f : static_cast<float>(1.0 / (1.0 + std::pow(r, order)));
+        
+        buffers.designBuffer[2 * k] = magnitude;
+        
+        if( k > 0 )
+            buffers.designBuffer[2 * (fftSize - k)] = magnitude;
+    }
+    
+    shared->performRealOnlyInverseTransform(designOrder, buffers.designBuffer);
+    
+    // Blackman window over the kept taps, then back to unity gain at DC
+    auto sum = 0.0;
+    
+    for( int d = 0; d <= linearPhaseLatency; ++d )
+    {
+        auto tap = buffers.designBuffer[d] * buffers.designWindow[d];
+        
+        taps[d] = static_cast<SampleType>(tap);
+        sum += d == 0 ? tap : 2.0 * tap;
+    }
+    
+    for( int d = 0; d <= linearPhaseLatency; ++d )
+        taps[d] = static_cast<SampleType>(taps[d] / sum);
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::transformPartitions(const SampleType* taps, float* spectra)
+{
+    // between blocks, so the first channel's plan and the design's buffer are free
+    auto& buffers = *linearPhaseBuffers;
+    const auto fftSize = 1 << convolutionOrder;
+    auto& fft = *buffers.convolutionFFTs[0];
+    
+    for( int p = 0; p < numPartitions; ++p )
+    {
+        std::fill(buffers.designBuffer, buffers.designBuffer + 2 * fftSize, 0.f);
+        
+        // the whole filter is the taps mirrored about the centre, numTaps long. Partition 0 stays direct form
+        for( int i = 0; i < partitionSize; ++i )
+        {
+            auto n = (p + 1) * partitionSize + i;
+            
+            if( n < numTaps )
+                buffers.designBuffer[i] = static_cast<float>(taps[std::abs(n - linearPhaseLatency)]);
+        }
+        
+        fft.performRealOnlyForwardTransform(buffers.designBuffer, true);
+        std::copy(buffers.designBuffer, buffers.designBuffer + spectrumSize, spectra + p * spectrumSize);
+    }
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::pushPartition(int channel, const SampleType* input)
+{
+    auto& buffers = *linearPhaseBuffers;
+    const auto fftSize = 1 << convolutionOrder;
+    auto* buffer = buffers.convolutionBuffers + 2 * fftSize * 2 * channel;
+    
+    for( int i = 0; i < fftSize; ++i )
+        buffer[i] = static_cast<float>(input[i]);
+    
+    buffers.convolutionFFTs[static_cast<size_t>(channel)]->performRealOnlyForwardTransform(buffer, true);
+    
+    // a ring of spectra, newest first
+    auto& newest = inputSpectraPositions[static_cast<size_t>(channel)];
+    newest = (newest == 0 ? numPartitions : newest) - 1;
+    
+    std::copy(buffer, buffer + spectrumSize, buffers.inputSpectra + (channel * numPartitions + newest) * spectrumSize);
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::convolvePartitions(int channel)
+{
+    auto& buffers = *linearPhaseBuffers;
+    const auto fftSize = 1 << convolutionOrder;
+    auto* lowMid = buffers.convolutionBuffers + 2 * fftSize * 2 * channel;
+    auto* midHigh = lowMid + 2 * fftSize;
+    
+    std::fill(lowMid, lowMid + spectrumSize, 0.f);
+    std::fill(midHigh, midHigh + spectrumSize, 0.f);
+    
+    // partition p + 1 of the taps meets the input from p partitions back
+    const auto* spectra = buffers.inputSpectra + channel * numPartitions * spectrumSize;
+    auto position = inputSpectraPositions[static_cast<size_t>(channel)];
+    
+    for( int p = 0; p < numPartitions; ++p )
+    {
+        multiplyAddSpectra(lowMid, midHigh, spectra + position * spectrumSize,
+                           buffers.lowMidSpectra + p * spectrumSize, buffers.midHighSpectra + p * spectrumSize, spectrumSize);
+        
+        if( ++position == numPartitions )
+            position = 0;
+    }
+    
+    auto& fft = *buffers.convolutionFFTs[static_cast<size_t>(channel)];
+    fft.performRealOnlyInverseTransform(lowMid);
+    fft.performRealOnlyInverseTransform(midHigh);
+    
+    // overlap-save: the transforms took two partitions of input, only the second half is free of wrap around
+    auto* tail = buffers.tails + 2 * partitionSize * channel;
+    
+    for( int i = 0; i < partitionSize; ++i )
+    {
+        tail[i] = static_cast<SampleType>(lowMid[partitionSize + i]);
+        tail[partitionSize + i] = static_cast<SampleType>(midHigh[partitionSize + i]);
+    }
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::clearLinearPhase()
+{
+    auto& buffers = *linearPhaseBuffers;
+    std::fill(buffers.history, buffers.history + 2 * historySize * numHistoryChannels, SampleType(0));
+    std::fill(buffers.inputSpectra, buffers.inputSpectra + numPartitions * spectrumSize * numHistoryChannels, 0.f);
+    std::fill(buffers.tails, buffers.tails + 2 * partitionSize * numHistoryChannels, SampleType(0));
+    
+    historyPositions.fill(0);
+    partitionPositions.fill(0);
+    inputSpectraPositions.fill(0);
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::setInputGainRampDurationSeconds(double newDurationSeconds)
+{
+    if( inputGainRampDurationSeconds != newDurationSeconds )
+    {
+        inputGainRampDurationSeconds = newDurationSeconds;
+        inputGain.reset(sampleRate, inputGainRampDurationSeconds);
+    }
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::setInputGainDecibels(float gainDecibels)
+{
+    inputGain.setTargetValue(juce::Decibels::decibelsToGain(static_cast<SampleType>(gainDecibels)));
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::process(const juce::AudioBuffer<SampleType>& inputBuffer,
+                                    std::array<juce::AudioBuffer<SampleType>, 3>& bandBuffers,
+                                    juce::AudioBuffer<SampleType>* dryBuffer)
+{
+    auto numChannels = juce::jmin(inputBuffer.getNumChannels(),
+                                  bandBuffers[0].getNumChannels(),
+                                  ChannelLayout::maxChannels);
+    
+    beginBlock(inputBuffer, bandBuffers, dryBuffer);
+    processRange(0, numChannels);
+    endBlock();
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::beginBlock(const juce::AudioBuffer<SampleType>& inputBuffer,
+                                       std::array<juce::AudioBuffer<SampleType>, 3>& bandBuffers,
+                                       juce::AudioBuffer<SampleType>* dryBuffer)
+{
+    auto numSamples = inputBuffer.getNumSamples();
+    jassert(numSamples <= maxBlockSize);
+    blockSize = juce::jmin(numSamples, maxBlockSize);
+    
+    // the band buffers refer to the arena, the processor points them at this block's length
+    jassert(std::all_of(bandBuffers.begin(), bandBuffers.end(),
+                        [this](const auto& bb) { return bb.getNumSamples() == blockSize; }));
+    
+    inputChannels = inputBuffer.getArrayOfReadPointers();
+    lowChannels = bandBuffers[0].getArrayOfWritePointers();
+    midChannels = bandBuffers[1].getArrayOfWritePointers();
+    highChannels = bandBuffers[2].getArrayOfWritePointers();
+    
+    jassert(dryBuffer == nullptr || dryBuffer->getNumSamples() == blockSize);
+    dryChannels = dryBuffer != nullptr ? dryBuffer->getArrayOfWritePointers() : nullptr;
+    
+    // the smoothed gain advances once per sample frame, exactly like dsp::Gain
+    for( int i = 0; i < blockSize; ++i )
+        gainRamp[i] = inputGain.getNextValue();
+    
+    // coefficients that moved since the last block get there by its last sample
+    rampingCoefficients = false;
+    
+    for( auto* ramp : { &lowMidRamp, &midHighRamp } )
+    {
+        if( snapCoefficients || blockSize == 0 )
+        {
+            ramp->current = ramp->target;
+            continue;
+        }
+        
+        for( size_t d = 0; d < ramp->target.size(); ++d )
+        {
+            ramp->gStep[d] = (ramp->target[d].g - ramp->current[d].g) / static_cast<SampleType>(blockSize);
+            rampingCoefficients = rampingCoefficients || ramp->gStep[d] != SampleType(0);
+        }
+    }
+    
+    snapCoefficients = false;
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::processRange(int firstChannel, int numChannels)
+{
+    jassert(inputChannels != nullptr);
+    jassert(firstChannel % channelsPerRange == 0);
+    jassert(firstChannel + numChannels <= ChannelLayout::maxChannels);
+    
+    if( linearPhase )
+    {
+        processLinearPhase(firstChannel, numChannels);
+        return;
+    }
+    
+    // a kernel per channel count and slope, so neither is branched on per sample.
+    // The generic one also per instruction set
+    auto processWithOrder = [&](auto order)
+    {
+        constexpr auto Order = decltype(order)::value;
+        
+        ChannelLayout::dispatch(numChannels, [&](auto channelCount)
+        {
+            constexpr auto NumChannels = decltype(channelCount)::value;
+            
+           #if SIMPLEMBCOMP_WIDE_KERNELS
+            if constexpr (NumChannels == 0)
+            {
+                if( instructionSet == CpuDispatch::InstructionSet::avx512 )
+                    return this->template processChannelsAvx512<Order>(firstChannel, numChannels);
+                
+                if( instructionSet == CpuDispatch::InstructionSet::avx2 )
+                    return this->template processChannelsAvx2<Order>(firstChannel, numChannels);
+            }
+           #endif
+            
+            using Register = std::conditional_t<NumChannels == 0,
+                                                CpuDispatch::BaselineRegister<SampleType>,
+                                                CpuDispatch::ScalarRegister<SampleType>>;
+            
+            this->template processChannels<NumChannels, Order, Register>(inputChannels,
+                                                                         lowChannels,
+                                                                         midChannels,
+                                                                         highChannels,
+                                                                         dryChannels,
+                                                                         firstChannel,
+                                                                         numChannels,
+                                                                         blockSize);
+        });
+    };
+    
+    switch (slope)
+    {
+        case Slope::lr12: processWithOrder(std::integral_constant<int, 2>{}); break;
+        case Slope::lr24: processWithOrder(std::integral_constant<int, 4>{}); break;
+        case Slope::lr48: processWithOrder(std::integral_constant<int, 8>{}); break;
+    }
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::endBlock()
+{
+    snapToZero();
+    
+    if( rampingCoefficients )
+    {
+        lowMidRamp.current = lowMidRamp.target;
+        midHighRamp.current = midHighRamp.target;
+        rampingCoefficients = false;
+    }
+    
+    inputChannels = nullptr;
+    lowChannels = midChannels = highChannels = dryChannels = nullptr;
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::processLinearPhase(int firstChannel, int numChannelsInRange)
+{
+    auto& buffers = *linearPhaseBuffers;
+    const auto encodes = midSide && firstChannel == 0;
+    
+    // the first partition of taps, in the order of the inputs it meets, oldest first
+    const auto* lowMidHead = buffers.lowMidTaps + historySize - partitionSize;
+    const auto* midHighHead = buffers.midHighTaps + historySize - partitionSize;
+    
+    for( int ch = firstChannel; ch < firstChannel + numChannelsInRange; ++ch )
+    {
+        auto* samples = buffers.history + 2 * historySize * ch;
+        auto position = historyPositions[ch];
+        auto partitionPosition = partitionPositions[ch];
+        const auto* lowMidTail = buffers.tails + 2 * partitionSize * ch;
+        const auto* midHighTail = lowMidTail + partitionSize;
+        
+        for( int i = 0; i < blockSize; ++i )
+        {
+            auto x = inputChannels[ch][i] * gainRamp[i];
+            
+            if( encodes && ch < 2 )
+                x = (inputChannels[0][i] + (ch == 0 ? inputChannels[1][i] : -inputChannels[1][i])) * SampleType(0.5) * gainRamp[i];
+            samples[position] = x;
+            samples[position + historySize] = x;
+            
+            if( ++position == historySize )
+                position = 0;
+            
+            // oldest first, so w[0] is the input latency samples ago and the newest partition ends the window
+            const auto* w = samples + position;
+            const auto* recent = w + historySize - partitionSize;
+            auto lp1 = lowMidTail[partitionPosition];
+            auto lp2 = midHighTail[partitionPosition];
+            
+            for( int d = 0; d < partitionSize; ++d )
+            {
+                lp1 += lowMidHead[d] * recent[d];
+                lp2 += midHighHead[d] * recent[d];
+            }
+            
+            lowChannels[ch][i] = lp1;
+            midChannels[ch][i] = lp2 - lp1;
+            highChannels[ch][i] = w[0] - lp2;
+            
+            if( dryChannels != nullptr )
+                dryChannels[ch][i] = w[0];
+            
+            // the later partitions' share of the next partition of outputs only needs what's in by now
+            if( ++partitionPosition == partitionSize )
+            {
+                partitionPosition = 0;
+                pushPartition(ch, w + historySize - 2 * partitionSize);
+                convolvePartitions(ch);
+            }
+        }
+        
+        historyPositions[ch] = position;
+        partitionPositions[ch] = partitionPosition;
+    }
+    
+    // channel by channel there's no mid and side at hand together, so the dry gets decoded afterwards
+    if( encodes && dryChannels != nullptr )
+    {
+        for( int i = 0; i < blockSize; ++i )
+        {
+            auto m = dryChannels[0][i], s = dryChannels[1][i];
+            dryChannels[0][i] = m + s;
+            dryChannels[1][i] = m - s;
+        }
+    }
+}
+
+#if SIMPLEMBCOMP_WIDE_KERNELS
+template<typename SampleType>
+template<int Order>
+void Crossover<SampleType>::processChannelsAvx2(int firstChannel, int numChannels)
+{
+    processChannels<0, Order, CpuDispatch::WideRegister<SampleType, 32>>(inputChannels,
+                                                                         lowChannels,
+                                                                         midChannels,
+                                                                         highChannels,
+                                                                         dryChannels,
+                                                                         firstChannel,
+                                                                         numChannels,
+                                                                         blockSize);
+}
+
+template<typename SampleType>
+template<int Order>
+void Crossover<SampleType>::processChannelsAvx512(int firstChannel, int numChannels)
+{
+    processChannels<0, Order, CpuDispatch::WideRegister<SampleType, 64>>(inputChannels,
+                                                                         lowChannels,
+                                                                         midChannels,
+                                                                         highChannels,
+                                                                         dryChannels,
+                                                                         firstChannel,
+                                                                         numChannels,
+                                                                         blockSize);
+}
+#endif
+
+template<typename SampleType>
+template<int NumChannels, int Order, typename Register>
+void Crossover<SampleType>::processChannels(const SampleType* const* input,
+                                            SampleType* const* low,
+                                            SampleType* const* mid,
+                                            SampleType* const* high,
+                                            SampleType* const* dry,
+                                            int firstChannel,
+                                            int numChannels,
+                                            int numSamples)
+{
+    // NumChannels == 0 is the generic kernel, which sweeps whole registers of channels
+    constexpr auto width = Register::width;
+    const auto first = firstChannel;
+    const auto last = firstChannel + (NumChannels == 0 ? numChannels : NumChannels);
+    const auto encodes = midSide && first == 0;
+    jassert(! encodes || last >= 2);
+    
+    // lanes are indexed by bus channel. Unused lanes stay silent, so their filter state never leaves zero
+    alignas(64) Lanes in {}, lo {}, md {}, hi {};
+    
+    // every range works out the same ramp from the block's start, so threads never share it
+    constexpr auto numDampings = static_cast<int>(std::size(LinkwitzRileyCascade<Order>::R2));
+    auto lowMid = lowMidRamp.current, midHigh = midHighRamp.current;
+    
+    for( int i = 0; i < numSamples; ++i )
+    {
+        auto gain = gainRamp[i];
+        
+        if( rampingCoefficients )
+        {
+            auto n = static_cast<SampleType>(i + 1);
+            
+            for( int d = 0; d < numDampings; ++d )
+            {
+                lowMid[d].g = lowMidRamp.current[d].g + lowMidRamp.gStep[d] * n;
+                midHigh[d].g = midHighRamp.current[d].g + midHighRamp.gStep[d] * n;
+                
+                // h always matches this sample's g, so every sample is a stable filter
+                lowMid[d].h = SampleType(1) / (SampleType(1) + lowMid[d].R2 * lowMid[d].g + lowMid[d].g * lowMid[d].g);
+                midHigh[d].h = SampleType(1) / (SampleType(1) + midHigh[d].R2 * midHigh[d].g + midHigh[d].g * midHigh[d].g);
+            }
+        }
+        
+        for( int ch = first; ch < last; ++ch )
+            in[ch] = input[ch][i] * gain;
+        
+        // mid/side is only ever stereo, which always sits in the first range
+        if( encodes )
+        {
+            auto l = in[0], r = in[1];
+            in[0] = (l + r) * SampleType(0.5);
+            in[1] = (l - r) * SampleType(0.5);
+        }
+        
+        for( int lane = first; lane < last; lane += width )
+            this->template sweepLanes<Register, Order>(lane, in.data(), lo.data(), md.data(), hi.data(), lowMid, midHigh);
+        
+        for( int ch = first; ch < last; ++ch )
+        {
+            low[ch][i] = lo[ch];
+            mid[ch][i] = md[ch];
+            high[ch][i] = hi[ch];
+        }
+        
+        // straight from the lanes, rather than another pass over the band buffers
+        if( dry != nullptr )
+        {
+            for( int ch = first; ch < last; ++ch )
+                dry[ch][i] = lo[ch] + md[ch] + hi[ch];
+            
+            if( encodes )
+            {
+                auto m = dry[0][i], s = dry[1][i];
+                dry[0][i] = m + s;
+                dry[1][i] = m - s;
+            }
+        }
+    }
+}
+
+template<typename SampleType>
+template<typename Register, int Order>
+void Crossover<SampleType>::sweepLanes(int lane,
+                                       const SampleType* in,
+                                       SampleType* low,
+                                       SampleType* mid,
+                                       SampleType* high,
+                                       const CoefficientSet& lowMid,
+                                       const CoefficientSet& midHigh)
+{
+    using Vec = typename Register::Vec;
+    using Cascade = LinkwitzRileyCascade<Order>;
+    
+    // per cutoff: the shared first section, then the rest of the lowpass and of the highpass.
+    // The allpass sits between the two cutoffs
+    constexpr auto n = Cascade::numSections;
+    constexpr auto numDampings = static_cast<int>(std::size(Cascade::R2));
+    constexpr auto lowMidFirst = 0, allpassFirst = 2 * n - 1, midHighFirst = allpassFirst + numDampings;
+    static_assert(midHighFirst + 2 * n - 1 <= maxSections, "");
+    
+    auto tick = [this, lane](auto x, int index, const Coefficients& c)
+    {
+        auto* s1 = state + 2 * numLanes * index + lane;
+        auto* s2 = s1 + numLanes;
+        auto v1 = Register::load(s1);
+        auto v2 = Register::load(s2);
+        
+        Section<Vec> section(x, v1, v2, Register::expand(c.g), Register::expand(c.R2 + c.g), Register::expand(c.h));
+        
+        Register::store(s1, v1);
+        Register::store(s2, v2);
+        
+        return section;
+    };
+    
+    // the lowpass and highpass of one cutoff. They see the same input, so their first sections are identical
+    auto split = [&tick](auto x, int first, const CoefficientSet& c, auto& lp, auto& hp)
+    {
+        auto shared = tick(x, first, c[Cascade::damping[0]]);
+        lp = shared.yL;
+        hp = shared.yH;
+        
+        for( int k = 1; k < n; ++k )
+        {
+            lp = tick(lp, first + k, c[Cascade::damping[k]]).yL;
+            hp = tick(hp, first + n - 1 + k, c[Cascade::damping[k]]).yH;
+        }
+        
+        if constexpr (Cascade::invertsHighpass)
+            hp = Register::expand(SampleType(0)) - hp;
+    };
+    
+    auto x = Register::load(in + lane);
+    auto lp1 = x, hp1 = x;
+    split(x, lowMidFirst, lowMid, lp1, hp1);
+    
+    // AP2 keeps the low band in phase with the mid + high sum
+    for( int d = 0; d < numDampings; ++d )
+    {
+        const auto& c = midHigh[d];
+        auto ap = tick(lp1, allpassFirst + d, c);
+        
+        if constexpr (Cascade::invertsHighpass)
+            lp1 = ap.yL - ap.yH;
+        else
+            lp1 = ap.yL - ap.yB * Register::expand(c.R2) + ap.yH;
+    }
+    
+    Register::store(low + lane, lp1);
+    
+    auto lp2 = x, hp2 = x;
+    split(hp1, midHighFirst, midHigh, lp2, hp2);
+    
+    Register::store(mid + lane, lp2);
+    Register::store(high + lane, hp2);
+}
+
+template<typename SampleType>
+void Crossover<SampleType>::snapToZero()
+{
+    for( int i = 0; i < numStateSamples; ++i )
+        juce::dsp::util::snapToZero(state[i]);
+}
+
+template struct Crossover<float>;
+template struct Crossover<double>;
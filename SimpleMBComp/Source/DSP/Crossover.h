@@ -0,0 +1,277 @@
+/*
+  ==============================================================================
+
+    Crossover.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChannelLayout.h"
+#include "Arena.h"
+#include "CpuDispatch.h"
+#include "SharedDsp.h"
+
+/*
+ 3 band Linkwitz-Riley crossover, 12, 24 or 48 dB/oct. The input trim is applied as
+ a per sample multiplier while each input sample is read, so the host buffer is only
+ touched once per block and the bands are written straight from it.
+ 
+ The filter maths is the same TPT structure as juce::dsp::LinkwitzRileyFilter,
+ but the state is stored one lane per channel so the sweep can be specialised
+ on channel count, or run across channels in whole registers for other layouts.
+ That generic sweep is built for every instruction set CpuDispatch knows.
+ LP1/HP1 and LP2/HP2 share their first section, exactly as the separate
+ filters would have computed it. The sweep is also specialised on the slope, so
+ every slope is its own straight run of sections. The low band's allpass is
+ always built from the same sections as the slope, so the bands still sum flat.
+ 
+ For offline renders there is a linear phase mode: zero phase FIRs with the same
+ magnitudes as the slope, delayed by their centre tap. The bands are split complementarily
+ (low = LP1, mid = LP2 - LP1, high = input - LP2), so they sum back to the delayed
+ input exactly. The taps come from an inverse FFT of the magnitude whenever a
+ cutoff moves. The convolution is uniformly partitioned: the first partition of taps
+ runs direct form, every later one is multiplied in the frequency domain once a
+ partition of input has come in, so it adds no latency. The transforms run in
+ single precision for both sample types, like the design.
+ 
+ Templated on the sample type so double precision hosts run the same kernels natively.
+ */
+template<typename SampleType>
+struct Crossover
+{
+    // carves the filter state and the gain ramp out of the arena, called from Arena::build() before prepare()
+    void allocate(Arena& arena, const juce::dsp::ProcessSpec& spec);
+    
+    /*
+     The linear phase taps, history, spectra and design buffer are far bigger than the filters, so
+     they live in an arena of their own, with the convolution's plans, that's only built while the
+     mode may be wanted.
+     buildLinearPhase() only reads what allocate() sized them for, so it can run while the crossover
+     is processing on another thread, but it isn't realtime safe. swapLinearPhase() is: it hands the
+     crossover what buildLinearPhase() made, or nullptr to go without, and gives back what it had
+     for the caller to free off the audio thread. Without them setLinearPhase() stays minimum phase.
+     */
+    struct LinearPhaseBuffers
+    {
+        Arena arena;
+        
+        // centre first, see designLinearPhase()
+        SampleType* lowMidTaps = nullptr;
+        SampleType* midHighTaps = nullptr;
+        
+        // per channel, the last historySize inputs stored twice over so they are always contiguous:
+        // enough for the centre tap and for the two partitions each transform takes
+        SampleType* history = nullptr;
+        
+        // see the partitions below
+        float* lowMidSpectra = nullptr;
+        float* midHighSpectra = nullptr;
+        float* inputSpectra = nullptr;
+        float* convolutionBuffers = nullptr; // per channel, one transform's worth per lowpass
+        SampleType* tails = nullptr;         // per channel, partitionSize per lowpass
+        
+        // a plan per channel, since some of JUCE's FFT engines keep their scratch space in the plan
+        // and the channel ranges can run on different threads
+        std::array<std::unique_ptr<juce::dsp::FFT>, ChannelLayout::maxChannels> convolutionFFTs;
+        
+        // the design's FFT plan and window are shared, its buffer is in the arena
+        const double* designWindow = nullptr;
+        float* designBuffer = nullptr;
+    };
+    
+    std::unique_ptr<LinearPhaseBuffers> buildLinearPhase() const;
+    std::unique_ptr<LinearPhaseBuffers> swapLinearPhase(std::unique_ptr<LinearPhaseBuffers> newBuffers);
+    bool canBeLinearPhase() const { return linearPhaseBuffers != nullptr; }
+    size_t getLinearPhaseNumBytes() const { return linearPhaseBuffers != nullptr ? linearPhaseBuffers->arena.getNumBytes() : 0; }
+    
+    void prepare(const juce::dsp::ProcessSpec& spec);
+    void reset();
+    
+    void setCrossoverFrequencies(float lowMidCutoff, float midHighCutoff);
+    
+    enum class Slope
+    {
+        lr12,
+        lr24,
+        lr48,
+    };
+    
+    // realtime safe, switching clears the filters and redesigns the linear phase taps
+    void setSlope(Slope newSlope);
+    Slope getSlope() const { return slope; }
+    
+    // realtime safe, switching clears the mode being switched to. Ignored without the linear phase buffers
+    void setLinearPhase(bool shouldBeLinearPhase);
+    bool isLinearPhase() const { return linearPhase; }
+    
+    // stereo only: encodes channels 0 and 1 to mid and side as they are read. The dry output stays left/right.
+    // Realtime safe, switching clears the filters
+    void setMidSide(bool shouldBeMidSide);
+    bool isMidSide() const { return midSide; }
+    
+    // every band is delayed by this much, 0 unless linear phase
+    int getLatencySamples() const { return linearPhase ? linearPhaseLatency : 0; }
+    int getLinearPhaseLatencySamples() const { return linearPhaseLatency; }
+    
+    // same ramp behaviour as juce::dsp::Gain, which this replaces for the input trim
+    void setInputGainRampDurationSeconds(double newDurationSeconds);
+    void setInputGainDecibels(float gainDecibels);
+    
+    // dryBuffer, when given, gets low + mid + high: the input through the same allpasses the bands sum to
+    void process(const juce::AudioBuffer<SampleType>& inputBuffer,
+                 std::array<juce::AudioBuffer<SampleType>, 3>& bandBuffers,
+                 juce::AudioBuffer<SampleType>* dryBuffer = nullptr);
+    
+    /*
+     The same work as process(), split up so that independent channel ranges can run
+     on different threads. beginBlock() and endBlock() bracket the processRange()
+     calls of one block and must be called from a single thread.
+     Ranges must start on a multiple of getChannelsPerRange().
+     */
+    void beginBlock(const juce::AudioBuffer<SampleType>& inputBuffer,
+                    std::array<juce::AudioBuffer<SampleType>, 3>& bandBuffers,
+                    juce::AudioBuffer<SampleType>* dryBuffer = nullptr);
+    void processRange(int firstChannel, int numChannels);
+    void endBlock();
+    
+    // picks the generic layouts' kernel. Only between blocks, the ranges change with it
+    void setInstructionSet(CpuDispatch::InstructionSet newInstructionSet);
+    CpuDispatch::InstructionSet getInstructionSet() const { return instructionSet; }
+    
+    // one register of the instruction set, so ranges never share one
+    int getChannelsPerRange() const { return channelsPerRange; }
+private:
+    using Lanes = std::array<SampleType, ChannelLayout::maxChannels>;
+    
+    struct Coefficients
+    {
+        SampleType g = 0, R2 = 0, h = 0;
+    };
+    
+    // one set per Butterworth damping the slope uses, LR48 has two
+    using CoefficientSet = std::array<Coefficients, 2>;
+    
+    /*
+     The IIR coefficients of one cutoff. A cutoff that moves between blocks doesn't jump:
+     the kernels glide g from where the last block ended to the new target, linearly
+     sample by sample, so automated sweeps don't step. h is worked out from each sample's g
+     rather than glided separately, gliding both drifts off the filter they belong to and big
+     jumps go unstable. Only remade when the cutoff has changed.
+     */
+    struct CoefficientRamp
+    {
+        CoefficientSet target, current;
+        std::array<SampleType, 2> gStep {};
+        float cutoff = -1.f; // what target was made for
+    };
+    
+    CoefficientRamp lowMidRamp, midHighRamp;
+    bool rampingCoefficients = false, snapCoefficients = true;
+    
+    static Coefficients makeCoefficients(double g, double R2);
+    void updateCoefficients(CoefficientRamp& ramp, float cutoff);
+    
+    // tan(pi f / fs) for every whole Hz up to the top of the crossover ranges, shared by every
+    // crossover at this sample rate. Fractional cutoffs interpolate, anything past the table gets tan()
+    static constexpr int maxWarpCutoff = 20000;
+    const double* warpTable = nullptr;
+    double warpTableRate = 0.0;
+    int warpTableTop = 0;
+    
+    double warp(float cutoff) const;
+    
+    // the steepest slope's 2nd order sections, see LinkwitzRileyCascade
+    static constexpr int maxSections = 16;
+    
+    template<int NumChannels, int Order, typename Register>
+    void processChannels(const SampleType* const* input,
+                         SampleType* const* low,
+                         SampleType* const* mid,
+                         SampleType* const* high,
+                         SampleType* const* dry,
+                         int firstChannel,
+                         int numChannels,
+                         int numSamples);
+    
+    // the generic kernel, compiled for the wider instruction sets
+   #if SIMPLEMBCOMP_WIDE_KERNELS
+    template<int Order>
+    SIMPLEMBCOMP_TARGET("avx2") void processChannelsAvx2(int firstChannel, int numChannels);
+    
+    template<int Order>
+    SIMPLEMBCOMP_TARGET("avx512f") void processChannelsAvx512(int firstChannel, int numChannels);
+   #endif
+    
+    template<typename Register, int Order>
+    void sweepLanes(int lane,
+                    const SampleType* in,
+                    SampleType* low,
+                    SampleType* mid,
+                    SampleType* high,
+                    const CoefficientSet& lowMid,
+                    const CoefficientSet& midHigh);
+    
+    void processLinearPhase(int firstChannel, int numChannelsInRange);
+    
+    // taps[0] is the centre, taps[d] sits d samples either side of it
+    void designLinearPhase(SampleType* taps, float cutoff);
+    
+    // the spectra of every partition of taps after the first
+    void transformPartitions(const SampleType* taps, float* spectra);
+    
+    // a partition of input has come in: transforms the last two partitions of it
+    void pushPartition(int channel, const SampleType* input);
+    
+    // the later partitions' share of the next partition of outputs, from the input spectra so far
+    void convolvePartitions(int channel);
+    
+    void clearLinearPhase();
+    
+    void snapToZero();
+    
+    juce::SmoothedValue<SampleType> inputGain;
+    SampleType* gainRamp = nullptr; // the input trim of every sample in the current block
+    
+    // section i's integrator states are at state + 2 * numLanes * i, s1 then s2, a lane per channel
+    SampleType* state = nullptr;
+    int numLanes = 0, numStateSamples = 0;
+    
+    CpuDispatch::InstructionSet instructionSet = CpuDispatch::InstructionSet::baseline;
+    int channelsPerRange = CpuDispatch::BaselineRegister<SampleType>::width;
+    
+    Slope slope = Slope::lr24;
+    bool linearPhase = false, midSide = false;
+    float lowMidCutoff = 0.f, midHighCutoff = 0.f;
+    float designedLowMid = -1.f, designedMidHigh = -1.f; // the cutoffs the taps were made for
+    
+    std::unique_ptr<LinearPhaseBuffers> linearPhaseBuffers;
+    std::array<int, ChannelLayout::maxChannels> historyPositions {};
+    int linearPhaseLatency = 0, numTaps = 0, historySize = 0, numHistoryChannels = 0;
+    
+    /*
+     The taps are cut into partitions of partitionSize. The first one is convolved direct form
+     every sample. The other numPartitions each have a spectrum per cutoff, and every channel keeps
+     the spectra of its last numPartitions input partitions, newest at inputSpectraPositions. Each
+     time a partition of input is complete, the later partitions' contribution to the next
+     partitionSize outputs of both lowpasses is worked out in one go and kept in tails.
+     Spectra are in JUCE's real only layout, bins 0 to partitionSize.
+     */
+    int partitionSize = 0, numPartitions = 0, convolutionOrder = 0, spectrumSize = 0;
+    std::array<int, ChannelLayout::maxChannels> partitionPositions {}, inputSpectraPositions {};
+    
+    // the design's FFT plan and window
+    juce::SharedResourcePointer<SharedDsp> shared;
+    int designOrder = 0;
+    
+    // grabbed once in beginBlock(), so processRange() never touches the AudioBuffers from several threads
+    const SampleType* const* inputChannels = nullptr;
+    SampleType* const* lowChannels = nullptr;
+    SampleType* const* midChannels = nullptr;
+    SampleType* const* highChannels = nullptr;
+    SampleType* const* dryChannels = nullptr;
+    int maxBlockSize = 0, blockSize = 0;
+    double sampleRate = 44100.0, inputGainRampDurationSeconds = 0.0;
+};
@@ -0,0 +1,45 @@
+/*
+  ==============================================================================
+
+    Lookahead.cpp
+
+  ==============================================================================
+*/
+
+#include "Lookahead.h"
+
+template<typename SampleType>
+void LookaheadDelay<SampleType>::allocate(Arena& arena, int maxDelaySamples)
+{
+    capacity = maxDelaySamples + 1;
+    samples = arena.allocate<SampleType>(static_cast<size_t>(capacity));
+}
+
+template<typename SampleType>
+void LookaheadDelay<SampleType>::clear()
+{
+    std::fill(samples, samples + capacity, SampleType(0));
+    position = 0;
+}
+
+template<typename SampleType>
+void SlidingMaximum<SampleType>::allocate(Arena& arena, int maxWindowSize)
+{
+    // a window of n holds n + 1 inputs
+    capacity = maxWindowSize + 1;
+    values = arena.allocate<SampleType>(static_cast<size_t>(capacity));
+    times = arena.allocate<juce::uint32>(static_cast<size_t>(capacity));
+}
+
+template<typename SampleType>
+void SlidingMaximum<SampleType>::clear()
+{
+    head = size = 0;
+    time = 0;
+}
+
+template struct LookaheadDelay<float>;
+template struct LookaheadDelay<double>;
+
+template struct SlidingMaximum<float>;
+template struct SlidingMaximum<double>;
@@ -0,0 +1,87 @@
+/*
+  ==============================================================================
+
+    Lookahead.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Arena.h"
+
+/*
+ Building blocks for the compressor's lookahead. Both are ring buffers in the
+ arena, sized once for the longest window, and the window can change every block.
+ */
+
+// plain delay. The delay can change every block, it reads back whatever went through the line before
+template<typename SampleType>
+struct LookaheadDelay
+{
+    void allocate(Arena& arena, int maxDelaySamples);
+    void clear();
+    
+    SampleType push(SampleType x, int delaySamples)
+    {
+        jassert(delaySamples < capacity);
+        samples[position] = x;
+        
+        auto readPosition = position - delaySamples;
+        if( readPosition < 0 )
+            readPosition += capacity;
+        
+        if( ++position == capacity )
+            position = 0;
+        
+        return samples[readPosition];
+    }
+private:
+    SampleType* samples = nullptr;
+    int capacity = 0, position = 0;
+};
+
+/*
+ Maximum of the last windowSize + 1 inputs, amortised O(1) per sample for any window.
+ Keeps a monotonic deque: values only ever decrease from front to back, since anything
+ smaller than a newer input can never be the maximum again. The front is the maximum.
+ */
+template<typename SampleType>
+struct SlidingMaximum
+{
+    void allocate(Arena& arena, int maxWindowSize);
+    void clear();
+    
+    SampleType push(SampleType x, int windowSize)
+    {
+        // whatever has left the window, the window may also have just got shorter
+        while( size > 0 && time - times[head] > static_cast<juce::uint32>(windowSize) )
+        {
+            if( ++head == capacity )
+                head = 0;
+            
+            --size;
+        }
+        
+        while( size > 0 && values[wrap(head + size - 1)] <= x )
+            --size;
+        
+        auto back = wrap(head + size);
+        values[back] = x;
+        times[back] = time;
+        ++size;
+        
+        // unsigned, so the ages stay right when the counter wraps
+        ++time;
+        
+        return values[head];
+    }
+private:
+    int wrap(int index) const { return index < capacity ? index : index - capacity; }
+    
+    SampleType* values = nullptr;
+    juce::uint32* times = nullptr;
+    int capacity = 0, head = 0, size = 0;
+    juce::uint32 time = 0;
+};
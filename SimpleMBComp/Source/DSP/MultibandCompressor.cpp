@@ -0,0 +1,1087 @@
+/*
+  ==============================================================================
+
+    MultibandCompressor.cpp
+
+  ==============================================================================
+*/
+
+#include "MultibandCompressor.h"
+
+namespace
+{
+    // below this many channel-samples per block, waking the workers costs more than it saves
+    constexpr int minChannelSamplesForWorkerPool = 2048;
+    constexpr int maxWorkerThreads = 3;
+    
+    // a decimated band's rate never drops below these. The low band tops out at 999 Hz,
+    // the mid band at 20 kHz, and the halfbands keep 0.4 of the band rate clean
+    constexpr double minLowBandRate = 11025.0;
+    constexpr double minMidBandRate = 88200.0;
+    
+    int decimationStagesFor(double sampleRate, double minBandRate)
+    {
+        auto stages = 0;
+        
+        while( stages < BandDecimator<float>::maxStages && sampleRate / (2 << stages) >= minBandRate )
+            ++stages;
+        
+        return stages;
+    }
+}
+
+MultibandCompressor::~MultibandCompressor()
+{
+    // embedders don't always call release before deleting us
+    release();
+    sharedDsp->removeInstance(this);
+}
+
+void MultibandCompressor::prepare(double newSampleRate, int newMaximumBlockSize, const juce::AudioChannelSet& channelSet, int numKeyChannels, bool useDoublePrecision)
+{
+    jassert(juce::isPositiveAndNotGreaterThan(channelSet.size(), ChannelLayout::maxChannels));
+    
+    // linked detection is computed once per group of channels, see ChannelLayout
+    auto channelGroups = ChannelLayout::makeChannelGroups(channelSet);
+    
+    prepareForRate(newSampleRate, newMaximumBlockSize, useDoublePrecision);
+    
+    juce::dsp::ProcessSpec spec;
+    spec.maximumBlockSize = static_cast<juce::uint32>(maximumBlockSize);
+    spec.numChannels = static_cast<juce::uint32>(channelGroups.numChannels);
+    spec.sampleRate = sampleRate;
+    
+    // the precision is picked before preparing, so the other chain stays unallocated
+    if( doublePrecision )
+        prepareChain(doubleChain, arena, spec, channelGroups, numKeyChannels);
+    else
+        prepareChain(floatChain, arena, spec, channelGroups, numKeyChannels);
+    
+    // how the bands x channel groups get split up, should the worker pool be switched on
+    linkedWork = ChannelLayout::makeWorkSubsets(channelGroups, true, 2);
+    unlinkedWork = ChannelLayout::makeWorkSubsets(channelGroups, false, 2);
+    numBusChannels = channelGroups.numChannels;
+    
+    updateResources();
+}
+
+void MultibandCompressor::release()
+{
+    numBusChannels = 0;
+    releaseWorkerPool();
+    
+    // nothing we sent is going on any more
+    stopSendingLink();
+}
+
+void MultibandCompressor::updateResources()
+{
+    auto resources = buildResources(parameters);
+    swapResources(*resources);
+}
+
+std::unique_ptr<MultibandCompressor::Resources> MultibandCompressor::buildResources(const Parameters& newParameters)
+{
+    auto resources = std::make_unique<Resources>();
+    resources->engine = this;
+    
+    // stereo never gets enough work to pay for the threads, so only wide buses ask for them
+    auto numWorkers = newParameters.parallelProcessing && numBusChannels > 2
+                    ? juce::jlimit(0, maxWorkerThreads, juce::SystemStats::getNumPhysicalCpus() - 1)
+                    : 0;
+    
+    // one pool for the whole process, however many instances there are. Starting it takes a while
+    if( (numWorkers > 0) != (workerPool != nullptr) )
+    {
+        resources->replaceWorkerPool = true;
+        
+        if( numWorkers > 0 )
+            resources->workerPool = &sharedDsp->acquireWorkerPool(numWorkers, sampleRate, maximumBlockSize);
+    }
+    
+    // the prepared chain, or every batch of streams
+    if( numBusChannels > 0 )
+    {
+        if( doublePrecision )
+            buildChainResources(doubleChain, resources->doubleChain, newParameters);
+        else
+            buildChainResources(floatChain, resources->floatChain, newParameters);
+    }
+    
+    resources->floatBatches.resize(floatBatches.size());
+    resources->doubleBatches.resize(doubleBatches.size());
+    
+    for(size_t i = 0; i < floatBatches.size(); ++i)
+        buildChainResources(floatBatches[i]->chain, resources->floatBatches[i], newParameters);
+    
+    for(size_t i = 0; i < doubleBatches.size(); ++i)
+        buildChainResources(doubleBatches[i]->chain, resources->doubleBatches[i], newParameters);
+    
+    return resources;
+}
+
+void MultibandCompressor::swapResources(Resources& resources)
+{
+    // built for this engine, as it's prepared now
+    jassert(resources.engine == this && resources.floatBatches.size() == floatBatches.size() && resources.doubleBatches.size() == doubleBatches.size());
+    
+    if( resources.replaceWorkerPool )
+        std::swap(workerPool, resources.workerPool);
+    
+    if( numBusChannels > 0 )
+    {
+        if( doublePrecision )
+            swapChainResources(doubleChain, resources.doubleChain);
+        else
+            swapChainResources(floatChain, resources.floatChain);
+    }
+    
+    for(size_t i = 0; i < floatBatches.size(); ++i)
+        swapChainResources(floatBatches[i]->chain, resources.floatBatches[i]);
+    
+    for(size_t i = 0; i < doubleBatches.size(); ++i)
+        swapChainResources(doubleBatches[i]->chain, resources.doubleBatches[i]);
+    
+    // nothing gets swapped back the other way
+    resources.replaceWorkerPool = false;
+}
+
+MultibandCompressor::Resources::~Resources()
+{
+    if( workerPool != nullptr )
+        engine->sharedDsp->releaseWorkerPool();
+    
+    // the chains' old buffers go with the members, what the engine holds is already the new ones
+    engine->sharedDsp->setInstanceFootprint(engine, engine->getDspMemoryFootprint());
+}
+
+template<typename SampleType>
+void MultibandCompressor::buildChainResources(const BandChain<SampleType>& chain, ChainResources<SampleType>& resources, const Parameters& newParameters)
+{
+    if( newParameters.offlineRenderQuality != chain.crossover.canBeLinearPhase() )
+    {
+        resources.replaceLinearPhase = true;
+        
+        if( newParameters.offlineRenderQuality )
+        {
+            resources.linearPhase = chain.crossover.buildLinearPhase();
+            
+            // the key follows the bands into linear phase
+            if( chain.numKeyChannels > 0 )
+                resources.keyLinearPhase = chain.keyCrossover.buildLinearPhase();
+        }
+    }
+    
+    if( newParameters.spectral != (chain.spectral != nullptr) )
+    {
+        resources.replaceSpectral = true;
+        
+        if( newParameters.spectral )
+        {
+            juce::dsp::ProcessSpec spec;
+            spec.maximumBlockSize = static_cast<juce::uint32>(maximumBlockSize);
+            spec.numChannels = static_cast<juce::uint32>(chain.numBandChannels);
+            spec.sampleRate = sampleRate;
+            
+            auto spectral = std::make_unique<typename BandChain<SampleType>::Spectral>();
+            auto& compressor = spectral->compressor;
+            
+            spectral->arena.build([&compressor, &spec](Arena& a)
+            {
+                compressor.allocate(a, spec);
+            });
+            
+            // prepare() resets the trim to where the crossover's is heading, so switching over doesn't ramp it
+            compressor.setInputGainRampDurationSeconds(0.05); // 50ms
+            compressor.setInputGainDecibels(newParameters.inputGainDecibels);
+            compressor.prepare(spec);
+            compressor.setChannelGroups(chain.channelGroups);
+            
+            resources.spectral = std::move(spectral);
+        }
+    }
+}
+
+template<typename SampleType>
+void MultibandCompressor::swapChainResources(BandChain<SampleType>& chain, ChainResources<SampleType>& resources)
+{
+    // the next updateState() switches the modes over to what the chain has now
+    if( resources.replaceLinearPhase )
+    {
+        resources.linearPhase = chain.crossover.swapLinearPhase(std::move(resources.linearPhase));
+        resources.keyLinearPhase = chain.keyCrossover.swapLinearPhase(std::move(resources.keyLinearPhase));
+    }
+    
+    if( resources.replaceSpectral )
+        std::swap(chain.spectral, resources.spectral);
+    
+    resources.replaceLinearPhase = resources.replaceSpectral = false;
+}
+
+
+void MultibandCompressor::prepareForRate(double newSampleRate, int newMaximumBlockSize, bool useDoublePrecision)
+{
+    sampleRate = newSampleRate;
+    maximumBlockSize = newMaximumBlockSize;
+    doublePrecision = useDoublePrecision;
+    
+    maxDecimationStages = { decimationStagesFor(sampleRate, minLowBandRate), decimationStagesFor(sampleRate, minMidBandRate), 0 };
+    
+    // the widest kernels this CPU runs, fixed until the next prepare
+    instructionSet = CpuDispatch::getInstructionSet();
+}
+
+size_t MultibandCompressor::getDspMemoryFootprint() const
+{
+    auto numBytes = arena.getNumBytes() + floatChain.getOptionalBytes() + doubleChain.getOptionalBytes();
+    
+    for(auto& batch : floatBatches)
+        numBytes += batch->arena.getNumBytes() + batch->chain.getOptionalBytes();
+    
+    for(auto& batch : doubleBatches)
+        numBytes += batch->arena.getNumBytes() + batch->chain.getOptionalBytes();
+    
+    return numBytes;
+}
+
+void MultibandCompressor::releaseWorkerPool()
+{
+    if( workerPool != nullptr )
+    {
+        sharedDsp->releaseWorkerPool();
+        workerPool = nullptr;
+    }
+}
+
+template<typename SampleType>
+void MultibandCompressor::prepareChain(BandChain<SampleType>& chain, Arena& chainArena, const juce::dsp::ProcessSpec& spec, const ChannelLayout::ChannelGroups& groups, int numKeyChannels)
+{
+    chain.numKeyChannels = numKeyChannels;
+    chain.channelGroups = groups;
+    chain.allChannels = ChannelLayout::makeAllChannels(groups.numChannels);
+    
+    auto keySpec = spec;
+    keySpec.numChannels = static_cast<juce::uint32>(chain.numKeyChannels);
+    
+    // juce::dsp::Oversampling allocates its own buffers, so these stay out of the arena.
+    // The key's are indexed by bus channel like the band's, or have none at all
+    auto keyOversamplerSpec = spec;
+    keyOversamplerSpec.numChannels = chain.numKeyChannels > 0 ? spec.numChannels : 0;
+    
+    for(size_t i = 0; i < chain.oversamplers.size(); ++i)
+    {
+        chain.oversamplers[i].prepare(spec);
+        chain.keyOversamplers[i].prepare(keyOversamplerSpec);
+    }
+    
+    // sized for the last spec, they're built again further down if they're wanted
+    chain.crossover.swapLinearPhase(nullptr);
+    chain.keyCrossover.swapLinearPhase(nullptr);
+    chain.spectral.reset();
+    
+    // state first, it is touched every sample. Each band channel is its own aligned row
+    chainArena.build([this, &chain, &spec, &keySpec](Arena& a)
+    {
+        chain.crossover.allocate(a, spec);
+        chain.limiter.allocate(a, spec);
+        
+        for(auto& compressor : chain.compressors)
+            compressor.allocate(a, spec, 1 << BandOversampler<SampleType>::maxStages);
+        
+        // any band can end up with the longest lookahead and oversampling latency, at whatever rate it runs
+        auto maxLookahead = 0;
+        
+        for(int stages = 0; stages <= BandDecimator<SampleType>::maxStages; ++stages)
+        {
+            auto samples = CompressorBand<SampleType>::msToSamples(CompressorBand<SampleType>::maxLookaheadMs, spec.sampleRate / (1 << stages));
+            maxLookahead = juce::jmax(maxLookahead, (samples + chain.oversamplers[0].getMaxLatencySamples()) << stages);
+        }
+        
+        // every band's alignment delay is sized for the worst mode. Playback gets padded to the offline
+        // latency and the other way round, so that includes the linear phase crossover, should it get built
+        auto maxDelay = getDecimationLatency<SampleType>(getDecimationStages(2)) + maxLookahead + chain.crossover.getLinearPhaseLatencySamples();
+        
+        // in spectral mode the dry waits for the frames instead
+        maxDelay = juce::jmax(maxDelay, SpectralCompressor<SampleType>::getLatencySamples(spec.sampleRate));
+        
+        for(size_t i = 0; i < chain.decimators.size(); ++i)
+            chain.decimators[i].allocate(a, spec, maxDecimationStages[i], maxDelay);
+        
+        // the dry waits for the slowest band, which never exceeds that either
+        for(juce::uint32 ch = 0; ch < spec.numChannels; ++ch)
+            chain.dryDelays[ch].allocate(a, maxDelay);
+        
+        for(auto& channels : chain.bandChannels)
+        {
+            for(juce::uint32 ch = 0; ch < spec.numChannels; ++ch)
+                channels[ch] = a.allocate<SampleType>(spec.maximumBlockSize);
+        }
+        
+        for(juce::uint32 ch = 0; ch < spec.numChannels; ++ch)
+            chain.dryChannels[ch] = a.allocate<SampleType>(spec.maximumBlockSize);
+        
+        if( chain.numKeyChannels > 0 )
+        {
+            chain.keyCrossover.allocate(a, keySpec);
+            
+            // the key only goes down, so it never needs an alignment delay
+            for(size_t i = 0; i < chain.keyDecimators.size(); ++i)
+                chain.keyDecimators[i].allocate(a, spec, maxDecimationStages[i], 0);
+            
+            for(auto& channels : chain.keyChannels)
+            {
+                for(juce::uint32 ch = 0; ch < keySpec.numChannels; ++ch)
+                    channels[ch] = a.allocate<SampleType>(spec.maximumBlockSize);
+            }
+        }
+    });
+    
+    chain.numBandChannels = static_cast<int>(spec.numChannels);
+    chain.referToBands(static_cast<int>(spec.maximumBlockSize));
+    
+    for(auto& compressor : chain.compressors)
+    {
+        compressor.prepare(spec);
+        compressor.setChannelGroups(groups);
+    }
+    
+    chain.crossover.prepare(spec);
+    chain.crossover.setInstructionSet(instructionSet);
+    
+    // a mono key feeds every channel's detector
+    if( chain.numKeyChannels > 0 )
+    {
+        chain.keyCrossover.prepare(keySpec);
+        chain.keyCrossover.setInstructionSet(instructionSet);
+        chain.keyCrossover.setInputGainDecibels(0.f);
+        
+        for(size_t i = 0; i < chain.keyChannels.size(); ++i)
+        {
+            for(int ch = 0; ch < chain.numBandChannels; ++ch)
+                chain.keyBusChannels[i][ch] = chain.keyChannels[i][chain.numKeyChannels == 1 ? 0 : ch];
+        }
+    }
+    
+    chain.keyIsRunning = false;
+    chain.dryIsRunning = false;
+    chain.mix.reset(spec.sampleRate, 0.05); // 50ms
+    chain.mix.setCurrentAndTargetValue(static_cast<SampleType>(parameters.mix * 0.01f));
+    
+    chain.outputGain.prepare(spec);
+    chain.limiter.prepare(spec);
+    
+    chain.crossover.setInputGainRampDurationSeconds(0.05); // 50ms
+    chain.outputGain.setRampDurationSeconds(0.05); // 50ms
+    
+    // whatever the parameters already need, so it counts towards the latency below
+    ChainResources<SampleType> resources;
+    buildChainResources(chain, resources, parameters);
+    swapChainResources(chain, resources);
+    
+    // sets up the decimation mode and lookahead, so the latency is known before the first block
+    chain.decimationMode = -1;
+    updateState(chain);
+}
+
+std::array<int, 3> MultibandCompressor::getDecimationStages(int mode) const
+{
+    return { mode >= 1 ? maxDecimationStages[0] : 0, mode >= 2 ? maxDecimationStages[1] : 0, 0 };
+}
+
+template<typename SampleType>
+int MultibandCompressor::getDecimationLatency(const std::array<int, 3>& stages)
+{
+    auto latency = 0;
+    
+    for(auto numStages : stages)
+        latency = juce::jmax(latency, BandDecimator<SampleType>::getLatencyForStages(numStages));
+    
+    return latency;
+}
+
+template<typename SampleType>
+void MultibandCompressor::setDecimationMode(BandChain<SampleType>& chain, int mode)
+{
+    auto stages = getDecimationStages(mode);
+    
+    for(size_t i = 0; i < chain.decimators.size(); ++i)
+    {
+        chain.decimators[i].setNumStages(stages[i]);
+        prepareBandCompressor(chain, i);
+    }
+    
+    chain.decimationMode = mode;
+}
+
+int MultibandCompressor::getOversamplingStages(const BandParameters& band, bool nonRealtime) const
+{
+    auto stages = band.oversampling;
+    
+    // bounces can afford more, but a band that isn't oversampled while playing stays that way
+    if( stages > 0 && nonRealtime && parameters.offlineOversampling > 0 )
+        stages = juce::jmax(stages, parameters.offlineOversampling + 1);
+    
+    // ...unless the whole bounce is at render quality
+    if( isRenderingAtHighQuality(nonRealtime) )
+        stages = juce::jmax(stages, 2, parameters.offlineOversampling + 1);
+    
+    return juce::jmin(stages, BandOversampler<float>::maxStages);
+}
+
+int MultibandCompressor::getDecimationMode(bool nonRealtime) const
+{
+    // render quality runs every detector at the full rate
+    return isRenderingAtHighQuality(nonRealtime) ? 0 : parameters.decimatedBands;
+}
+
+template<typename SampleType>
+void MultibandCompressor::prepareBandCompressor(BandChain<SampleType>& chain, size_t band)
+{
+    // the detector's time constants follow the rate its band runs at
+    juce::dsp::ProcessSpec bandSpec;
+    bandSpec.sampleRate = sampleRate / (1 << chain.decimators[band].getNumStages());
+    bandSpec.maximumBlockSize = static_cast<juce::uint32>(maximumBlockSize);
+    bandSpec.numChannels = static_cast<juce::uint32>(chain.numBandChannels);
+    
+    chain.compressors[band].prepare(bandSpec, 1 << chain.oversamplers[band].getNumStages());
+}
+
+template<typename SampleType>
+void MultibandCompressor::updateLatency(BandChain<SampleType>& chain)
+{
+    // the bands aren't running, the frames are all the delay there is
+    if( chain.spectralMode )
+    {
+        chain.dryDelaySamples = chain.spectral->compressor.getLatencySamples();
+        chain.latencySamples = chain.dryDelaySamples + (chain.limiter.isEnabled() ? chain.limiter.getLatencySamples() : 0);
+        return;
+    }
+    
+    // the oversampling and the lookahead are counted at the rate the band runs at
+    std::array<int, 3> bandLatencies;
+    auto latency = 0;
+    
+    for(size_t i = 0; i < chain.decimators.size(); ++i)
+    {
+        auto stages = chain.decimators[i].getNumStages();
+        auto bandRateLatency = chain.oversamplers[i].getLatencySamples() + chain.compressors[i].getLookaheadSamples();
+        bandLatencies[i] = BandDecimator<SampleType>::getLatencyForStages(stages) + (bandRateLatency << stages);
+        latency = juce::jmax(latency, bandLatencies[i]);
+    }
+    
+    // the crossover delays every band alike, so it only adds on top
+    auto crossoverLatency = chain.crossover.getLatencySamples();
+    
+    // plenty of hosts don't ask again when a bounce starts. So realtime and offline both
+    // report whichever of the two is longer, and the bands get padded up to it
+    auto bandsLatency = juce::jmax(crossoverLatency + latency, getModeLatency(chain, false), getModeLatency(chain, true));
+    
+    for(size_t i = 0; i < chain.decimators.size(); ++i)
+        chain.decimators[i].setDelaySamples(bandsLatency - crossoverLatency - bandLatencies[i]);
+    
+    chain.dryDelaySamples = bandsLatency - crossoverLatency;
+    
+    // the limiter comes after the bands are summed
+    chain.latencySamples = bandsLatency + (chain.limiter.isEnabled() ? chain.limiter.getLatencySamples() : 0);
+}
+
+template<typename SampleType>
+int MultibandCompressor::getModeLatency(const BandChain<SampleType>& chain, bool nonRealtime) const
+{
+    // same sums as updateLatency(), for settings the chain may not be running right now
+    auto decimation = getDecimationStages(getDecimationMode(nonRealtime));
+    auto latency = 0;
+    
+    for(size_t i = 0; i < chain.decimators.size(); ++i)
+    {
+        auto stages = decimation[i];
+        auto lookahead = CompressorBand<SampleType>::msToSamples(parameters.bands[i].lookaheadMs, sampleRate / (1 << stages));
+        auto oversampling = chain.oversamplers[i].getLatencySamples(getOversamplingStages(parameters.bands[i], nonRealtime));
+        latency = juce::jmax(latency, BandDecimator<SampleType>::getLatencyForStages(stages) + ((oversampling + lookahead) << stages));
+    }
+    
+    // render quality goes without the linear phase crossover until updateResources() has built it
+    auto linearPhase = isRenderingAtHighQuality(nonRealtime) && chain.crossover.canBeLinearPhase();
+    
+    return latency + (linearPhase ? chain.crossover.getLinearPhaseLatencySamples() : 0);
+}
+
+
+template<typename SampleType>
+void MultibandCompressor::updateState(BandChain<SampleType>& chain)
+{
+    // whichever mode is switched to starts from silence. The crossover's bands get
+    // their decimators, compressors and key set up again below, as after prepare.
+    // The frames only exist once updateResources() has built them
+    auto spectralMode = parameters.spectral && chain.spectral != nullptr;
+    
+    if( spectralMode != chain.spectralMode )
+    {
+        if( spectralMode )
+        {
+            chain.spectral->compressor.reset();
+        }
+        else
+        {
+            chain.crossover.reset();
+            chain.decimationMode = -1;
+        }
+        
+        // the dry's delay changes with the mode
+        chain.dryIsRunning = false;
+        chain.spectralMode = spectralMode;
+    }
+    
+    // before the compressor settings, switching re-prepares the compressors at their new rates
+    auto bandRatesChanged = false;
+    
+    if( getDecimationMode(nonRealtime) != chain.decimationMode )
+    {
+        setDecimationMode(chain, getDecimationMode(nonRealtime));
+        bandRatesChanged = true;
+    }
+    
+    for(size_t i = 0; i < chain.oversamplers.size(); ++i)
+    {
+        auto stages = getOversamplingStages(parameters.bands[i], nonRealtime);
+        
+        if( stages != chain.oversamplers[i].getNumStages() )
+        {
+            chain.oversamplers[i].setNumStages(stages);
+            prepareBandCompressor(chain, i);
+            bandRatesChanged = true;
+        }
+    }
+    
+    // mid/side needs a stereo bus, anything else stays left/right
+    chain.midSide = parameters.midSide && chain.numBandChannels == 2 && ! chain.isStreamBatch;
+    chain.crossover.setMidSide(chain.midSide);
+    
+    for(size_t i = 0; i < chain.compressors.size(); ++i)
+    {
+        chain.compressors[i].setMidSide(chain.midSide);
+        chain.compressors[i].updateCompressorSettings(parameters.bands[i], parameters.linkChannels);
+    }
+    
+    if( chain.spectralMode )
+        updateSpectral(chain);
+    
+    // after the settings, the detector mode decides what domain the linked envelopes are in
+    receiveLink(chain);
+    
+    // before the linear phase switch, which designs its taps for the slope
+    chain.crossover.setSlope(static_cast<typename Crossover<SampleType>::Slope>(parameters.crossoverSlope));
+    chain.crossover.setLinearPhase(isRenderingAtHighQuality(nonRealtime));
+    
+    updateKey(chain, bandRatesChanged);
+    
+    chain.limiter.setEnabled(parameters.limiter);
+    chain.limiter.setCeilingDecibels(parameters.limiterCeilingDecibels);
+    chain.limiter.setReleaseMs(parameters.limiterReleaseMs);
+    
+    // lookahead can move the latency on any block, decimation only when it's switched
+    updateLatency(chain);
+    
+    chain.crossover.setCrossoverFrequencies(parameters.lowMidCrossover, parameters.midHighCrossover);
+    
+    chain.crossover.setInputGainDecibels(parameters.inputGainDecibels);
+    if( chain.spectral != nullptr )
+        chain.spectral->compressor.setInputGainDecibels(parameters.inputGainDecibels);
+    chain.outputGain.setGainDecibels(parameters.outputGainDecibels);
+    
+    chain.mix.setTargetValue(static_cast<SampleType>(parameters.mix * 0.01f));
+}
+
+template<typename SampleType>
+void MultibandCompressor::receiveLink(BandChain<SampleType>& chain)
+{
+    // a batch's streams would all hear one slot, and all send on it
+    if( chain.isStreamBatch )
+        return;
+    
+    // our own channel would feed our envelopes back to us a block late
+    auto channel = parameters.linkBusReceive - 1;
+    auto receives = channel >= 0 && channel != parameters.linkBusSend - 1;
+    
+    auto levels = receives ? sharedDsp->readLink(channel) : SharedDsp::LinkLevels {};
+    
+    for(size_t i = 0; i < chain.compressors.size(); ++i)
+    {
+        chain.compressors[i].setLinkedLevel(static_cast<SampleType>(levels[i]));
+        
+        if( chain.spectralMode )
+            chain.spectral->compressor.setLinkedLevel(static_cast<int>(i), static_cast<SampleType>(levels[i]));
+    }
+}
+
+template<typename SampleType>
+void MultibandCompressor::sendLink(BandChain<SampleType>& chain)
+{
+    if( chain.isStreamBatch )
+        return;
+    
+    auto channel = parameters.linkBusSend - 1;
+    
+    if( channel != linkSendChannel )
+        stopSendingLink();
+    
+    if( channel < 0 )
+        return;
+    
+    // a bypassed band's envelopes stand still, so it sends silence
+    SharedDsp::LinkLevels levels {};
+    
+    for(size_t i = 0; i < chain.compressors.size(); ++i)
+    {
+        auto& compressor = chain.compressors[i];
+        auto envelope = chain.spectralMode ? chain.spectral->compressor.getPeakEnvelope(static_cast<int>(i)) : compressor.getPeakEnvelope();
+        levels[i] = parameters.bands[i].bypass ? 0.f : static_cast<float>(envelope);
+    }
+    
+    sharedDsp->publishLink(channel, levels);
+    linkSendChannel = channel;
+}
+
+void MultibandCompressor::stopSendingLink()
+{
+    if( linkSendChannel >= 0 )
+    {
+        sharedDsp->publishLink(linkSendChannel, {});
+        linkSendChannel = -1;
+    }
+}
+
+template<typename SampleType>
+void MultibandCompressor::updateSpectral(BandChain<SampleType>& chain)
+{
+    auto& spectral = chain.spectral->compressor;
+    
+    spectral.setNumBands(parameters.spectralBands);
+    spectral.setLinked(parameters.linkChannels);
+    spectral.setCrossoverFrequencies(parameters.lowMidCrossover, parameters.midHighCrossover);
+    
+    // solo and mute work the way they do on the summed bands
+    auto bandsAreSoloed = false;
+    
+    for(auto& band : parameters.bands)
+        bandsAreSoloed = bandsAreSoloed || band.solo;
+    
+    for(size_t i = 0; i < parameters.bands.size(); ++i)
+    {
+        auto& band = parameters.bands[i];
+        typename SpectralCompressor<SampleType>::MacroSettings settings;
+        
+        settings.thresholdDecibels = band.thresholdDecibels;
+        settings.ratio = band.ratio;
+        settings.attackMs = band.attackMs;
+        settings.releaseMs = band.releaseMs;
+        settings.mix = band.mix * 0.01f;
+        settings.bypass = band.bypass;
+        settings.audible = bandsAreSoloed ? band.solo : ! band.mute;
+        
+        spectral.setMacroSettings(static_cast<int>(i), settings);
+    }
+}
+
+template<typename SampleType>
+void MultibandCompressor::updateKey(BandChain<SampleType>& chain, bool bandRatesChanged)
+{
+    auto keyIsRunning = chain.numKeyChannels > 0 && parameters.externalSidechain;
+    
+    // the key has to be resampled exactly like the bands, so it starts over whenever they do
+    if( keyIsRunning && (! chain.keyIsRunning || bandRatesChanged) )
+    {
+        chain.keyCrossover.reset();
+        
+        for(size_t i = 0; i < chain.keyDecimators.size(); ++i)
+        {
+            chain.keyDecimators[i].followPhaseOf(chain.decimators[i]);
+            chain.keyOversamplers[i].setNumStages(chain.oversamplers[i].getNumStages());
+        }
+    }
+    
+    chain.keyIsRunning = keyIsRunning;
+    
+    if( ! keyIsRunning )
+        return;
+    
+    // split where the bands are split, with the same delay
+    chain.keyCrossover.setMidSide(chain.midSide && chain.numKeyChannels == 2);
+    chain.keyCrossover.setSlope(chain.crossover.getSlope());
+    chain.keyCrossover.setLinearPhase(chain.crossover.isLinearPhase());
+    chain.keyCrossover.setCrossoverFrequencies(parameters.lowMidCrossover, parameters.midHighCrossover);
+}
+
+
+void MultibandCompressor::process(float* const* channels, int numChannels, int numSamples, float* const* keyChannels, int numKeyChannels)
+{
+    processImpl(channels, numChannels, numSamples, keyChannels, numKeyChannels);
+}
+
+void MultibandCompressor::process(double* const* channels, int numChannels, int numSamples, double* const* keyChannels, int numKeyChannels)
+{
+    processImpl(channels, numChannels, numSamples, keyChannels, numKeyChannels);
+}
+
+template<typename SampleType>
+void MultibandCompressor::processImpl(SampleType* const* channels, int numChannels, int numSamples, SampleType* const* keyChannels, int numKeyChannels)
+{
+    juce::ScopedNoDenormals noDenormals;
+    
+    // prepared in the other precision, or not at all
+    jassert(doublePrecision == (std::is_same_v<SampleType, double>) && maximumBlockSize > 0);
+    
+    auto& chain = getChain<SampleType>();
+    
+    updateState(chain);
+    
+    // both only refer to the caller's channels
+    juce::AudioBuffer<SampleType> buffer (channels, numChannels, numSamples);
+    juce::AudioBuffer<SampleType> sidechain;
+    
+    if( chain.keyIsRunning )
+    {
+        // the key prepare() was told about has to come with every block
+        jassert(keyChannels != nullptr && numKeyChannels == chain.numKeyChannels);
+        sidechain.setDataToReferTo(keyChannels, numKeyChannels, numSamples);
+    }
+    
+    processChain(chain, buffer, sidechain);
+}
+
+template<typename SampleType>
+void MultibandCompressor::processChain(BandChain<SampleType>& chain, juce::AudioBuffer<SampleType>& buffer, juce::AudioBuffer<SampleType>& sidechain)
+{
+    auto numSamples = buffer.getNumSamples();
+    
+    jassert(numSamples <= maximumBlockSize && buffer.getNumChannels() <= chain.numBandChannels);
+    chain.referToBands(numSamples);
+    
+    // the dry delays were left behind while fully wet, so they start from silence again
+    auto dryIsHeard = chain.mix.isSmoothing() || chain.mix.getTargetValue() < SampleType(1);
+    
+    if( dryIsHeard && ! chain.dryIsRunning )
+    {
+        for(int ch = 0; ch < chain.numBandChannels; ++ch)
+            chain.dryDelays[ch].clear();
+    }
+    
+    chain.dryIsRunning = dryIsHeard;
+    
+    // the spectral mode compresses in place, the dry it hands back is only trimmed
+    if( chain.spectralMode )
+        chain.spectral->compressor.process(buffer, chain.dryIsRunning ? &chain.dryBuffer : nullptr);
+    else
+        processCrossoverBands(chain, buffer, sidechain);
+    
+    // every band is done, whichever threads ran them
+    sendLink(chain);
+    
+    if( chain.dryIsRunning )
+        mixDry(chain, buffer);
+    
+    applyGain(buffer, chain.outputGain);
+    
+    if( chain.limiter.isEnabled() )
+        chain.limiter.process(buffer);
+}
+
+template<typename SampleType>
+void MultibandCompressor::processCrossoverBands(BandChain<SampleType>& chain, juce::AudioBuffer<SampleType>& buffer, juce::AudioBuffer<SampleType>& sidechain)
+{
+    auto& bands = parameters.bands;
+    auto& filterBuffers = chain.filterBuffers;
+    auto numSamples = buffer.getNumSamples();
+    auto numChannels = buffer.getNumChannels();
+    
+    // the work subsets are cut from the bus
+    if( ! chain.isStreamBatch && shouldUseWorkerPool(numChannels, numSamples) )
+    {
+        processBandsInParallel(chain, buffer, chain.keyIsRunning ? &sidechain : nullptr);
+    }
+    else
+    {
+        // applies the input trim while splitting, so the buffer is only read once
+        chain.crossover.process(buffer, filterBuffers, chain.dryIsRunning ? &chain.dryBuffer : nullptr);
+        
+        if( chain.keyIsRunning )
+            chain.keyCrossover.process(sidechain, chain.keyBuffers);
+        
+        for(size_t i = 0; i < filterBuffers.size(); ++i)
+        {
+            processBand(chain, i, filterBuffers[i].getArrayOfWritePointers(), numSamples, chain.allChannels);
+        }
+    }
+    
+    // we need to clear our input before we start adding our filter buffers to it
+    buffer.clear();
+    
+    // each channel of our filter buffer needs to be copied back to the input buffer. Write a helper function or lambda to do that
+    auto addFilterBand = [nc = numChannels, ns = numSamples, midSide = chain.midSide, isa = instructionSet](auto& inputBuffer, const auto& source)
+    {
+        // mid/side gets decoded on the way back in, rather than in a pass of its own
+        if( midSide )
+        {
+            CpuDispatch::addMidSide(isa,
+                                    inputBuffer.getWritePointer(0),
+                                    inputBuffer.getWritePointer(1),
+                                    source.getReadPointer(0),
+                                    source.getReadPointer(1),
+                                    ns);
+            return;
+        }
+        
+        // loop through all channels in the input buffer and copy from source buffer into that
+        for(auto i = 0; i < nc; ++i)
+        {
+            CpuDispatch::add(isa, inputBuffer.getWritePointer(i), source.getReadPointer(i), ns);
+        }
+    };
+    
+    auto bandsAreSoloed = false;
+    for(auto& band : bands)
+    {
+        if(band.solo)
+        {
+            bandsAreSoloed=true;
+            break;
+        }
+    }
+    
+    if(bandsAreSoloed)
+    {
+        for (size_t i=0; i < bands.size(); ++i) {
+            auto& band = bands[i];
+            if(band.solo)
+            {
+                addFilterBand(buffer, filterBuffers[i]);
+            }
+        }
+    } else {
+        for (size_t i=0; i < bands.size(); ++i) {
+            auto& band = bands[i];
+            if (! band.mute) {
+                addFilterBand(buffer, filterBuffers[i]);
+            }
+        }
+    }
+}
+
+template<typename SampleType>
+void MultibandCompressor::mixDry(BandChain<SampleType>& chain, juce::AudioBuffer<SampleType>& buffer)
+{
+    auto numSamples = buffer.getNumSamples();
+    auto numChannels = juce::jmin(buffer.getNumChannels(), chain.numBandChannels);
+    auto* const* channels = buffer.getArrayOfWritePointers();
+    
+    // one ramp for all channels, like the crossover's input gain
+    for(int i = 0; i < numSamples; ++i)
+    {
+        auto wet = chain.mix.getNextValue();
+        
+        for(int ch = 0; ch < numChannels; ++ch)
+        {
+            auto dry = chain.dryDelays[ch].push(chain.dryChannels[ch][i], chain.dryDelaySamples);
+            channels[ch][i] = wet * channels[ch][i] + (SampleType(1) - wet) * dry;
+        }
+    }
+}
+
+template<typename SampleType>
+void MultibandCompressor::processBand(BandChain<SampleType>& chain, size_t band, SampleType* const* channels, int numSamples, const ChannelLayout::ChannelSubset& subset)
+{
+    auto& compressor = chain.compressors[band];
+    auto& oversampler = chain.oversamplers[band];
+    auto& keyOversampler = chain.keyOversamplers[band];
+    
+    // the key takes the same way down as the band, so it reaches the detector sample aligned
+    const SampleType* const* key = nullptr;
+    
+    if( chain.keyIsRunning )
+        key = chain.keyDecimators[band].downsampleOnly(chain.keyBusChannels[band].data(), numSamples, subset);
+    
+    // decimated bands get compressed at their own rate, the rest only pick up the alignment delay.
+    // Oversampled bands then run their detector and gain stage faster than that
+    chain.decimators[band].process(channels, numSamples, subset, [&compressor, &oversampler, &keyOversampler, &subset, key](SampleType* const* bandChannels, int numBandSamples)
+    {
+        auto* oversampledKey = key != nullptr ? keyOversampler.upsampleOnly(key, numBandSamples, subset) : nullptr;
+        
+        oversampler.process(bandChannels, numBandSamples, subset, [&compressor, &subset, oversampledKey](SampleType* const* oversampledChannels, int numOversampledSamples)
+        {
+            compressor.process(oversampledChannels, numOversampledSamples, subset, oversampledKey);
+        });
+    });
+}
+
+bool MultibandCompressor::shouldUseWorkerPool(int numChannels, int numSamples) const
+{
+    return parameters.parallelProcessing
+        && workerPool != nullptr
+        && numChannels * numSamples >= minChannelSamplesForWorkerPool;
+}
+
+template<typename SampleType>
+void MultibandCompressor::processBandsInParallel(BandChain<SampleType>& chain, juce::AudioBuffer<SampleType>& buffer, const juce::AudioBuffer<SampleType>* sidechain)
+{
+    auto& compressors = chain.compressors;
+    auto& filterBuffers = chain.filterBuffers;
+    auto& crossover = chain.crossover;
+    
+    // crossover: independent channel ranges, a register of the chosen instruction set wide
+    auto channelsPerRange = crossover.getChannelsPerRange();
+    auto numChannels = juce::jmin(buffer.getNumChannels(), filterBuffers[0].getNumChannels());
+    auto numRanges = (numChannels + channelsPerRange - 1) / channelsPerRange;
+    
+    // the key's ranges go after the bus's, in the same batch
+    auto& keyCrossover = chain.keyCrossover;
+    auto numKeyChannels = sidechain != nullptr ? juce::jmin(sidechain->getNumChannels(), chain.numKeyChannels) : 0;
+    auto numKeyRanges = (numKeyChannels + channelsPerRange - 1) / channelsPerRange;
+    
+    crossover.beginBlock(buffer, filterBuffers, chain.dryIsRunning ? &chain.dryBuffer : nullptr);
+    
+    if( sidechain != nullptr )
+        keyCrossover.beginBlock(*sidechain, chain.keyBuffers);
+    
+    workerPool->parallelFor(numRanges + numKeyRanges, [&crossover, &keyCrossover, numChannels, numKeyChannels, numRanges, channelsPerRange](int range)
+    {
+        auto& rangeCrossover = range < numRanges ? crossover : keyCrossover;
+        auto rangeChannels = range < numRanges ? numChannels : numKeyChannels;
+        auto first = (range < numRanges ? range : range - numRanges) * channelsPerRange;
+        
+        rangeCrossover.processRange(first, juce::jmin(channelsPerRange, rangeChannels - first));
+    });
+    
+    crossover.endBlock();
+    
+    if( sidechain != nullptr )
+        keyCrossover.endBlock();
+    
+    // compressors: every band x channel group is independent. Linked channels must stay in one group
+    std::array<SampleType* const*, 3> bandChannels;
+    for( size_t i = 0; i < filterBuffers.size(); ++i )
+        bandChannels[i] = filterBuffers[i].getArrayOfWritePointers();
+    
+    const auto& work = compressors[0].isLinked() ? linkedWork : unlinkedWork;
+    auto numSamples = filterBuffers[0].getNumSamples();
+    auto numBands = static_cast<int>(compressors.size());
+    
+    workerPool->parallelFor(numBands * static_cast<int>(work.size()), [&, numBands](int item)
+    {
+        auto band = static_cast<size_t>(item % numBands);
+        processBand(chain, band, bandChannels[band], numSamples, work[static_cast<size_t>(item / numBands)]);
+    });
+}
+
+void MultibandCompressor::prepareStreams(double newSampleRate, int newMaximumBlockSize, int numStreams, int channelsPerStream, bool useDoublePrecision)
+{
+    jassert(juce::isPositiveAndNotGreaterThan(channelsPerStream, ChannelLayout::maxChannels));
+    
+    // the same band rates and latencies a host bus of one stream would get
+    prepareForRate(newSampleRate, newMaximumBlockSize, useDoublePrecision);
+    
+    juce::dsp::ProcessSpec streamSpec;
+    streamSpec.maximumBlockSize = static_cast<juce::uint32>(maximumBlockSize);
+    streamSpec.numChannels = static_cast<juce::uint32>(channelsPerStream);
+    streamSpec.sampleRate = sampleRate;
+    
+    floatBatches.clear();
+    doubleBatches.clear();
+    
+    if( doublePrecision )
+        prepareStreamBatches<double>(streamSpec, numStreams);
+    else
+        prepareStreamBatches<float>(streamSpec, numStreams);
+    
+    // the streams never run on the worker pool
+    numBusChannels = 0;
+    updateResources();
+}
+
+template<typename SampleType>
+void MultibandCompressor::prepareStreamBatches(const juce::dsp::ProcessSpec& streamSpec, int numStreams)
+{
+    auto& batches = getBatches<SampleType>();
+    auto channelsPerStream = static_cast<int>(streamSpec.numChannels);
+    auto streamsPerBatch = ChannelLayout::maxChannels / channelsPerStream;
+    
+    // a stream links its channels the way a host bus that wide would
+    auto streamGroups = ChannelLayout::makeChannelGroups(juce::AudioChannelSet::canonicalChannelSet(channelsPerStream));
+    
+    for(int firstStream = 0; firstStream < numStreams; firstStream += streamsPerBatch)
+    {
+        auto batch = std::make_unique<StreamBatch<SampleType>>();
+        batch->firstStream = firstStream;
+        batch->numStreams = juce::jmin(streamsPerBatch, numStreams - firstStream);
+        batch->channelsPerStream = channelsPerStream;
+        
+        // every stream gets groups of its own for the detectors, and one group for its limiter gain
+        ChannelLayout::ChannelGroups groups, limiterGroups;
+        groups.numChannels = limiterGroups.numChannels = batch->numStreams * channelsPerStream;
+        groups.numGroups = batch->numStreams * streamGroups.numGroups;
+        limiterGroups.numGroups = batch->numStreams;
+        
+        for(int ch = 0; ch < groups.numChannels; ++ch)
+        {
+            auto stream = ch / channelsPerStream;
+            groups.groupOfChannel[ch] = stream * streamGroups.numGroups + streamGroups.groupOfChannel[ch % channelsPerStream];
+            limiterGroups.groupOfChannel[ch] = stream;
+        }
+        
+        auto& chain = batch->chain;
+        chain.isStreamBatch = true;
+        
+        auto spec = streamSpec;
+        spec.numChannels = static_cast<juce::uint32>(groups.numChannels);
+        
+        prepareChain(chain, batch->arena, spec, groups, 0);
+        chain.limiter.setChannelGroups(limiterGroups);
+        
+        batches.push_back(std::move(batch));
+    }
+}
+
+void MultibandCompressor::processStreams(float* const* const* streams, int numSamples)
+{
+    processStreamsImpl(streams, numSamples);
+}
+
+void MultibandCompressor::processStreams(double* const* const* streams, int numSamples)
+{
+    processStreamsImpl(streams, numSamples);
+}
+
+template<typename SampleType>
+void MultibandCompressor::processStreamsImpl(SampleType* const* const* streams, int numSamples)
+{
+    juce::ScopedNoDenormals noDenormals;
+    
+    // prepared in the other precision, or not at all
+    jassert(! getBatches<SampleType>().empty());
+    
+    for(int start = 0; start < numSamples; start += maximumBlockSize)
+    {
+        auto blockSize = juce::jmin(maximumBlockSize, numSamples - start);
+        
+        for(auto& batch : getBatches<SampleType>())
+        {
+            auto& chain = batch->chain;
+            updateState(chain);
+            
+            for(int ch = 0; ch < chain.numBandChannels; ++ch)
+                batch->channels[ch] = streams[batch->firstStream + ch / batch->channelsPerStream][ch % batch->channelsPerStream] + start;
+            
+            juce::AudioBuffer<SampleType> buffer (batch->channels.data(), chain.numBandChannels, blockSize);
+            juce::AudioBuffer<SampleType> sidechain;
+            
+            processChain(chain, buffer, sidechain);
+        }
+    }
+}
+
+int MultibandCompressor::getStreamLatencySamples() const
+{
+    if( ! floatBatches.empty() )
+        return floatBatches.front()->chain.latencySamples;
+    
+    return doubleBatches.empty() ? 0 : doubleBatches.front()->chain.latencySamples;
+}
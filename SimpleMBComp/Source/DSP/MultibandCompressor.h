@@ -0,0 +1,431 @@
+/*
+  ==============================================================================
+
+    MultibandCompressor.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "CompressorBand.h"
+#include "Crossover.h"
+#include "SpectralCompressor.h"
+#include "CpuDispatch.h"
+#include "BandDecimator.h"
+#include "BandOversampler.h"
+#include "TruePeakLimiter.h"
+#include "Arena.h"
+#include "WorkerPool.h"
+#include "SharedDsp.h"
+
+/*
+ The plugin's whole signal path without the plugin: input trim, crossover (or the spectral
+ mode), the three compressor bands, the band sum, the global mix, output gain and limiter.
+ It only needs juce_core and juce_dsp (and the audio modules they pull in), never the plugin
+ client, juce_audio_processors or the GUI. So it builds on its own as Core/SimpleMBCompCore.jucer's
+ static library, for embedding. MultibandCompressorC.h wraps it for C.
+ 
+ Everything it's told comes in through a plain Parameters struct. The plugin fills one from
+ its parameters every block, an embedder sets whatever it likes. Not thread safe: set the
+ parameters from the thread that calls process(), they're read at the start of every block.
+ 
+ The same instance either processes one bus, like a plugin instance, or renders many
+ independent streams, see prepareStreams().
+ */
+class MultibandCompressor
+{
+public:
+    // defaults are the plugin's
+    struct Parameters
+    {
+        std::array<BandParameters, 3> bands; // low, mid, high
+        
+        float lowMidCrossover = 400.f, midHighCrossover = 2000.f; // Hz
+        int crossoverSlope = 1; // 0 = 12, 1 = 24, 2 = 48 dB/oct, Linkwitz-Riley in every case
+        
+        float inputGainDecibels = 0.f, outputGainDecibels = 0.f;
+        float mix = 100.f; // percent wet over everything, each band also has its own
+        
+        bool linkChannels = false;
+        bool midSide = false; // stereo only. Encoded by the crossover, decoded while summing the bands
+        bool externalSidechain = false; // the detectors follow the key channels, when prepare() was given any
+        bool parallelProcessing = false; // wide buses only, see SharedDsp's worker pool. Takes effect in updateResources()
+        
+        int decimatedBands = 0; // 0 = off, 1 = low band, 2 = low and mid bands. Changes the latency
+        int offlineOversampling = 0; // 0 = same as realtime, 1 = 4x, 2 = 8x. Only raises bands that are already oversampled
+        bool offlineRenderQuality = false; // offline: linear phase crossover (from updateResources() on), full rate detectors, at least 4x oversampling
+        
+        // brickwall on the true peaks of the output, adds its lookahead to the latency while it's on
+        bool limiter = false;
+        float limiterCeilingDecibels = -1.f, limiterReleaseMs = 100.f;
+        
+        // 0 = off, n = channel n of SharedDsp's link bus
+        int linkBusSend = 0, linkBusReceive = 0;
+        
+        // compress in the STFT domain instead, the band parameters act on the bands each side of the crossover frequencies.
+        // Takes effect in updateResources()
+        bool spectral = false;
+        int spectralBands = 32; // 16, 32 or 64
+    };
+    
+    MultibandCompressor() = default;
+    ~MultibandCompressor();
+    
+    void setParameters(const Parameters& newParameters) { parameters = newParameters; }
+    const Parameters& getParameters() const { return parameters; }
+    
+    // offline renders can afford more, see Parameters. Checked every block, so it can change without preparing again
+    void setNonRealtime(bool isNonRealtime) { nonRealtime = isNonRealtime; }
+    
+    /*
+     Not realtime safe. channelSet decides which channels link (LFEs never do). The key is
+     either mono or as wide as the bus, or 0 for no sidechain. Only the chain of the chosen
+     precision gets allocated. Uses the parameters already set.
+     */
+    void prepare(double sampleRate, int maximumBlockSize, const juce::AudioChannelSet& channelSet, int numKeyChannels = 0, bool useDoublePrecision = false);
+    
+    // gives the worker pool back, and clears our link bus slot
+    void release();
+    
+    /*
+     Not realtime safe, and never while process() runs. Starts or stops what only some settings
+     need: the shared worker pool is held while parallelProcessing is on for a bus wider than stereo,
+     the linear phase crossover's buffers only while offlineRenderQuality is, and the spectral
+     mode's only while spectral is.
+     prepare() and prepareStreams() call it. After that, call it whenever setParameters() may have
+     switched one of those settings, until then the engine carries on without the change.
+     */
+    void updateResources();
+    
+    /*
+     updateResources() in three steps, for when process() runs on another thread meanwhile.
+     buildResources() starts and allocates whatever newParameters need that the engine doesn't
+     have yet, without touching anything process() uses, so it doesn't have to wait for a block
+     to finish. Not realtime safe, and never while prepare() or release() runs.
+     swapResources() hands that over and takes back whatever newParameters no longer need. It's
+     realtime safe, only it has to be kept apart from process(), with the same parameters set.
+     The resources it took back are freed, and the worker pool stopped if no instance uses it any
+     more, when the Resources go: after whatever lock kept process() out has been released.
+     */
+    struct Resources;
+    std::unique_ptr<Resources> buildResources(const Parameters& newParameters);
+    void swapResources(Resources& resources);
+    
+    // in place, up to maximumBlockSize samples. keyChannels are only read while externalSidechain is on
+    void process(float* const* channels, int numChannels, int numSamples, float* const* keyChannels = nullptr, int numKeyChannels = 0);
+    void process(double* const* channels, int numChannels, int numSamples, double* const* keyChannels = nullptr, int numKeyChannels = 0);
+    
+    // of the bus, in samples. Can move after any block, with lookahead or the limiter
+    int getLatencySamples() const { return doublePrecision ? doubleChain.latencySamples : floatChain.latencySamples; }
+    
+    /*
+     Offline rendering of many independent streams at once. Every stream has channelsPerStream
+     channels and gets the same parameters. The streams are packed into chains of up to
+     ChannelLayout::maxChannels channels, so the crossover, compressor and limiter kernels run
+     a stream in each lane (or each few lanes) where separate instances would each run mostly
+     empty registers, and the per block parameter updates are paid once a chain.
+     
+     Each stream keeps its own detectors and limiter gain, nothing links across streams.
+     There's no sidechain, link bus or mid/side.
+     */
+    void prepareStreams(double sampleRate, int maximumBlockSize, int numStreams, int channelsPerStream, bool useDoublePrecision = false);
+    
+    // in place, streams[stream][channel]. Any number of samples, it gets cut into maximumBlockSize blocks
+    void processStreams(float* const* const* streams, int numSamples);
+    void processStreams(double* const* const* streams, int numSamples);
+    
+    // the same for every stream, after prepareStreams or processStreams
+    int getStreamLatencySamples() const;
+    
+    // bytes of band buffers and DSP state this instance holds, valid after prepare or prepareStreams
+    size_t getDspMemoryFootprint() const;
+    
+    // what every instance in the process shares, and what they all hold between them
+    SharedDsp::Metrics getSharedDspMetrics() const { return sharedDsp->getMetrics(); }
+    int getNumWorkerThreads() const { return workerPool != nullptr ? workerPool->getNumWorkers() : 0; }
+private:
+    Parameters parameters;
+    bool nonRealtime = false;
+    double sampleRate = 44100.0;
+    int maximumBlockSize = 0;
+    bool doublePrecision = false;
+    int numBusChannels = 0; // of the bus prepare() was given, 0 while released or rendering streams
+    
+    /*
+     Everything on the audio path that holds samples, templated on the sample type
+     so double precision hosts run natively instead of converting every block.
+     Only the chain matching the precision prepare() was given is prepared, into the arena.
+     */
+    template<typename SampleType>
+    struct BandChain
+    {
+        std::array<CompressorBand<SampleType>, 3> compressors;
+        
+        // input trim is folded into the crossover's first read of the buffer
+        Crossover<SampleType> crossover;
+        
+        // Processing Mode's alternative to the crossover, compressors, decimators and oversamplers.
+        // Only one of the two runs, the other is cleared when it's switched back to. Its frames and
+        // spectra are in an arena of their own, so it only exists while spectral is on
+        struct Spectral
+        {
+            Arena arena;
+            SpectralCompressor<SampleType> compressor;
+        };
+        
+        std::unique_ptr<Spectral> spectral;
+        bool spectralMode = false;
+        
+        // low (and mid) bands can be compressed at a decimated rate, the others then get delayed to match
+        std::array<BandDecimator<SampleType>, 3> decimators;
+        int decimationMode = -1;
+        
+        // inside the decimators: the detector and gain stage of a band can run oversampled
+        std::array<BandOversampler<SampleType>, 3> oversamplers;
+        
+        // these never own their samples, they refer to bandChannels for the length of the current block
+        std::array<juce::AudioBuffer<SampleType>, 3> filterBuffers;
+        std::array<std::array<SampleType*, ChannelLayout::maxChannels>, 3> bandChannels {};
+        int numBandChannels = 0;
+        
+        // the global mix's dry is the crossover's band sum, so it has been through the same
+        // allpasses as the wet. Delayed to line up with the bands, only written while it's heard
+        juce::AudioBuffer<SampleType> dryBuffer;
+        std::array<SampleType*, ChannelLayout::maxChannels> dryChannels {};
+        std::array<LookaheadDelay<SampleType>, ChannelLayout::maxChannels> dryDelays;
+        int dryDelaySamples = 0;
+        bool dryIsRunning = false;
+        juce::SmoothedValue<SampleType> mix;
+        
+        // the bands carry mid and side rather than left and right
+        bool midSide = false;
+        
+        // which channels link, for the compressors and the spectral mode
+        ChannelLayout::ChannelGroups channelGroups;
+        ChannelLayout::ChannelSubset allChannels;
+        
+        // a chain of prepareStreams() has no one to link with
+        bool isStreamBatch = false;
+        int latencySamples = 0;
+        
+        // what only some settings need, see updateResources(): the crossovers' linear phase buffers and the spectral mode
+        size_t getOptionalBytes() const
+        {
+            return crossover.getLinearPhaseNumBytes() + keyCrossover.getLinearPhaseNumBytes()
+                 + (spectral != nullptr ? spectral->arena.getNumBytes() : 0);
+        }
+        
+        // the external sidechain, split by its own crossover for the detectors alone and resampled
+        // the way each band is. Only built when prepare() is given key channels, only run while it's switched on
+        Crossover<SampleType> keyCrossover;
+        std::array<BandDecimator<SampleType>, 3> keyDecimators;
+        std::array<BandOversampler<SampleType>, 3> keyOversamplers;
+        std::array<juce::AudioBuffer<SampleType>, 3> keyBuffers;
+        std::array<std::array<SampleType*, ChannelLayout::maxChannels>, 3> keyChannels {};
+        int numKeyChannels = 0;
+        bool keyIsRunning = false;
+        
+        // keyChannels by bus channel, a mono key shows up on every channel
+        std::array<std::array<const SampleType*, ChannelLayout::maxChannels>, 3> keyBusChannels {};
+        
+        juce::dsp::Gain<SampleType> outputGain;
+        
+        // last thing before the output, after the output gain so the ceiling is where the signal leaves
+        TruePeakLimiter<SampleType> limiter;
+        
+        void referToBands(int numSamples)
+        {
+            for( size_t i = 0; i < filterBuffers.size(); ++i )
+                filterBuffers[i].setDataToReferTo(bandChannels[i].data(), numBandChannels, numSamples);
+            
+            dryBuffer.setDataToReferTo(dryChannels.data(), numBandChannels, numSamples);
+            
+            if( numKeyChannels > 0 )
+            {
+                for( size_t i = 0; i < keyBuffers.size(); ++i )
+                    keyBuffers[i].setDataToReferTo(keyChannels[i].data(), numKeyChannels, numSamples);
+            }
+        }
+    };
+    
+    BandChain<float> floatChain;
+    BandChain<double> doubleChain;
+    
+    // every band buffer and all the filter/detector state of the prepared chain, 64 byte aligned
+    Arena arena;
+    
+    template<typename SampleType>
+    BandChain<SampleType>& getChain()
+    {
+        if constexpr (std::is_same_v<SampleType, double>)
+            return doubleChain;
+        else
+            return floatChain;
+    }
+    
+    // prepareStreams(): a chain and its own arena per batch of streams. Stream s of the batch
+    // is channels [s * channelsPerStream, (s + 1) * channelsPerStream) of the chain
+    template<typename SampleType>
+    struct StreamBatch
+    {
+        Arena arena;
+        BandChain<SampleType> chain;
+        int firstStream = 0, numStreams = 0, channelsPerStream = 0;
+        
+        // the streams' channels, for the block being processed
+        std::array<SampleType*, ChannelLayout::maxChannels> channels {};
+    };
+    
+    std::vector<std::unique_ptr<StreamBatch<float>>> floatBatches;
+    std::vector<std::unique_ptr<StreamBatch<double>>> doubleBatches;
+    
+    template<typename SampleType>
+    std::vector<std::unique_ptr<StreamBatch<SampleType>>>& getBatches()
+    {
+        if constexpr (std::is_same_v<SampleType, double>)
+            return doubleBatches;
+        else
+            return floatBatches;
+    }
+    
+    template<typename SampleType>
+    void prepareStreamBatches(const juce::dsp::ProcessSpec& streamSpec, int numStreams);
+    
+    template<typename SampleType>
+    void processImpl(SampleType* const* channels, int numChannels, int numSamples, SampleType* const* keyChannels, int numKeyChannels);
+    
+    template<typename SampleType>
+    void processStreamsImpl(SampleType* const* const* streams, int numSamples);
+    
+    int linkSendChannel = -1; // the channel we last published on, so it can be cleared when we stop
+    
+    template<typename SampleType>
+    void receiveLink(BandChain<SampleType>& chain);
+    
+    template<typename SampleType>
+    void sendLink(BandChain<SampleType>& chain);
+    
+    void stopSendingLink();
+    
+    template<typename SampleType>
+    void updateSpectral(BandChain<SampleType>& chain);
+    
+    // splits the block, compresses every band and sums them back into buffer
+    template<typename SampleType>
+    void processCrossoverBands(BandChain<SampleType>& chain, juce::AudioBuffer<SampleType>& buffer, juce::AudioBuffer<SampleType>& sidechain);
+    
+    // starts, stops and re-syncs the sidechain's crossover and resamplers, nothing runs while it's off
+    template<typename SampleType>
+    void updateKey(BandChain<SampleType>& chain, bool bandRatesChanged);
+    
+    template<typename SampleType>
+    void mixDry(BandChain<SampleType>& chain, juce::AudioBuffer<SampleType>& buffer);
+    
+    template<typename SampleType, typename U>
+    void applyGain(juce::AudioBuffer<SampleType>& buffer, U& gain)
+    {
+        auto block = juce::dsp::AudioBlock<SampleType> (buffer);
+        auto ctx = juce::dsp::ProcessContextReplacing<SampleType> (block);
+        gain.process(ctx);
+    }
+    
+    // builds the chain into chainArena. spec.numChannels is the whole chain, groups says which of them link
+    template<typename SampleType>
+    void prepareChain(BandChain<SampleType>& chain, Arena& chainArena, const juce::dsp::ProcessSpec& spec, const ChannelLayout::ChannelGroups& groups, int numKeyChannels);
+    
+    // what a chain is about to be given, or nullptr to have it taken away. The rest it keeps
+    template<typename SampleType>
+    struct ChainResources
+    {
+        bool replaceLinearPhase = false, replaceSpectral = false;
+        std::unique_ptr<typename Crossover<SampleType>::LinearPhaseBuffers> linearPhase, keyLinearPhase;
+        std::unique_ptr<typename BandChain<SampleType>::Spectral> spectral;
+    };
+    
+    // builds what the chain lacks for these parameters, then swaps it in
+    template<typename SampleType>
+    void buildChainResources(const BandChain<SampleType>& chain, ChainResources<SampleType>& resources, const Parameters& newParameters);
+    
+    template<typename SampleType>
+    void swapChainResources(BandChain<SampleType>& chain, ChainResources<SampleType>& resources);
+    
+    // takes the rate, block size and precision, and chooses the decimation and the kernels for them
+    void prepareForRate(double newSampleRate, int newMaximumBlockSize, bool useDoublePrecision);
+    
+    template<typename SampleType>
+    void updateState(BandChain<SampleType>& chain);
+    
+    // everything after the parameters are read: bands or frames, dry, output gain and limiter
+    template<typename SampleType>
+    void processChain(BandChain<SampleType>& chain, juce::AudioBuffer<SampleType>& buffer, juce::AudioBuffer<SampleType>& sidechain);
+    
+    template<typename SampleType>
+    void processBand(BandChain<SampleType>& chain, size_t band, SampleType* const* channels, int numSamples, const ChannelLayout::ChannelSubset& subset);
+    
+    std::array<int, 3> maxDecimationStages {};
+    
+    std::array<int, 3> getDecimationStages(int mode) const;
+    
+    template<typename SampleType>
+    static int getDecimationLatency(const std::array<int, 3>& stages);
+    
+    template<typename SampleType>
+    void setDecimationMode(BandChain<SampleType>& chain, int mode);
+    
+    int getOversamplingStages(const BandParameters& band, bool nonRealtime) const;
+    
+    bool isRenderingAtHighQuality(bool nonRealtime) const { return nonRealtime && parameters.offlineRenderQuality; }
+    int getDecimationMode(bool nonRealtime) const;
+    
+    // at the rate the band's decimator and oversampler leave it running at
+    template<typename SampleType>
+    void prepareBandCompressor(BandChain<SampleType>& chain, size_t band);
+    
+    // lines every band up with the slowest one (decimation plus lookahead), and sets that plus the limiter as the chain's latency
+    template<typename SampleType>
+    void updateLatency(BandChain<SampleType>& chain);
+    
+    // what the latency would be in realtime or offline, from the parameters alone
+    template<typename SampleType>
+    int getModeLatency(const BandChain<SampleType>& chain, bool nonRealtime) const;
+    
+    // which build of the wide kernels runs, picked from the CPU in prepare
+    CpuDispatch::InstructionSet instructionSet = CpuDispatch::InstructionSet::baseline;
+    
+    // one per process, see SharedDsp
+    juce::SharedResourcePointer<SharedDsp> sharedDsp;
+    
+    // wide buses can spread crossover channel ranges and bands x channel groups over the shared worker pool.
+    // Only held while parallelProcessing is on, see updateResources()
+    WorkerPool* workerPool = nullptr;
+    void releaseWorkerPool();
+    std::vector<ChannelLayout::ChannelSubset> linkedWork, unlinkedWork;
+    
+    bool shouldUseWorkerPool(int numChannels, int numSamples) const;
+    
+    template<typename SampleType>
+    void processBandsInParallel(BandChain<SampleType>& chain, juce::AudioBuffer<SampleType>& buffer, const juce::AudioBuffer<SampleType>* sidechain);
+    
+    JUCE_DECLARE_NON_COPYABLE(MultibandCompressor)
+};
+
+// in the order of the engine's chains. Whatever it holds when it goes is the engine's old resources,
+// or what was never swapped in
+struct MultibandCompressor::Resources
+{
+    ~Resources();
+    
+    ChainResources<float> floatChain;
+    ChainResources<double> doubleChain;
+    std::vector<ChainResources<float>> floatBatches;
+    std::vector<ChainResources<double>> doubleBatches;
+    
+    // one of the shared pool's users while it's set
+    bool replaceWorkerPool = false;
+    WorkerPool* workerPool = nullptr;
+    
+    // to give the pool back to, and to publish the footprint of once the old resources are gone
+    MultibandCompressor* engine = nullptr;
+};
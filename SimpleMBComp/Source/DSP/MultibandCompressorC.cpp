@@ -0,0 +1,310 @@
+/*
+  ==============================================================================
+
+    MultibandCompressorC.cpp
+
+  ==============================================================================
+*/
+
+#include "MultibandCompressorC.h"
+#include "MultibandCompressor.h"
+
+struct smbc_compressor
+{
+    MultibandCompressor engine;
+    
+    // what it was last prepared for, 0 channels when it wasn't. The engine only jasserts on
+    // a block it wasn't prepared for, C callers get told instead
+    int numChannels = 0, numKeyChannels = 0, maximumBlockSize = 0;
+    int numStreams = 0, channelsPerStream = 0;
+    bool doublePrecision = false;
+};
+
+namespace
+{
+    BandParameters toBand(const smbc_band_parameters& b)
+    {
+        BandParameters band;
+        band.attackMs = b.attack_ms;
+        band.releaseMs = b.release_ms;
+        band.thresholdDecibels = b.threshold_db;
+        band.ratio = b.ratio;
+        
+        band.sideAttackMs = b.side_attack_ms;
+        band.sideReleaseMs = b.side_release_ms;
+        band.sideThresholdDecibels = b.side_threshold_db;
+        band.sideRatio = b.side_ratio;
+        
+        band.bypass = b.bypass != 0;
+        band.mute = b.mute != 0;
+        band.solo = b.solo != 0;
+        band.lookaheadMs = b.lookahead_ms;
+        band.detector = juce::jlimit(0, 2, b.detector);
+        band.detectorWindowMs = b.detector_window_ms;
+        band.oversampling = juce::jlimit(0, 2, b.oversampling);
+        band.mix = b.mix;
+        return band;
+    }
+    
+    smbc_band_parameters fromBand(const BandParameters& band)
+    {
+        smbc_band_parameters b;
+        b.attack_ms = band.attackMs;
+        b.release_ms = band.releaseMs;
+        b.threshold_db = band.thresholdDecibels;
+        b.ratio = band.ratio;
+        
+        b.side_attack_ms = band.sideAttackMs;
+        b.side_release_ms = band.sideReleaseMs;
+        b.side_threshold_db = band.sideThresholdDecibels;
+        b.side_ratio = band.sideRatio;
+        
+        b.bypass = band.bypass;
+        b.mute = band.mute;
+        b.solo = band.solo;
+        b.lookahead_ms = band.lookaheadMs;
+        b.detector = band.detector;
+        b.detector_window_ms = band.detectorWindowMs;
+        b.oversampling = band.oversampling;
+        b.mix = band.mix;
+        return b;
+    }
+    
+    // the counts the engine can't take, checked up front since C callers get no jassert
+    bool isValidLayout(int numChannels, int numKeyChannels)
+    {
+        return numChannels > 0 && numChannels <= ChannelLayout::maxChannels
+            && (numKeyChannels == 0 || numKeyChannels == 1 || numKeyChannels == numChannels);
+    }
+    
+    template<typename SampleType>
+    bool areValidChannels(SampleType* const* channels, int numChannels)
+    {
+        if( channels == nullptr )
+            return false;
+        
+        for(int ch = 0; ch < numChannels; ++ch)
+        {
+            if( channels[ch] == nullptr )
+                return false;
+        }
+        
+        return true;
+    }
+    
+    template<typename SampleType>
+    int process(smbc_compressor& c, SampleType* const* channels, int numChannels, int numSamples, SampleType* const* keyChannels, int numKeyChannels)
+    {
+        if( c.numChannels == 0 || c.doublePrecision != std::is_same_v<SampleType, double> )
+            return 0;
+        
+        if( numChannels != c.numChannels || numSamples < 0 || ! areValidChannels(channels, numChannels) )
+            return 0;
+        
+        // the engine only reads the key while it runs, and then it has to be the one it was prepared for
+        auto keyIsRunning = c.numKeyChannels > 0 && c.engine.getParameters().externalSidechain;
+        
+        if( keyIsRunning && (numKeyChannels != c.numKeyChannels || ! areValidChannels(keyChannels, numKeyChannels)) )
+            return 0;
+        
+        // longer calls go through in the blocks the engine was prepared for
+        std::array<SampleType*, ChannelLayout::maxChannels> block {}, keyBlock {};
+        
+        for(int start = 0; start < numSamples; start += c.maximumBlockSize)
+        {
+            for(int ch = 0; ch < numChannels; ++ch)
+                block[ch] = channels[ch] + start;
+            
+            for(int ch = 0; keyIsRunning && ch < numKeyChannels; ++ch)
+                keyBlock[ch] = keyChannels[ch] + start;
+            
+            auto blockSize = juce::jmin(c.maximumBlockSize, numSamples - start);
+            c.engine.process(block.data(), numChannels, blockSize, keyIsRunning ? keyBlock.data() : nullptr, keyIsRunning ? numKeyChannels : 0);
+        }
+        
+        return 1;
+    }
+    
+    template<typename SampleType>
+    int processStreams(smbc_compressor& c, SampleType* const* const* streams, int numSamples)
+    {
+        if( c.channelsPerStream == 0 || c.doublePrecision != std::is_same_v<SampleType, double> || numSamples < 0 )
+            return 0;
+        
+        if( c.numStreams > 0 && streams == nullptr )
+            return 0;
+        
+        for(int s = 0; s < c.numStreams; ++s)
+        {
+            if( ! areValidChannels(streams[s], c.channelsPerStream) )
+                return 0;
+        }
+        
+        // no batches to run at all
+        if( c.numStreams > 0 )
+            c.engine.processStreams(streams, numSamples);
+        
+        return 1;
+    }
+}
+
+smbc_compressor* smbc_create(void)
+{
+    return new smbc_compressor();
+}
+
+void smbc_destroy(smbc_compressor* compressor)
+{
+    delete compressor;
+}
+
+void smbc_default_parameters(smbc_parameters* parameters)
+{
+    MultibandCompressor::Parameters p;
+    auto& c = *parameters;
+    
+    for(size_t i = 0; i < p.bands.size(); ++i)
+        c.bands[i] = fromBand(p.bands[i]);
+    
+    c.low_mid_crossover_hz = p.lowMidCrossover;
+    c.mid_high_crossover_hz = p.midHighCrossover;
+    c.crossover_slope = p.crossoverSlope;
+    
+    c.input_gain_db = p.inputGainDecibels;
+    c.output_gain_db = p.outputGainDecibels;
+    c.mix = p.mix;
+    
+    c.link_channels = p.linkChannels;
+    c.mid_side = p.midSide;
+    c.external_sidechain = p.externalSidechain;
+    c.parallel_processing = p.parallelProcessing;
+    
+    c.decimated_bands = p.decimatedBands;
+    c.offline_oversampling = p.offlineOversampling;
+    c.offline_render_quality = p.offlineRenderQuality;
+    
+    c.limiter = p.limiter;
+    c.limiter_ceiling_db = p.limiterCeilingDecibels;
+    c.limiter_release_ms = p.limiterReleaseMs;
+    
+    c.link_bus_send = p.linkBusSend;
+    c.link_bus_receive = p.linkBusReceive;
+    
+    c.spectral = p.spectral;
+    c.spectral_bands = p.spectralBands;
+}
+
+void smbc_set_parameters(smbc_compressor* compressor, const smbc_parameters* parameters)
+{
+    MultibandCompressor::Parameters p;
+    auto& c = *parameters;
+    
+    for(size_t i = 0; i < p.bands.size(); ++i)
+        p.bands[i] = toBand(c.bands[i]);
+    
+    p.lowMidCrossover = c.low_mid_crossover_hz;
+    p.midHighCrossover = c.mid_high_crossover_hz;
+    p.crossoverSlope = juce::jlimit(0, 2, c.crossover_slope);
+    
+    p.inputGainDecibels = c.input_gain_db;
+    p.outputGainDecibels = c.output_gain_db;
+    p.mix = c.mix;
+    
+    p.linkChannels = c.link_channels != 0;
+    p.midSide = c.mid_side != 0;
+    p.externalSidechain = c.external_sidechain != 0;
+    p.parallelProcessing = c.parallel_processing != 0;
+    
+    p.decimatedBands = juce::jlimit(0, 2, c.decimated_bands);
+    p.offlineOversampling = juce::jlimit(0, 2, c.offline_oversampling);
+    p.offlineRenderQuality = c.offline_render_quality != 0;
+    
+    p.limiter = c.limiter != 0;
+    p.limiterCeilingDecibels = c.limiter_ceiling_db;
+    p.limiterReleaseMs = c.limiter_release_ms;
+    
+    p.linkBusSend = juce::jlimit(0, SharedDsp::numLinkChannels, c.link_bus_send);
+    p.linkBusReceive = juce::jlimit(0, SharedDsp::numLinkChannels, c.link_bus_receive);
+    
+    p.spectral = c.spectral != 0;
+    p.spectralBands = juce::jlimit(16, SpectralCompressor<float>::maxBands, c.spectral_bands);
+    
+    compressor->engine.setParameters(p);
+    
+    // C callers never call process() from another thread while they're in here, so this is the time
+    compressor->engine.updateResources();
+}
+
+void smbc_set_non_realtime(smbc_compressor* compressor, int non_realtime)
+{
+    compressor->engine.setNonRealtime(non_realtime != 0);
+}
+
+int smbc_prepare(smbc_compressor* compressor, double sample_rate, int maximum_block_size, int num_channels, int num_key_channels, int double_precision)
+{
+    if( ! isValidLayout(num_channels, num_key_channels) || sample_rate <= 0.0 || maximum_block_size <= 0 )
+        return 0;
+    
+    auto& c = *compressor;
+    c.engine.prepare(sample_rate, maximum_block_size, juce::AudioChannelSet::canonicalChannelSet(num_channels), num_key_channels, double_precision != 0);
+    
+    // either the bus or the streams, whichever was prepared last
+    c.numChannels = num_channels;
+    c.numKeyChannels = num_key_channels;
+    c.maximumBlockSize = maximum_block_size;
+    c.doublePrecision = double_precision != 0;
+    c.numStreams = c.channelsPerStream = 0;
+    return 1;
+}
+
+void smbc_release(smbc_compressor* compressor)
+{
+    compressor->engine.release();
+    compressor->numChannels = 0;
+}
+
+int smbc_process_f32(smbc_compressor* compressor, float* const* channels, int num_channels, int num_samples, float* const* key_channels, int num_key_channels)
+{
+    return process(*compressor, channels, num_channels, num_samples, key_channels, num_key_channels);
+}
+
+int smbc_process_f64(smbc_compressor* compressor, double* const* channels, int num_channels, int num_samples, double* const* key_channels, int num_key_channels)
+{
+    return process(*compressor, channels, num_channels, num_samples, key_channels, num_key_channels);
+}
+
+int smbc_get_latency_samples(const smbc_compressor* compressor)
+{
+    return compressor->engine.getLatencySamples();
+}
+
+int smbc_prepare_streams(smbc_compressor* compressor, double sample_rate, int maximum_block_size, int num_streams, int channels_per_stream, int double_precision)
+{
+    if( ! isValidLayout(channels_per_stream, 0) || num_streams < 0 || sample_rate <= 0.0 || maximum_block_size <= 0 )
+        return 0;
+    
+    auto& c = *compressor;
+    c.engine.prepareStreams(sample_rate, maximum_block_size, num_streams, channels_per_stream, double_precision != 0);
+    
+    c.numStreams = num_streams;
+    c.channelsPerStream = channels_per_stream;
+    c.maximumBlockSize = maximum_block_size;
+    c.doublePrecision = double_precision != 0;
+    c.numChannels = c.numKeyChannels = 0;
+    return 1;
+}
+
+int smbc_process_streams_f32(smbc_compressor* compressor, float* const* const* streams, int num_samples)
+{
+    return processStreams(*compressor, streams, num_samples);
+}
+
+int smbc_process_streams_f64(smbc_compressor* compressor, double* const* const* streams, int num_samples)
+{
+    return processStreams(*compressor, streams, num_samples);
+}
+
+int smbc_get_stream_latency_samples(const smbc_compressor* compressor)
+{
+    return compressor->engine.getStreamLatencySamples();
+}
@@ -0,0 +1,110 @@
+/*
+  ==============================================================================
+
+    MultibandCompressorC.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+/*
+ C interface to MultibandCompressor, for embedding from anything that can call C.
+ Plain C, no JUCE types: bools are ints, choices are their indices, and the structs
+ mirror MultibandCompressor::Parameters field for field (see there for what they mean).
+ 
+ A compressor is used from one thread at a time. Separate compressors can run on
+ separate threads, they only share SharedDsp's worker pool and link bus.
+ */
+
+/* exported even from a binary built with hidden symbols, like the smbc Python module, so ctypes can call them */
+#if defined(_WIN32)
+ #define SMBC_API __declspec(dllexport)
+#else
+ #define SMBC_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct smbc_band_parameters
+{
+    float attack_ms, release_ms, threshold_db, ratio;
+    float side_attack_ms, side_release_ms, side_threshold_db, side_ratio;
+    int bypass, mute, solo;
+    float lookahead_ms;
+    int detector; /* 0 = peak, 1 = RMS, 2 = mean square */
+    float detector_window_ms;
+    int oversampling; /* 0 = off, 1 = 2x, 2 = 4x */
+    float mix; /* percent */
+} smbc_band_parameters;
+
+typedef struct smbc_parameters
+{
+    smbc_band_parameters bands[3]; /* low, mid, high */
+    
+    float low_mid_crossover_hz, mid_high_crossover_hz;
+    int crossover_slope; /* 0 = 12, 1 = 24, 2 = 48 dB/oct */
+    
+    float input_gain_db, output_gain_db;
+    float mix; /* percent */
+    
+    int link_channels, mid_side, external_sidechain, parallel_processing;
+    
+    int decimated_bands, offline_oversampling, offline_render_quality;
+    
+    int limiter;
+    float limiter_ceiling_db, limiter_release_ms;
+    
+    int link_bus_send, link_bus_receive;
+    
+    int spectral, spectral_bands;
+} smbc_parameters;
+
+typedef struct smbc_compressor smbc_compressor;
+
+SMBC_API smbc_compressor* smbc_create(void);
+SMBC_API void smbc_destroy(smbc_compressor* compressor);
+
+/* the plugin's defaults */
+SMBC_API void smbc_default_parameters(smbc_parameters* parameters);
+
+/*
+ read at the start of every block, set them from the thread that processes. Switching
+ parallel_processing starts or stops worker threads, and offline_render_quality or spectral
+ allocates or frees their buffers, so those calls aren't realtime safe
+ */
+SMBC_API void smbc_set_parameters(smbc_compressor* compressor, const smbc_parameters* parameters);
+SMBC_API void smbc_set_non_realtime(smbc_compressor* compressor, int non_realtime);
+
+/*
+ Not realtime safe. The channels link the way a host bus that wide would (5.1's LFE never
+ does). num_key_channels is 0, 1 or num_channels. Returns 0 if the counts aren't supported.
+ */
+SMBC_API int smbc_prepare(smbc_compressor* compressor, double sample_rate, int maximum_block_size, int num_channels, int num_key_channels, int double_precision);
+SMBC_API void smbc_release(smbc_compressor* compressor);
+
+/*
+ In place, in the precision given to smbc_prepare, with the num_channels it was given. Any number
+ of samples, longer calls are processed maximum_block_size at a time. While external_sidechain is
+ on for a compressor prepared with a key, key_channels has to hold num_key_channels as prepared.
+ Returns 0, and leaves the channels alone, if any of that doesn't hold or it isn't prepared.
+ */
+SMBC_API int smbc_process_f32(smbc_compressor* compressor, float* const* channels, int num_channels, int num_samples, float* const* key_channels, int num_key_channels);
+SMBC_API int smbc_process_f64(smbc_compressor* compressor, double* const* channels, int num_channels, int num_samples, double* const* key_channels, int num_key_channels);
+
+SMBC_API int smbc_get_latency_samples(const smbc_compressor* compressor);
+
+/* many independent streams at once, see MultibandCompressor::prepareStreams. Returns 0 if the counts aren't supported */
+SMBC_API int smbc_prepare_streams(smbc_compressor* compressor, double sample_rate, int maximum_block_size, int num_streams, int channels_per_stream, int double_precision);
+
+/* in place, streams[stream][channel]. Any number of samples. Returns 0 unless smbc_prepare_streams was last given this precision */
+SMBC_API int smbc_process_streams_f32(smbc_compressor* compressor, float* const* const* streams, int num_samples);
+SMBC_API int smbc_process_streams_f64(smbc_compressor* compressor, double* const* const* streams, int num_samples);
+
+SMBC_API int smbc_get_stream_latency_samples(const smbc_compressor* compressor);
+
+#ifdef __cplusplus
+}
+#endif
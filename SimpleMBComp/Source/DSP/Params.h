@@ -18,6 +18,7 @@ namespace Params
     {
         Low_Mid_Crossover_Freq,
         Mid_High_Crossover_Freq,
+        Crossover_Slope,
         
         Threshold_Low_Band,
         Threshold_Mid_Band,
@@ -49,6 +50,58 @@ namespace Params
         
         Gain_In,
         Gain_Out,
+        
+        Link_Channels,
+        Parallel_Processing,
+        Decimated_Bands,
+        
+        Lookahead_Low_Band,
+        Lookahead_Mid_Band,
+        Lookahead_High_Band,
+        
+        Detector_Low_Band,
+        Detector_Mid_Band,
+        Detector_High_Band,
+        
+        Detector_Window_Low_Band,
+        Detector_Window_Mid_Band,
+        Detector_Window_High_Band,
+        
+        Oversampling_Low_Band,
+        Oversampling_Mid_Band,
+        Oversampling_High_Band,
+        Offline_Oversampling,
+        Offline_Render_Quality,
+        
+        Limiter,
+        Limiter_Ceiling,
+        Limiter_Release,
+        
+        Mix_Low_Band,
+        Mix_Mid_Band,
+        Mix_High_Band,
+        Mix,
+
+        Stereo_Mode,
+        External_Sidechain,
+        Side_Threshold_Low_Band,
+        Side_Threshold_Mid_Band,
+        Side_Threshold_High_Band,
+        Side_Attack_Low_Band,
+        Side_Attack_Mid_Band,
+        Side_Attack_High_Band,
+        Side_Release_Low_Band,
+        Side_Release_Mid_Band,
+        Side_Release_High_Band,
+        Side_Ratio_Low_Band,
+        Side_Ratio_Mid_Band,
+        Side_Ratio_High_Band,
+        
+        Link_Bus_Send,
+        Link_Bus_Receive,
+        
+        Processing_Mode,
+        Spectral_Bands,
     };
 
     inline const std::map<Names, juce::String>& GetParams()
@@ -57,6 +110,7 @@ namespace Params
         static std::map<Names, juce::String> params = {
             {Low_Mid_Crossover_Freq, "Low-Mid Crossover Freq"},
             {Mid_High_Crossover_Freq,"Mid_High_Crossover_Freq"},
+            {Crossover_Slope, "Crossover Slope"},
             
             {Threshold_Low_Band,"Threshold Low Band"},
             {Threshold_Mid_Band,"Threshold Mid Band"},
@@ -88,6 +142,53 @@ namespace Params
             
             {Gain_In, "Gain In"},
             {Gain_Out, "Gain Out"},
+            
+            {Link_Channels, "Link Channels"},
+            {Parallel_Processing, "Parallel Processing"},
+            {Decimated_Bands, "Decimated Bands"},
+            
+            {Lookahead_Low_Band, "Lookahead Low Band"},
+            {Lookahead_Mid_Band, "Lookahead Mid Band"},
+            {Lookahead_High_Band, "Lookahead High Band"},
+            
+            {Detector_Low_Band, "Detector Low Band"},
+            {Detector_Mid_Band, "Detector Mid Band"},
+            {Detector_High_Band, "Detector High Band"},
+            
+            {Detector_Window_Low_Band, "Detector Window Low Band"},
+            {Detector_Window_Mid_Band, "Detector Window Mid Band"},
+            {Detector_Window_High_Band, "Detector Window High Band"},
+            
+            {Oversampling_Low_Band, "Oversampling Low Band"},
+            {Oversampling_Mid_Band, "Oversampling Mid Band"},
+            {Oversampling_High_Band, "Oversampling High Band"},
+            {Offline_Oversampling, "Offline Oversampling"},
+            {Offline_Render_Quality, "Offline Render Quality"},
+            {Limiter, "Limiter"},
+            {Limiter_Ceiling, "Limiter Ceiling"},
+            {Limiter_Release, "Limiter Release"},
+            {Mix_Low_Band, "Mix Low Band"},
+            {Mix_Mid_Band, "Mix Mid Band"},
+            {Mix_High_Band, "Mix High Band"},
+            {Mix, "Mix"},
+            {Stereo_Mode, "Stereo Mode"},
+            {External_Sidechain, "External Sidechain"},
+            {Side_Threshold_Low_Band, "Side Threshold Low Band"},
+            {Side_Threshold_Mid_Band, "Side Threshold Mid Band"},
+            {Side_Threshold_High_Band, "Side Threshold High Band"},
+            {Side_Attack_Low_Band, "Side Attack Low Band"},
+            {Side_Attack_Mid_Band, "Side Attack Mid Band"},
+            {Side_Attack_High_Band, "Side Attack High Band"},
+            {Side_Release_Low_Band, "Side Release Low Band"},
+            {Side_Release_Mid_Band, "Side Release Mid Band"},
+            {Side_Release_High_Band, "Side Release High Band"},
+            {Side_Ratio_Low_Band, "Side Ratio Low Band"},
+            {Side_Ratio_Mid_Band, "Side Ratio Mid Band"},
+            {Side_Ratio_High_Band, "Side Ratio High Band"},
+            {Link_Bus_Send, "Link Bus Send"},
+            {Link_Bus_Receive, "Link Bus Receive"},
+            {Processing_Mode, "Processing Mode"},
+            {Spectral_Bands, "Spectral Bands"},
         };
         return params;
     }
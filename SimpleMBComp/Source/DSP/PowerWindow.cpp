@@ -0,0 +1,178 @@
+/*
+  ==============================================================================
+
+    PowerWindow.cpp
+
+  ==============================================================================
+*/
+
+#include "PowerWindow.h"
+
+template<typename SampleType>
+void PowerWindow<SampleType>::allocate(Arena& arena, int newNumLanes, int maxWindowSize)
+{
+    numLanes = newNumLanes;
+    laneStride = (numLanes + laneAlignment - 1) / laneAlignment * laneAlignment;
+    capacity = maxWindowSize + 1;
+    
+    ring = arena.allocate<SampleType>(static_cast<size_t>(capacity * laneStride));
+    sums = arena.allocate<SampleType>(static_cast<size_t>(laneStride));
+    compensations = arena.allocate<SampleType>(static_cast<size_t>(laneStride));
+    freshSums = arena.allocate<SampleType>(static_cast<size_t>(laneStride));
+    freshCompensations = arena.allocate<SampleType>(static_cast<size_t>(laneStride));
+    freshCounts = arena.allocate<int>(static_cast<size_t>(laneStride));
+    pendingSums = arena.allocate<SampleType>(static_cast<size_t>(laneStride));
+    pendingCounts = arena.allocate<int>(static_cast<size_t>(laneStride));
+    positions = arena.allocate<int>(static_cast<size_t>(laneStride));
+}
+
+template<typename SampleType>
+void PowerWindow<SampleType>::clear()
+{
+    std::fill(ring, ring + capacity * laneStride, SampleType(0));
+    std::fill(sums, sums + laneStride, SampleType(0));
+    std::fill(compensations, compensations + laneStride, SampleType(0));
+    std::fill(freshSums, freshSums + laneStride, SampleType(0));
+    std::fill(freshCompensations, freshCompensations + laneStride, SampleType(0));
+    std::fill(freshCounts, freshCounts + laneStride, 0);
+    std::fill(positions, positions + laneStride, 0);
+    std::fill(pendingSums, pendingSums + laneStride, SampleType(0));
+    std::fill(pendingCounts, pendingCounts + laneStride, 0);
+}
+
+template<typename SampleType>
+void PowerWindow<SampleType>::setDecimationFactor(int newDecimationFactor)
+{
+    jassert(newDecimationFactor >= 1);
+    
+    decimationFactor = juce::jmax(1, newDecimationFactor);
+    decimationScale = SampleType(1) / static_cast<SampleType>(decimationFactor);
+    
+    std::fill(pendingSums, pendingSums + laneStride, SampleType(0));
+    std::fill(pendingCounts, pendingCounts + laneStride, 0);
+}
+
+template<typename SampleType>
+void PowerWindow<SampleType>::setWindowSize(int newWindowSize)
+{
+    newWindowSize = juce::jlimit(1, capacity - 1, newWindowSize);
+    
+    if( newWindowSize == windowSize )
+        return;
+    
+    windowSize = newWindowSize;
+    windowScale = SampleType(1) / static_cast<SampleType>(windowSize);
+    
+    for( int lane = 0; lane < laneStride; ++lane )
+        resum(lane);
+}
+
+template<typename SampleType>
+void PowerWindow<SampleType>::resum(int lane)
+{
+    auto sum = SampleType(0), compensation = SampleType(0);
+    auto position = positions[lane];
+    
+    for( int k = 0; k < windowSize; ++k )
+    {
+        if( --position < 0 )
+            position += capacity;
+        
+        auto y = ring[position * laneStride + lane] - compensation;
+        auto t = sum + y;
+        compensation = (t - sum) - y;
+        sum = t;
+    }
+    
+    sums[lane] = sum;
+    compensations[lane] = compensation;
+    
+    // the fresh sum starts over, it needs a whole window of the new size
+    freshSums[lane] = freshCompensations[lane] = 0;
+    freshCounts[lane] = 0;
+}
+
+template<typename SampleType>
+void PowerWindow<SampleType>::pushAll(const SampleType* powers, SampleType* means)
+{
+    const auto zero = Vec::expand(SampleType(0));
+    
+    if( decimationFactor > 1 )
+    {
+        for( int lane = 0; lane < laneStride; lane += laneAlignment )
+            (Vec::fromRawArray(pendingSums + lane) + Vec::fromRawArray(powers + lane)).copyToRawArray(pendingSums + lane);
+        
+        if( ++pendingCounts[0] < decimationFactor )
+        {
+            std::fill(pendingCounts + 1, pendingCounts + laneStride, pendingCounts[0]);
+            
+            for( int lane = 0; lane < laneStride; lane += laneAlignment )
+                (Vec::max(zero, Vec::fromRawArray(sums + lane)) * windowScale).copyToRawArray(means + lane);
+            
+            return;
+        }
+        
+        // the ring entry is the mean, pendingSums becomes the input row
+        for( int lane = 0; lane < laneStride; lane += laneAlignment )
+            (Vec::fromRawArray(pendingSums + lane) * decimationScale).copyToRawArray(pendingSums + lane);
+        
+        pushRow(pendingSums, means, zero);
+        
+        std::fill(pendingSums, pendingSums + laneStride, SampleType(0));
+        std::fill(pendingCounts, pendingCounts + laneStride, 0);
+        return;
+    }
+    
+    pushRow(powers, means, zero);
+}
+
+template<typename SampleType>
+void PowerWindow<SampleType>::pushRow(const SampleType* powers, SampleType* means, const Vec& zero)
+{
+    // owning every lane, they have all moved on by the same amount
+    auto position = positions[0];
+    auto oldest = position - windowSize;
+    if( oldest < 0 )
+        oldest += capacity;
+    
+    auto* row = ring + position * laneStride;
+    const auto* leavingRow = ring + oldest * laneStride;
+    
+    // the same operations as push(), so both paths give identical results
+    for( int lane = 0; lane < laneStride; lane += laneAlignment )
+    {
+        auto power = Vec::fromRawArray(powers + lane);
+        auto leaving = Vec::fromRawArray(leavingRow + lane);
+        power.copyToRawArray(row + lane);
+        
+        auto sum = Vec::fromRawArray(sums + lane);
+        auto y = (power - leaving) - Vec::fromRawArray(compensations + lane);
+        auto t = sum + y;
+        ((t - sum) - y).copyToRawArray(compensations + lane);
+        t.copyToRawArray(sums + lane);
+        
+        auto fresh = Vec::fromRawArray(freshSums + lane);
+        y = power - Vec::fromRawArray(freshCompensations + lane);
+        t = fresh + y;
+        ((t - fresh) - y).copyToRawArray(freshCompensations + lane);
+        t.copyToRawArray(freshSums + lane);
+    }
+    
+    if( ++freshCounts[0] == windowSize )
+    {
+        for( int lane = 0; lane < laneStride; ++lane )
+            resync(lane);
+    }
+    else
+    {
+        std::fill(freshCounts + 1, freshCounts + laneStride, freshCounts[0]);
+    }
+    
+    for( int lane = 0; lane < laneStride; lane += laneAlignment )
+        (Vec::max(zero, Vec::fromRawArray(sums + lane)) * windowScale).copyToRawArray(means + lane);
+    
+    std::fill(positions, positions + laneStride, position + 1 == capacity ? 0 : position + 1);
+}
+
+template struct PowerWindow<float>;
+template struct PowerWindow<double>;
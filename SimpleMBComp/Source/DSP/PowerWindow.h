@@ -0,0 +1,121 @@
+/*
+  ==============================================================================
+
+    PowerWindow.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Arena.h"
+
+/*
+ Mean of the last windowSize inputs (squared samples) of every lane, for the RMS and
+ mean square detectors. Each lane keeps a running sum: the newest input goes in, the
+ one leaving the window comes out, so the cost doesn't depend on the window length.
+ The sums are Kahan compensated, and a second sum collects only the fresh inputs: once it
+ holds a whole window it replaces the running sum, so whatever rounding the subtractions
+ left behind (a loud passage followed by a quiet one, in float) is gone after one window.
+ 
+ The ring stores one row of lanes per time step, padded to the SIMD width, so
+ pushAll() can update every lane with SIMDRegister. push() touches one lane only,
+ so threads that own different lanes can push concurrently.
+ 
+ An oversampled band pushes decimationFactor inputs per band rate sample. Those get
+ averaged into one ring entry, so the ring stays sized for the band rate.
+ */
+template<typename SampleType>
+struct PowerWindow
+{
+    using Vec = juce::dsp::SIMDRegister<SampleType>;
+    static constexpr int laneAlignment = (int) Vec::SIMDNumElements;
+    
+    void allocate(Arena& arena, int numLanes, int maxWindowSize);
+    
+    // back to silence
+    void clear();
+    
+    // realtime safe, but re-syncs every sum from the ring so it costs O(window) per lane. Only call from one thread
+    void setWindowSize(int newWindowSize);
+    int getWindowSize() const { return windowSize; }
+    
+    // realtime safe, drops the inputs that haven't made it into the ring yet
+    void setDecimationFactor(int newDecimationFactor);
+    
+    SampleType push(int lane, SampleType power)
+    {
+        if( decimationFactor > 1 )
+        {
+            pendingSums[lane] += power;
+            
+            // the mean holds until a whole band rate sample has come in
+            if( ++pendingCounts[lane] < decimationFactor )
+                return juce::jmax(SampleType(0), sums[lane]) * windowScale;
+            
+            power = pendingSums[lane] * decimationScale;
+            pendingSums[lane] = 0;
+            pendingCounts[lane] = 0;
+        }
+        
+        auto position = positions[lane];
+        auto oldest = position - windowSize;
+        if( oldest < 0 )
+            oldest += capacity;
+        
+        auto leaving = ring[oldest * laneStride + lane];
+        ring[position * laneStride + lane] = power;
+        
+        auto y = (power - leaving) - compensations[lane];
+        auto t = sums[lane] + y;
+        compensations[lane] = (t - sums[lane]) - y;
+        sums[lane] = t;
+        
+        y = power - freshCompensations[lane];
+        t = freshSums[lane] + y;
+        freshCompensations[lane] = (t - freshSums[lane]) - y;
+        freshSums[lane] = t;
+        
+        if( ++freshCounts[lane] == windowSize )
+            resync(lane);
+        
+        positions[lane] = position + 1 == capacity ? 0 : position + 1;
+        
+        return juce::jmax(SampleType(0), sums[lane]) * windowScale;
+    }
+    
+    // every lane at once, the caller has to own all of them. Both arrays are SIMD aligned and getLaneStride() long
+    void pushAll(const SampleType* powers, SampleType* means);
+    
+    int getLaneStride() const { return laneStride; }
+private:
+    void pushRow(const SampleType* powers, SampleType* means, const Vec& zero);
+    
+    // the fresh sum covers exactly the window now, it takes over from the running one
+    void resync(int lane)
+    {
+        sums[lane] = freshSums[lane];
+        compensations[lane] = freshCompensations[lane];
+        freshSums[lane] = freshCompensations[lane] = 0;
+        freshCounts[lane] = 0;
+    }
+    
+    // O(window), re-adds the lane's window from the ring
+    void resum(int lane);
+    
+    SampleType* ring = nullptr; // capacity rows of laneStride lanes
+    SampleType* sums = nullptr;
+    SampleType* compensations = nullptr;
+    SampleType* freshSums = nullptr;
+    SampleType* freshCompensations = nullptr;
+    int* freshCounts = nullptr;
+    int* positions = nullptr; // per lane, they only drift apart within a block
+    
+    SampleType* pendingSums = nullptr;
+    int* pendingCounts = nullptr;
+    
+    int numLanes = 0, laneStride = 0, capacity = 0;
+    int windowSize = 1, decimationFactor = 1;
+    SampleType windowScale = 1, decimationScale = 1;
+};
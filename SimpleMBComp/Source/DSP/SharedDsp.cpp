@@ -0,0 +1,146 @@
+/*
+  ==============================================================================
+
+    SharedDsp.cpp
+
+  ==============================================================================
+*/
+
+#include "SharedDsp.h"
+
+SharedDsp::~SharedDsp()
+{
+    // every instance has released the pool and withdrawn itself by now
+    jassert(numWorkerPoolUsers == 0 && footprints.empty());
+    workerPool.stop();
+}
+
+WorkerPool& SharedDsp::acquireWorkerPool(int numWorkers, double sampleRate, int samplesPerBlock)
+{
+    const juce::ScopedLock sl (lock);
+    
+    // nobody can be in a parallelFor() while there are no users, so this is the only safe time to start it.
+    // Later users get the threads as the first one asked for them
+    if( numWorkerPoolUsers++ == 0 )
+        workerPool.start(numWorkers, sampleRate, samplesPerBlock);
+    
+    return workerPool;
+}
+
+void SharedDsp::releaseWorkerPool()
+{
+    const juce::ScopedLock sl (lock);
+    jassert(numWorkerPoolUsers > 0);
+    
+    if( --numWorkerPoolUsers == 0 )
+        workerPool.stop();
+}
+
+const double* SharedDsp::getWarpTable(double sampleRate, int numEntries)
+{
+    const juce::ScopedLock sl (lock);
+    auto& table = warpTables[{ sampleRate, numEntries }];
+    
+    if( table.empty() )
+    {
+        table.resize(static_cast<size_t>(numEntries));
+        
+        for( int f = 0; f < numEntries; ++f )
+            table[static_cast<size_t>(f)] = std::tan(juce::MathConstants<double>::pi * f / sampleRate);
+    }
+    
+    return table.data();
+}
+
+const double* SharedDsp::getBlackmanHalfWindow(int numEntries)
+{
+    const juce::ScopedLock sl (lock);
+    auto& window = windows[numEntries];
+    
+    if( window.empty() )
+    {
+        window.resize(static_cast<size_t>(numEntries));
+        
+        for( int d = 0; d < numEntries; ++d )
+        {
+            auto phase = juce::MathConstants<double>::pi * d / numEntries;
+            window[static_cast<size_t>(d)] = 0.42 + 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase);
+        }
+    }
+    
+    return window.data();
+}
+
+void SharedDsp::prepareFFT(int order)
+{
+    const juce::ScopedLock sl (fftLock);
+    auto& fft = ffts[order];
+    
+    if( fft == nullptr )
+        fft = std::make_unique<juce::dsp::FFT>(order);
+}
+
+void SharedDsp::performRealOnlyInverseTransform(int order, float* data)
+{
+    // some of JUCE's FFT engines keep their scratch space in the plan
+    const juce::ScopedLock sl (fftLock);
+    
+    auto fft = ffts.find(order);
+    jassert(fft != ffts.end());
+    
+    if( fft != ffts.end() )
+        fft->second->performRealOnlyInverseTransform(data);
+}
+
+void SharedDsp::setInstanceFootprint(const void* instance, size_t numBytes)
+{
+    const juce::ScopedLock sl (lock);
+    footprints[instance] = numBytes;
+}
+
+void SharedDsp::removeInstance(const void* instance)
+{
+    const juce::ScopedLock sl (lock);
+    footprints.erase(instance);
+}
+
+SharedDsp::Metrics SharedDsp::getMetrics() const
+{
+    const juce::ScopedLock sl (lock);
+    Metrics metrics;
+    
+    metrics.numInstances = static_cast<int>(footprints.size());
+    
+    for( auto& footprint : footprints )
+        metrics.instanceBytes += footprint.second;
+    
+    for( auto& table : warpTables )
+        metrics.sharedBytes += table.second.size() * sizeof(double);
+    
+    for( auto& window : windows )
+        metrics.sharedBytes += window.second.size() * sizeof(double);
+    
+    metrics.numWorkerThreads = workerPool.getNumWorkers();
+    metrics.numWorkerPoolUsers = numWorkerPoolUsers;
+    
+    return metrics;
+}
+
+void SharedDsp::publishLink(int channel, const LinkLevels& levels)
+{
+    jassert(juce::isPositiveAndBelow(channel, numLinkChannels));
+    
+    for( int band = 0; band < numLinkBands; ++band )
+        linkSlots[channel][band].store(levels[band], std::memory_order_relaxed);
+}
+
+SharedDsp::LinkLevels SharedDsp::readLink(int channel) const
+{
+    jassert(juce::isPositiveAndBelow(channel, numLinkChannels));
+    LinkLevels levels;
+    
+    for( int band = 0; band < numLinkBands; ++band )
+        levels[band] = linkSlots[channel][band].load(std::memory_order_relaxed);
+    
+    return levels;
+}
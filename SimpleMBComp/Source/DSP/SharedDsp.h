@@ -0,0 +1,98 @@
+/*
+  ==============================================================================
+
+    SharedDsp.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "WorkerPool.h"
+
+/*
+ Everything the instances in one host process can share, reached through
+ juce::SharedResourcePointer<SharedDsp>: the first instance creates it, the last one
+ to go deletes it.
+ 
+ - one worker pool, instead of one per instance. It only runs while some instance with a wide
+   bus has parallel processing on. Only one audio thread gets it at a time, see WorkerPool::parallelFor()
+ - the crossovers' warp tables, one per sample rate, the linear phase designs' windows
+   and their FFT plans
+ - each instance's memory footprint, for getMetrics()
+ - the link bus, that lets instances duck each other by band without routing audio
+ 
+ Tables are made on the first request and then never change or move until the service
+ goes, so the pointers handed out can be read from any thread without locking.
+ Everything that adds to the service is only called from prepareToPlay, releaseResources,
+ MultibandCompressor's updateResources() and buildResources(), or the constructors and
+ destructors, the Resources' included.
+ */
+struct SharedDsp
+{
+    SharedDsp() = default;
+    ~SharedDsp();
+    
+    // the first user starts the pool, the last one to release it stops it
+    WorkerPool& acquireWorkerPool(int numWorkers, double sampleRate, int samplesPerBlock);
+    void releaseWorkerPool();
+    
+    // tan(pi f / sampleRate) for f = 0 to numEntries - 1 Hz
+    const double* getWarpTable(double sampleRate, int numEntries);
+    
+    // the first half of a symmetric Blackman window, numEntries long. Entry 0 is the centre
+    const double* getBlackmanHalfWindow(int numEntries);
+    
+    // makes sure a plan of this size exists, so the transform never has to build one
+    void prepareFFT(int order);
+    
+    // the plans are shared, so callers take turns. Only the offline linear phase design uses them
+    void performRealOnlyInverseTransform(int order, float* data);
+    
+    struct Metrics
+    {
+        int numInstances = 0;
+        size_t instanceBytes = 0; // every instance's arena, added up
+        size_t sharedBytes = 0;   // the tables, held once
+        int numWorkerThreads = 0;
+        int numWorkerPoolUsers = 0;
+    };
+    
+    // an instance's DSP footprint, published from prepare and withdrawn by its destructor
+    void setInstanceFootprint(const void* instance, size_t numBytes);
+    void removeInstance(const void* instance);
+    
+    Metrics getMetrics() const;
+    
+    /*
+     The link bus: a slot per link channel, holding the per band envelopes of the instance
+     that sends on it. The sender overwrites its slot once per block, receivers read it once
+     per block. Both are a handful of relaxed atomic floats, so wait-free on any audio thread,
+     in any order. A receiver hears the latest block the sender finished, which is at most
+     a block behind or ahead. One sender per channel, a second one would overwrite the first.
+     */
+    static constexpr int numLinkChannels = 8;
+    static constexpr int numLinkBands = 3;
+    using LinkLevels = std::array<float, numLinkBands>;
+    
+    void publishLink(int channel, const LinkLevels& levels);
+    LinkLevels readLink(int channel) const;
+private:
+    juce::CriticalSection lock;
+    
+    WorkerPool workerPool;
+    int numWorkerPoolUsers = 0;
+    
+    // std::map never moves its nodes, so the tables stay put while others are added
+    std::map<std::pair<double, int>, std::vector<double>> warpTables;
+    std::map<int, std::vector<double>> windows;
+    
+    juce::CriticalSection fftLock;
+    std::map<int, std::unique_ptr<juce::dsp::FFT>> ffts;
+    
+    std::map<const void*, size_t> footprints;
+    
+    static_assert(std::atomic<float>::is_always_lock_free, "");
+    std::array<std::array<std::atomic<float>, numLinkBands>, numLinkChannels> linkSlots {};
+};
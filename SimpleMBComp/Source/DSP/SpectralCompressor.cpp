@@ -0,0 +1,417 @@
+/*
+  ==============================================================================
+
+    SpectralCompressor.cpp
+
+  ==============================================================================
+*/
+
+#include "SpectralCompressor.h"
+
+namespace
+{
+    // ERB-rate, Glasberg and Moore
+    double hzToErb(double hz) { return 21.4 * std::log10(1.0 + 0.00437 * hz); }
+    double erbToHz(double erb) { return (std::pow(10.0, erb / 21.4) - 1.0) / 0.00437; }
+}
+
+template<typename SampleType>
+void SpectralCompressor<SampleType>::allocate(Arena& arena, const juce::dsp::ProcessSpec& spec)
+{
+    jassert(spec.numChannels <= (juce::uint32) ChannelLayout::maxChannels);
+    
+    fftOrder = getFftOrder(spec.sampleRate);
+    frameSize = 1 << fftOrder;
+    hopSize = frameSize / 4;
+    numBins = frameSize / 2 + 1;
+    numChannels = static_cast<int>(spec.numChannels);
+    
+    window = arena.allocate<float>(static_cast<size_t>(frameSize));
+    binBands = arena.allocate<int>(static_cast<size_t>(numBins));
+    binFractions = arena.allocate<float>(static_cast<size_t>(numBins));
+    
+    for( int ch = 0; ch < numChannels; ++ch )
+    {
+        frames[ch] = arena.allocate<SampleType>(static_cast<size_t>(frameSize));
+        outputs[ch] = arena.allocate<SampleType>(static_cast<size_t>(frameSize + hopSize));
+        spectra[ch] = arena.allocate<float>(static_cast<size_t>(2 * frameSize));
+    }
+    
+    // linking only ever lowers the number of envelopes
+    bandPowers = arena.allocate<SampleType>(static_cast<size_t>(numChannels * maxBands));
+    envelopes = arena.allocate<SampleType>(static_cast<size_t>(numChannels * maxBands));
+    bandGains = arena.allocate<SampleType>(static_cast<size_t>(numChannels * maxBands));
+    
+    maxBlockSize = (int) spec.maximumBlockSize;
+    gainRamp = arena.allocate<SampleType>(spec.maximumBlockSize);
+}
+
+template<typename SampleType>
+void SpectralCompressor<SampleType>::prepare(const juce::dsp::ProcessSpec& spec)
+{
+    jassert(window != nullptr && (int) spec.maximumBlockSize <= maxBlockSize);
+    
+    sampleRate = spec.sampleRate;
+    
+    // the time constants are per frame
+    expFactor = -2.0 * juce::MathConstants<double>::pi * 1000.0 * hopSize / sampleRate;
+    
+    // a sine of amplitude A puts A^2 N^2 / 8 into the positive bins through this window
+    levelScale = static_cast<SampleType>(8.0 / (static_cast<double>(frameSize) * frameSize));
+    
+    // the shared plans are behind a lock, this one runs on the audio thread every hop
+    if( fft == nullptr || fft->getSize() != frameSize )
+        fft = std::make_unique<juce::dsp::FFT>(fftOrder);
+    
+    for( int n = 0; n < frameSize; ++n )
+        window[n] = static_cast<float>(std::sin(juce::MathConstants<double>::pi * n / frameSize));
+    
+    lowMidCutoff = midHighCutoff = 0.f;
+    updateBands();
+    reset();
+}
+
+template<typename SampleType>
+void SpectralCompressor<SampleType>::reset()
+{
+    for( int ch = 0; ch < numChannels; ++ch )
+    {
+        std::fill(frames[ch], frames[ch] + frameSize, SampleType(0));
+        std::fill(outputs[ch], outputs[ch] + frameSize + hopSize, SampleType(0));
+    }
+    
+    std::fill(envelopes, envelopes + numChannels * maxBands, SampleType(0));
+    hopPosition = 0;
+    
+    inputGain.reset(sampleRate, inputGainRampDurationSeconds);
+}
+
+template<typename SampleType>
+void SpectralCompressor<SampleType>::release()
+{
+    fft.reset();
+    
+    window = nullptr;
+    binBands = nullptr;
+    binFractions = nullptr;
+    
+    frames.fill(nullptr);
+    outputs.fill(nullptr);
+    spectra.fill(nullptr);
+    
+    bandPowers = envelopes = bandGains = nullptr;
+    gainRamp = nullptr;
+}
+
+template<typename SampleType>
+void SpectralCompressor<SampleType>::setChannelGroups(const ChannelLayout::ChannelGroups& groups)
+{
+    jassert(groups.numChannels <= numChannels);
+    
+    channelGroups = groups;
+    std::fill(envelopes, envelopes + numChannels * maxBands, SampleType(0));
+}
+
+template<typename SampleType>
+void SpectralCompressor<SampleType>::setLinked(bool shouldBeLinked)
+{
+    if( shouldBeLinked == linked )
+        return;
+    
+    linked = shouldBeLinked;
+    std::fill(envelopes, envelopes + numChannels * maxBands, SampleType(0));
+}
+
+template<typename SampleType>
+void SpectralCompressor<SampleType>::setNumBands(int newNumBands)
+{
+    newNumBands = juce::jlimit(1, maxBands, newNumBands);
+    
+    if( newNumBands == numBands )
+        return;
+    
+    numBands = newNumBands;
+    updateBands();
+    std::fill(envelopes, envelopes + numChannels * maxBands, SampleType(0));
+}
+
+template<typename SampleType>
+void SpectralCompressor<SampleType>::updateBands()
+{
+    // evenly spaced on the ERB scale from 20 Hz to 20 kHz, at least a bin each. The first band
+    // reaches down to DC and the last one up to nyquist
+    auto topHz = juce::jmin(20000.0, sampleRate * 0.5);
+    auto bottomErb = hzToErb(20.0);
+    auto erbPerBand = (hzToErb(topHz) - bottomErb) / numBands;
+    
+    bandEdges[0] = 0;
+    
+    for( int b = 1; b < numBands; ++b )
+    {
+        auto bin = juce::roundToInt(erbToHz(bottomErb + b * erbPerBand) * frameSize / sampleRate);
+        bandEdges[b] = juce::jlimit(bandEdges[b - 1] + 1, numBins - (numBands - b), bin);
+    }
+    
+    bandEdges[numBands] = numBins;
+    
+    std::array<float, maxBands> centreBins;
+    
+    for( int b = 0; b < numBands; ++b )
+    {
+        centreBins[b] = 0.5f * static_cast<float>(bandEdges[b] + bandEdges[b + 1] - 1);
+        bandCentres[b] = static_cast<float>(centreBins[b] * sampleRate / frameSize);
+    }
+    
+    // below the first centre and above the last one the gain is flat
+    auto band = 0;
+    
+    for( int k = 0; k < numBins; ++k )
+    {
+        while( band < numBands - 1 && static_cast<float>(k) >= centreBins[band + 1] )
+            ++band;
+        
+        binBands[k] = band;
+        
+        if( band == numBands - 1 || static_cast<float>(k) <= centreBins[band] )
+            binFractions[k] = 0.f;
+        else
+            binFractions[k] = (static_cast<float>(k) - centreBins[band]) / (centreBins[band + 1] - centreBins[band]);
+    }
+    
+    // the macros follow the centres
+    lowMidCutoff = midHighCutoff = 0.f;
+}
+
+template<typename SampleType>
+void SpectralCompressor<SampleType>::setCrossoverFrequencies(float newLowMidCutoff, float newMidHighCutoff)
+{
+    if( newLowMidCutoff == lowMidCutoff && newMidHighCutoff == midHighCutoff )
+        return;
+    
+    lowMidCutoff = newLowMidCutoff;
+    midHighCutoff = newMidHighCutoff;
+    
+    for( int b = 0; b < numBands; ++b )
+        bandMacros[b] = bandCentres[b] < lowMidCutoff ? 0 : (bandCentres[b] < midHighCutoff ? 1 : 2);
+}
+
+template<typename SampleType>
+void SpectralCompressor<SampleType>::setMacroSettings(int macro, const MacroSettings& newSettings)
+{
+    jassert(juce::isPositiveAndBelow(macro, numMacros));
+    auto& s = macros[macro];
+    
+    s.attackCte = calculateCte(newSettings.attackMs);
+    s.releaseCte = calculateCte(newSettings.releaseMs);
+    s.thresholdGain = juce::Decibels::decibelsToGain(static_cast<SampleType>(newSettings.thresholdDecibels), SampleType(-200));
+    s.thresholdInverse = SampleType(1) / s.thresholdGain;
+    s.gainExponent = SampleType(1) / static_cast<SampleType>(newSettings.ratio) - SampleType(1);
+    s.wet = static_cast<SampleType>(newSettings.mix);
+    s.bypass = newSettings.bypass;
+    s.audible = newSettings.audible;
+}
+
+template<typename SampleType>
+void SpectralCompressor<SampleType>::setLinkedLevel(int macro, SampleType level)
+{
+    jassert(juce::isPositiveAndBelow(macro, numMacros));
+    linkedLevels[macro] = level;
+}
+
+template<typename SampleType>
+SampleType SpectralCompressor<SampleType>::getPeakEnvelope(int macro) const
+{
+    auto numEnvelopes = linked ? channelGroups.numGroups : channelGroups.numChannels;
+    auto peak = SampleType(0);
+    
+    for( int e = 0; e < numEnvelopes; ++e )
+    {
+        for( int b = 0; b < numBands; ++b )
+        {
+            if( bandMacros[b] == macro )
+                peak = juce::jmax(peak, envelopes[e * maxBands + b]);
+        }
+    }
+    
+    return peak;
+}
+
+template<typename SampleType>
+void SpectralCompressor<SampleType>::setInputGainRampDurationSeconds(double newDurationSeconds)
+{
+    if( inputGainRampDurationSeconds != newDurationSeconds )
+    {
+        inputGainRampDurationSeconds = newDurationSeconds;
+        inputGain.reset(sampleRate, inputGainRampDurationSeconds);
+    }
+}
+
+template<typename SampleType>
+void SpectralCompressor<SampleType>::setInputGainDecibels(float gainDecibels)
+{
+    inputGain.setTargetValue(juce::Decibels::decibelsToGain(static_cast<SampleType>(gainDecibels)));
+}
+
+template<typename SampleType>
+void SpectralCompressor<SampleType>::process(juce::AudioBuffer<SampleType>& buffer, juce::AudioBuffer<SampleType>* dryBuffer)
+{
+    auto numSamples = buffer.getNumSamples();
+    auto numBufferChannels = juce::jmin(buffer.getNumChannels(), channelGroups.numChannels);
+    jassert(numSamples <= maxBlockSize);
+    
+    for( int i = 0; i < numSamples; ++i )
+        gainRamp[i] = inputGain.getNextValue();
+    
+    auto* const* channels = buffer.getArrayOfWritePointers();
+    auto* const* dry = dryBuffer != nullptr ? dryBuffer->getArrayOfWritePointers() : nullptr;
+    
+    // in runs that end on a hop, so a frame is taken as soon as the hop is in. A sample
+    // frameSize - 1 old is then the oldest of that frame, and its last frame has just been added
+    for( int start = 0; start < numSamples; )
+    {
+        auto numRun = juce::jmin(numSamples - start, hopSize - hopPosition);
+        
+        for( int ch = 0; ch < numBufferChannels; ++ch )
+        {
+            auto* frame = frames[ch] + frameSize - hopSize + hopPosition;
+            
+            for( int i = 0; i < numRun; ++i )
+                frame[i] = channels[ch][start + i] * gainRamp[start + i];
+            
+            if( dry != nullptr )
+                std::copy(frame, frame + numRun, dry[ch] + start);
+        }
+        
+        auto hopIsIn = hopPosition + numRun == hopSize;
+        
+        if( hopIsIn )
+            processFrame();
+        
+        for( int ch = 0; ch < numBufferChannels; ++ch )
+            std::copy(outputs[ch] + hopPosition, outputs[ch] + hopPosition + numRun, channels[ch] + start);
+        
+        hopPosition += numRun;
+        start += numRun;
+        
+        // the hop has been output, so everything moves along by one
+        if( hopIsIn )
+        {
+            for( int ch = 0; ch < numBufferChannels; ++ch )
+            {
+                std::copy(frames[ch] + hopSize, frames[ch] + frameSize, frames[ch]);
+                std::copy(outputs[ch] + hopSize, outputs[ch] + frameSize + hopSize, outputs[ch]);
+                std::fill(outputs[ch] + frameSize, outputs[ch] + frameSize + hopSize, SampleType(0));
+            }
+            
+            hopPosition = 0;
+        }
+    }
+}
+
+template<typename SampleType>
+void SpectralCompressor<SampleType>::processFrame()
+{
+    auto numFrameChannels = channelGroups.numChannels;
+    
+    // analysis, and every band's power, per channel
+    for( int ch = 0; ch < numFrameChannels; ++ch )
+    {
+        auto* spectrum = spectra[ch];
+        
+        for( int n = 0; n < frameSize; ++n )
+            spectrum[n] = static_cast<float>(frames[ch][n]) * window[n];
+        
+        fft->performRealOnlyForwardTransform(spectrum, true);
+        
+        // each bin's power is shared between the two bands its gain comes from, in the same proportions.
+        // So a tone between two centres drives both, rather than only the one whose gain it barely gets
+        std::array<float, maxBands + 1> powers {};
+        
+        for( int k = 0; k < numBins; ++k )
+        {
+            auto power = spectrum[2 * k] * spectrum[2 * k] + spectrum[2 * k + 1] * spectrum[2 * k + 1];
+            
+            powers[binBands[k]] += power * (1.f - binFractions[k]);
+            powers[binBands[k] + 1] += power * binFractions[k];
+        }
+        
+        for( int b = 0; b < numBands; ++b )
+            bandPowers[ch * maxBands + b] = static_cast<SampleType>(powers[b]);
+    }
+    
+    // linked, a group's power is the mean over its channels and goes into the group's first row
+    auto numEnvelopes = numFrameChannels;
+    
+    if( linked )
+    {
+        numEnvelopes = channelGroups.numGroups;
+        
+        std::array<int, ChannelLayout::maxChannels> groupSizes {};
+        std::array<SampleType, maxBands * ChannelLayout::maxChannels> groupPowers {};
+        
+        for( int ch = 0; ch < numFrameChannels; ++ch )
+        {
+            auto group = channelGroups.groupOfChannel[ch];
+            ++groupSizes[group];
+            
+            for( int b = 0; b < numBands; ++b )
+                groupPowers[group * maxBands + b] += bandPowers[ch * maxBands + b];
+        }
+        
+        for( int g = 0; g < numEnvelopes; ++g )
+        {
+            for( int b = 0; b < numBands; ++b )
+                bandPowers[g * maxBands + b] = groupPowers[g * maxBands + b] / static_cast<SampleType>(juce::jmax(1, groupSizes[g]));
+        }
+    }
+    
+    // one detector and gain computer per band, per envelope
+    for( int e = 0; e < numEnvelopes; ++e )
+    {
+        for( int b = 0; b < numBands; ++b )
+        {
+            auto& s = macros[bandMacros[b]];
+            auto& envelope = envelopes[e * maxBands + b];
+            
+            // a linked instance's level goes through this band's ballistics too, so it can't step at block boundaries
+            auto level = juce::jmax(powerToLevel(bandPowers[e * maxBands + b]), linkedLevels[bandMacros[b]]);
+            
+            envelope = level + (level > envelope ? s.attackCte : s.releaseCte) * (envelope - level);
+            
+            auto gain = SampleType(1);
+            
+            if( ! s.bypass && envelope > s.thresholdGain )
+                gain = SampleType(1) + s.wet * (std::pow(envelope * s.thresholdInverse, s.gainExponent) - SampleType(1));
+            
+            bandGains[e * maxBands + b] = s.audible ? gain : SampleType(0);
+        }
+    }
+    
+    // every bin gets its gain between the neighbouring band centres, then the frame is resynthesised
+    for( int ch = 0; ch < numFrameChannels; ++ch )
+    {
+        auto* spectrum = spectra[ch];
+        auto* gains = bandGains + (linked ? channelGroups.groupOfChannel[ch] : ch) * maxBands;
+        
+        for( int k = 0; k < numBins; ++k )
+        {
+            auto band = binBands[k];
+            auto next = juce::jmin(band + 1, numBands - 1);
+            auto gain = static_cast<float>(gains[band]) + binFractions[k] * static_cast<float>(gains[next] - gains[band]);
+            
+            spectrum[2 * k] *= gain;
+            spectrum[2 * k + 1] *= gain;
+        }
+        
+        fft->performRealOnlyInverseTransform(spectrum);
+        
+        // the frame's first sample is output hopSize - 1 samples into the next run
+        auto* output = outputs[ch] + hopSize - 1;
+        
+        for( int n = 0; n < frameSize; ++n )
+            output[n] += static_cast<SampleType>(spectrum[n] * window[n] * synthesisScale);
+    }
+}
+
+template struct SpectralCompressor<float>;
+template struct SpectralCompressor<double>;
@@ -0,0 +1,163 @@
+/*
+  ==============================================================================
+
+    SpectralCompressor.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChannelLayout.h"
+#include "Arena.h"
+
+/*
+ The alternative to the crossover tree: compression in the STFT domain, with many
+ narrow bands for about the cost of three.
+ 
+ Each channel is cut into frames of frameSize samples, a quarter frame apart, with a
+ sqrt Hann window on the way in and on the way out, so the overlap-add sums back to the
+ input exactly while nothing compresses. Every frame's bins are grouped into numBands
+ bands, evenly spaced on the ERB scale. Each band has its own detector and gain computer,
+ run once per frame on the band's power, and the gains are interpolated bin by bin between
+ the bands' centres so neighbouring bands don't leave steps in the spectrum. The overlap-add
+ then crossfades the gains from frame to frame, which is all the smoothing they need.
+ 
+ The transforms and the per bin work are the same whatever the band count, only the
+ detectors grow with it, and they run once a frame. So 64 bands cost about what 16 do.
+ 
+ The three band parameters are macros: a band follows the low, mid or high settings by
+ which side of the crossover frequencies its centre falls. A band's level is calibrated so
+ a sine reads at its peak amplitude, so the thresholds mean what they do in crossover mode.
+ 
+ The latency is a frame less a sample. Detection is always on the band itself: lookahead,
+ the detector modes, oversampling, decimation, mid/side and the external key are crossover
+ mode only. The transforms run in single precision for both chains.
+ */
+template<typename SampleType>
+struct SpectralCompressor
+{
+    static constexpr int maxBands = 64;
+    static constexpr int numMacros = 3;
+    
+    // frames, spectra and detectors live in an arena of their own, only built while the mode is
+    // switched on. Called from its Arena::build() before prepare(). Sized for maxBands, so the band
+    // count can change on the audio thread
+    void allocate(Arena& arena, const juce::dsp::ProcessSpec& spec);
+    
+    // makes the FFT plan and the window, so only call it from prepareToPlay
+    void prepare(const juce::dsp::ProcessSpec& spec);
+    void reset();
+    
+    // before the arena goes away, also drops the FFT plan. Not realtime safe
+    void release();
+    bool isPrepared() const { return fft != nullptr; }
+    
+    void setChannelGroups(const ChannelLayout::ChannelGroups& groups);
+    
+    // realtime safe, switching clears the detectors
+    void setLinked(bool shouldBeLinked);
+    void setNumBands(int newNumBands);
+    int getNumBands() const { return numBands; }
+    
+    // which macro each band follows
+    void setCrossoverFrequencies(float lowMidCutoff, float midHighCutoff);
+    
+    // one of the low, mid or high band's parameter sets, read once per block
+    struct MacroSettings
+    {
+        float thresholdDecibels = 0.f, ratio = 1.f, attackMs = 5.f, releaseMs = 250.f;
+        float mix = 1.f; // wet, 0 to 1
+        bool bypass = false;
+        bool audible = true; // false when muted, or when another macro is soloed
+    };
+    
+    void setMacroSettings(int macro, const MacroSettings& newSettings);
+    
+    // another instance's envelope for a macro, see SharedDsp's link bus. Set once per block
+    void setLinkedLevel(int macro, SampleType level);
+    
+    // the loudest envelope of the macro's bands, as an amplitude. Between blocks only
+    SampleType getPeakEnvelope(int macro) const;
+    
+    // same ramp behaviour as the crossover's input trim
+    void setInputGainRampDurationSeconds(double newDurationSeconds);
+    void setInputGainDecibels(float gainDecibels);
+    
+    // in place. dryBuffer, when given, gets the trimmed input, not delayed
+    void process(juce::AudioBuffer<SampleType>& buffer, juce::AudioBuffer<SampleType>* dryBuffer = nullptr);
+    
+    // fixed once prepared
+    int getLatencySamples() const { return frameSize - 1; }
+    
+    // what it will be at that rate, before there's anything allocated
+    static int getLatencySamples(double sampleRate) { return (1 << getFftOrder(sampleRate)) - 1; }
+private:
+    // ~43 ms at 44.1 and 48 kHz, which resolves the lowest bands, and the same length in time up to 192 kHz
+    static int getFftOrder(double sampleRate)
+    {
+        return 11 + juce::jlimit(0, 2, juce::roundToInt(std::log2(sampleRate / 48000.0)));
+    }
+    
+    // runs the detectors on the frame that has just filled, and adds its resynthesis to the output
+    void processFrame();
+    
+    void updateBands();
+    
+    // what the detectors see of a band's power: the amplitude of a sine with that much power
+    SampleType powerToLevel(SampleType power) const { return std::sqrt(power * levelScale); }
+    
+    SampleType calculateCte(float timeMs) const
+    {
+        return timeMs < 1.0e-3f ? SampleType(0) : static_cast<SampleType>(std::exp(expFactor / timeMs));
+    }
+    
+    std::unique_ptr<juce::dsp::FFT> fft;
+    int fftOrder = 0, frameSize = 0, hopSize = 0, numBins = 0;
+    double sampleRate = 44100.0, expFactor = 0.0, inputGainRampDurationSeconds = 0.0;
+    SampleType levelScale = 0;
+    
+    // sqrt Hann, periodic. The overlap-add of four of them squared sums to 2, hence synthesisScale
+    float* window = nullptr;
+    static constexpr float synthesisScale = 0.5f;
+    
+    // per channel: the last frameSize inputs, the overlap-add of the frames still being output
+    // (frameSize + hopSize long) and the spectrum, in JUCE's interleaved real only layout
+    std::array<SampleType*, ChannelLayout::maxChannels> frames {}, outputs {};
+    std::array<float*, ChannelLayout::maxChannels> spectra {};
+    int hopPosition = 0; // samples into the current hop, the same for every channel
+    
+    // bins [bandEdges[b], bandEdges[b + 1]) are band b, which places its centre. Bin k's power
+    // and gain are shared between band binBands[k] and the next, binFractions[k] of the way
+    std::array<int, maxBands + 1> bandEdges {};
+    std::array<float, maxBands> bandCentres {}; // in Hz
+    std::array<int, maxBands> bandMacros {};
+    int* binBands = nullptr;
+    float* binFractions = nullptr;
+    int numBands = 32;
+    
+    // band b of envelope e is at e * maxBands + b. One envelope per channel, or per group when linked
+    SampleType* bandPowers = nullptr;
+    SampleType* envelopes = nullptr;
+    SampleType* bandGains = nullptr;
+    
+    struct GainSettings
+    {
+        SampleType thresholdGain = 1, thresholdInverse = 1, gainExponent = 0;
+        SampleType attackCte = 0, releaseCte = 0, wet = 1;
+        bool bypass = false, audible = true;
+    };
+    
+    std::array<GainSettings, numMacros> macros;
+    std::array<SampleType, numMacros> linkedLevels {};
+    float lowMidCutoff = 0.f, midHighCutoff = 0.f;
+    
+    bool linked = false;
+    int numChannels = 0;
+    ChannelLayout::ChannelGroups channelGroups;
+    
+    juce::SmoothedValue<SampleType> inputGain;
+    SampleType* gainRamp = nullptr;
+    int maxBlockSize = 0;
+};
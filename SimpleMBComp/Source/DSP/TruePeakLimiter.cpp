@@ -0,0 +1,214 @@
+/*
+  ==============================================================================
+
+    TruePeakLimiter.cpp
+
+  ==============================================================================
+*/
+
+#include "TruePeakLimiter.h"
+
+template<typename SampleType>
+void TruePeakLimiter<SampleType>::allocate(Arena& arena, const juce::dsp::ProcessSpec& spec)
+{
+    jassert(spec.numChannels <= (juce::uint32) ChannelLayout::maxChannels);
+    
+    // whole registers of lanes, so every row of the history starts aligned
+    numChannels = static_cast<int>(spec.numChannels);
+    numLanes = (numChannels + width - 1) / width * width;
+    lookaheadSamples = juce::roundToInt(lookaheadMs * 0.001 * spec.sampleRate);
+    
+    taps = arena.allocate<SampleType>(static_cast<size_t>(numTaps * width));
+    history = arena.allocate<SampleType>(static_cast<size_t>(2 * tapsPerPhase * numLanes));
+    gains = arena.allocate<SampleType>(static_cast<size_t>((lookaheadSamples + 1) * numChannels));
+    
+    for( int ch = 0; ch < numChannels; ++ch )
+    {
+        peakWindows[static_cast<size_t>(ch)].allocate(arena, lookaheadSamples);
+        delays[static_cast<size_t>(ch)].allocate(arena, getLatencySamples());
+    }
+    
+    groups = {};
+    groups.numChannels = numChannels;
+    groups.numGroups = 1;
+}
+
+template<typename SampleType>
+void TruePeakLimiter<SampleType>::prepare(const juce::dsp::ProcessSpec& spec)
+{
+    jassert(taps != nullptr && static_cast<int>(spec.numChannels) <= numChannels);
+    
+    sampleRate = spec.sampleRate;
+    
+    // windowed sinc at the original nyquist, centred between the middle two taps. Phase p then
+    // lands (p + 0.5) / 4 samples after the input detectorDelay samples ago.
+    // The Kaiser window keeps the transition narrow, so peaks up to ~0.44 fs still read at full level
+    const auto pi = juce::MathConstants<double>::pi;
+    const auto centre = (numTaps - 1) * 0.5;
+    
+    std::array<double, numTaps> window;
+    juce::dsp::WindowingFunction<double>::fillWindowingTables(window.data(), window.size(), juce::dsp::WindowingFunction<double>::kaiser, false, 6.0);
+    
+    for( int p = 0; p < oversamplingFactor; ++p )
+    {
+        std::array<double, tapsPerPhase> phase;
+        auto sum = 0.0;
+        
+        for( int k = 0; k < tapsPerPhase; ++k )
+        {
+            auto m = k * oversamplingFactor + p;
+            auto t = (m - centre) / oversamplingFactor;
+            auto sinc = std::sin(pi * t) / (pi * t);
+            
+            phase[static_cast<size_t>(k)] = sinc * window[static_cast<size_t>(m)];
+            sum += phase[static_cast<size_t>(k)];
+        }
+        
+        // unity gain at DC in every phase, so a constant never reads as louder than it is
+        for( int k = 0; k < tapsPerPhase; ++k )
+            std::fill_n(taps + (p * tapsPerPhase + k) * width, width, static_cast<SampleType>(phase[static_cast<size_t>(k)] / sum));
+    }
+    
+    reset();
+}
+
+template<typename SampleType>
+void TruePeakLimiter<SampleType>::reset()
+{
+    std::fill(history, history + 2 * tapsPerPhase * numLanes, SampleType(0));
+    historyPosition = 0;
+    
+    for( int ch = 0; ch < numChannels; ++ch )
+    {
+        peakWindows[static_cast<size_t>(ch)].clear();
+        delays[static_cast<size_t>(ch)].clear();
+    }
+    
+    std::fill(gains, gains + (lookaheadSamples + 1) * numChannels, SampleType(1));
+    gainSums.fill(lookaheadSamples + 1);
+    gainPosition = 0;
+    groupGains.fill(SampleType(1));
+}
+
+template<typename SampleType>
+void TruePeakLimiter<SampleType>::setChannelGroups(const ChannelLayout::ChannelGroups& newGroups)
+{
+    jassert(newGroups.numChannels <= numChannels);
+    
+    groups = newGroups;
+    reset();
+}
+
+template<typename SampleType>
+void TruePeakLimiter<SampleType>::setEnabled(bool shouldBeEnabled)
+{
+    if( shouldBeEnabled && ! enabled )
+        reset();
+    
+    enabled = shouldBeEnabled;
+}
+
+template<typename SampleType>
+void TruePeakLimiter<SampleType>::setCeilingDecibels(float ceilingDecibels)
+{
+    ceiling = juce::Decibels::decibelsToGain(static_cast<SampleType>(ceilingDecibels));
+}
+
+template<typename SampleType>
+void TruePeakLimiter<SampleType>::setReleaseMs(float releaseMs)
+{
+    releaseCte = static_cast<SampleType>(std::exp(-1000.0 / (releaseMs * sampleRate)));
+}
+
+template<typename SampleType>
+void TruePeakLimiter<SampleType>::detectPeaks(Lanes& peaks) const
+{
+    // oldest first, so window row tapsPerPhase - 1 - k holds the input k samples ago
+    const auto* window = history + historyPosition * numLanes;
+    const auto newest = tapsPerPhase - 1;
+    
+    for( int lane = 0; lane < numLanes; lane += width )
+    {
+        auto peak = Vec::abs(Vec::fromRawArray(window + (newest - detectorDelay) * numLanes + lane));
+        
+        for( int p = 0; p < oversamplingFactor; ++p )
+        {
+            const auto* phaseTaps = taps + p * tapsPerPhase * width;
+            auto sum = Vec::expand(SampleType(0));
+            
+            for( int k = 0; k < tapsPerPhase; ++k )
+                sum += Vec::fromRawArray(phaseTaps + k * width) * Vec::fromRawArray(window + (newest - k) * numLanes + lane);
+            
+            peak = Vec::max(peak, Vec::abs(sum));
+        }
+        
+        peak.copyToRawArray(peaks.data() + lane);
+    }
+}
+
+template<typename SampleType>
+void TruePeakLimiter<SampleType>::process(juce::AudioBuffer<SampleType>& buffer)
+{
+    auto numSamples = buffer.getNumSamples();
+    auto channelsInBuffer = juce::jmin(buffer.getNumChannels(), numChannels);
+    auto* const* channels = buffer.getArrayOfWritePointers();
+    const auto latency = getLatencySamples();
+    const auto averageLength = lookaheadSamples + 1;
+    
+    // unused lanes stay silent, so they never read as a peak
+    alignas(64) Lanes in {}, peaks {};
+    Lanes framePeaks, rampedGains;
+    
+    for( int i = 0; i < numSamples; ++i )
+    {
+        for( int ch = 0; ch < channelsInBuffer; ++ch )
+            in[static_cast<size_t>(ch)] = channels[ch][i];
+        
+        std::copy(in.begin(), in.begin() + numLanes, history + historyPosition * numLanes);
+        std::copy(in.begin(), in.begin() + numLanes, history + (historyPosition + tapsPerPhase) * numLanes);
+        
+        if( ++historyPosition == tapsPerPhase )
+            historyPosition = 0;
+        
+        detectPeaks(peaks);
+        
+        framePeaks.fill(SampleType(0));
+        
+        for( int ch = 0; ch < channelsInBuffer; ++ch )
+        {
+            auto& framePeak = framePeaks[static_cast<size_t>(groups.groupOfChannel[ch])];
+            framePeak = juce::jmax(framePeak, peaks[static_cast<size_t>(ch)]);
+        }
+        
+        // the gain the loudest peak within the lookahead needs, released, then averaged into a ramp
+        for( int g = 0; g < groups.numGroups; ++g )
+        {
+            auto peak = peakWindows[static_cast<size_t>(g)].push(framePeaks[static_cast<size_t>(g)], lookaheadSamples);
+            auto target = peak > ceiling ? ceiling / peak : SampleType(1);
+            auto& gain = groupGains[static_cast<size_t>(g)];
+            gain = juce::jmin(target, SampleType(1) - (SampleType(1) - gain) * releaseCte);
+            
+            auto& gainInRow = gains[g * averageLength + gainPosition];
+            gainSums[static_cast<size_t>(g)] += gain - gainInRow;
+            gainInRow = gain;
+            
+            rampedGains[static_cast<size_t>(g)] = static_cast<SampleType>(gainSums[static_cast<size_t>(g)] / averageLength);
+        }
+        
+        if( ++gainPosition == averageLength )
+            gainPosition = 0;
+        
+        for( int ch = 0; ch < channelsInBuffer; ++ch )
+        {
+            auto rampedGain = rampedGains[static_cast<size_t>(groups.groupOfChannel[ch])];
+            channels[ch][i] = delays[static_cast<size_t>(ch)].push(channels[ch][i], latency) * rampedGain;
+        }
+    }
+    
+    // the running sums only ever pick up rounding, resumming once a block keeps them exact
+    for( int g = 0; g < groups.numGroups; ++g )
+        gainSums[static_cast<size_t>(g)] = std::accumulate(gains + g * averageLength, gains + (g + 1) * averageLength, 0.0);
+}
+
+template struct TruePeakLimiter<float>;
+template struct TruePeakLimiter<double>;
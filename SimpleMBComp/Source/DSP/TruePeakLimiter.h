@@ -0,0 +1,95 @@
+/*
+  ==============================================================================
+
+    TruePeakLimiter.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChannelLayout.h"
+#include "Arena.h"
+#include "Lookahead.h"
+
+/*
+ Brickwall limiter for the summed output, on true peaks rather than sample peaks.
+ 
+ The peaks between samples are estimated with a 4x polyphase FIR: every phase of the
+ interpolator is run for every input sample, and the loudest of them (and the sample
+ itself) is the detector's input. The FIR works on SIMD registers of channels, the
+ same way the crossover's generic kernel does.
+ 
+ All channels share one gain, so the image doesn't move when one side gets limited.
+ A stream batch's streams have nothing to do with each other, so there each stream is
+ a group with a gain of its own, see setChannelGroups().
+ 
+ The gain needed over the next lookaheadMs comes from a sliding maximum of the peaks,
+ gets a release, then a moving average as long as the lookahead. Every sample in that
+ average is already at or below what the peak needs, so the ramp lands in time.
+ */
+template<typename SampleType>
+struct TruePeakLimiter
+{
+    static constexpr int oversamplingFactor = 4;
+    static constexpr int tapsPerPhase = 24;
+    static constexpr float lookaheadMs = 1.5f;
+    
+    // everything lives in the arena, called from Arena::build() before prepare()
+    void allocate(Arena& arena, const juce::dsp::ProcessSpec& spec);
+    
+    void prepare(const juce::dsp::ProcessSpec& spec);
+    void reset();
+    
+    // realtime safe, switching it on starts from silence
+    void setEnabled(bool shouldBeEnabled);
+    bool isEnabled() const { return enabled; }
+    
+    // channels in a group share a gain. Allocating puts them all in one, clears everything
+    void setChannelGroups(const ChannelLayout::ChannelGroups& groups);
+    
+    void setCeilingDecibels(float ceilingDecibels);
+    void setReleaseMs(float releaseMs);
+    
+    void process(juce::AudioBuffer<SampleType>& buffer);
+    
+    // the lookahead plus the interpolator's delay, constant once prepared
+    int getLatencySamples() const { return lookaheadSamples + detectorDelay; }
+private:
+    using Vec = juce::dsp::SIMDRegister<SampleType>;
+    using Lanes = std::array<SampleType, ChannelLayout::maxChannels>;
+    static constexpr int width = static_cast<int>(Vec::SIMDNumElements);
+    static constexpr int numTaps = oversamplingFactor * tapsPerPhase;
+    
+    // the loudest of the interpolated phases around the input detectorDelay samples ago, one per lane
+    void detectPeaks(Lanes& peaks) const;
+    
+    bool enabled = false;
+    double sampleRate = 44100.0;
+    int numChannels = 0, numLanes = 0;
+    
+    // every tap repeated across a register, phase major, so the FIR only does aligned loads
+    SampleType* taps = nullptr;
+    
+    // the last tapsPerPhase input frames (a lane per channel), stored twice over so they are always contiguous
+    SampleType* history = nullptr;
+    int historyPosition = 0;
+    static constexpr int detectorDelay = tapsPerPhase / 2;
+    
+    ChannelLayout::ChannelGroups groups;
+    
+    // the detector and the gain ramp are per group, the delays per channel
+    std::array<SlidingMaximum<SampleType>, ChannelLayout::maxChannels> peakWindows;
+    std::array<LookaheadDelay<SampleType>, ChannelLayout::maxChannels> delays;
+    int lookaheadSamples = 0;
+    
+    // each group's moving average over its last lookaheadSamples + 1 gains, a row per group.
+    // Summed in double so it can't drift far
+    SampleType* gains = nullptr;
+    std::array<double, ChannelLayout::maxChannels> gainSums {};
+    int gainPosition = 0;
+    
+    SampleType ceiling = 1, releaseCte = 0;
+    Lanes groupGains {};
+};
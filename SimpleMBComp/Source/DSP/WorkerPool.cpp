@@ -0,0 +1,170 @@
+/*
+  ==============================================================================
+
+    WorkerPool.cpp
+
+  ==============================================================================
+*/
+
+#include "WorkerPool.h"
+
+#if JUCE_INTEL
+ #include <emmintrin.h>
+#endif
+
+namespace
+{
+    // how long a worker keeps polling for the next job of the same block before going to sleep,
+    // and how long the audio thread spins on the join before yielding
+    constexpr int workerSpinCount = 4000;
+    constexpr int joinSpinCount = 1000;
+    
+    inline void spinPause()
+    {
+       #if JUCE_INTEL
+        _mm_pause();
+       #elif JUCE_ARM && (JUCE_GCC || JUCE_CLANG)
+        __asm__ __volatile__ ("yield");
+       #endif
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    stop();
+}
+
+void WorkerPool::start(int numWorkers, double sampleRate, int samplesPerBlock)
+{
+    stop();
+    
+    for( int i = 0; i < numWorkers; ++i )
+    {
+        auto worker = std::make_unique<Worker>(*this, i);
+        
+        auto options = juce::Thread::RealtimeOptions{}
+                        .withPriority(10)
+                        .withApproximateAudioProcessingTime(samplesPerBlock, sampleRate);
+        
+        if( ! worker->startRealtimeThread(options) )
+            worker->startThread(juce::Thread::Priority::highest);
+        
+        workers.push_back(std::move(worker));
+    }
+}
+
+void WorkerPool::stop()
+{
+    for( auto& worker : workers )
+    {
+        worker->signalThreadShouldExit();
+        worker->wakeUp.signal();
+    }
+    
+    for( auto& worker : workers )
+        worker->stopThread(1000);
+    
+    workers.clear();
+}
+
+void WorkerPool::run(int numItems, JobFunction function, void* context)
+{
+    jassert(numItems <= 0xffff);
+    
+    // nothing can be claimed now: the previous job's items are all handed out and done.
+    // A stale worker may still read these before the new claim is published, but can't act on them
+    jobFunction.store(function, std::memory_order_relaxed);
+    jobContext.store(context, std::memory_order_relaxed);
+    itemsDone.store(0, std::memory_order_relaxed);
+    
+    // seq_cst pairs with the sleeping flag in Worker::run(), so a worker can't miss the wake up
+    auto generation = generationOf(claim.load(std::memory_order_relaxed)) + 1;
+    claim.store((static_cast<juce::uint64>(generation) << 32) | (static_cast<juce::uint64>(numItems) << 16));
+    
+    wakeWorkers();
+    workOnJob(generation);
+    
+    for( int spins = 0; itemsDone.load(std::memory_order_acquire) < numItems; ++spins )
+    {
+        if( spins < joinSpinCount )
+            spinPause();
+        else
+            std::this_thread::yield();
+    }
+}
+
+void WorkerPool::wakeWorkers()
+{
+    for( auto& worker : workers )
+    {
+        if( worker->sleeping.load() )
+            worker->wakeUp.signal();
+    }
+}
+
+bool WorkerPool::workOnJob(juce::uint32 generation)
+{
+    auto function = jobFunction.load(std::memory_order_relaxed);
+    auto context = jobContext.load(std::memory_order_relaxed);
+    
+    auto didWork = false;
+    auto current = claim.load(std::memory_order_acquire);
+    
+    // if the function/context above already belong to a newer job, this job is finished
+    // and every item is handed out, so the loop can't claim anything with them
+    while( generationOf(current) == generation && itemOf(current) < sizeOf(current) )
+    {
+        if( claim.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel) )
+        {
+            function(context, static_cast<int>(itemOf(current)));
+            itemsDone.fetch_add(1, std::memory_order_release);
+            
+            didWork = true;
+            current = claim.load(std::memory_order_acquire);
+        }
+    }
+    
+    return didWork;
+}
+
+WorkerPool::Worker::Worker(WorkerPool& p, int index) :
+juce::Thread("SimpleMBComp worker " + juce::String(index)),
+pool(p)
+{
+}
+
+void WorkerPool::Worker::run()
+{
+    juce::ScopedNoDenormals noDenormals;
+    auto lastGeneration = generationOf(pool.claim.load(std::memory_order_acquire));
+    auto idleSpins = 0;
+    
+    while( ! threadShouldExit() )
+    {
+        auto generation = generationOf(pool.claim.load(std::memory_order_acquire));
+        
+        if( generation != lastGeneration )
+        {
+            lastGeneration = generation;
+            pool.workOnJob(generation);
+            idleSpins = 0;
+            continue;
+        }
+        
+        if( ++idleSpins < workerSpinCount )
+        {
+            spinPause();
+            continue;
+        }
+        
+        // announce we are going to sleep, then check once more so a job published in between isn't missed.
+        // No timeout: an idle worker stays asleep until the next job's wakeWorkers() or stop()
+        sleeping.store(true);
+        
+        if( generationOf(pool.claim.load()) == lastGeneration && ! threadShouldExit() )
+            wakeUp.wait(-1);
+        
+        sleeping.store(false, std::memory_order_release);
+        idleSpins = 0;
+    }
+}
@@ -0,0 +1,88 @@
+/*
+  ==============================================================================
+
+    WorkerPool.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+ A handful of pre-spawned realtime threads that help the audio thread get
+ through one block. Threads are only started/stopped off the audio thread, see
+ SharedDsp; parallelFor() itself never allocates, locks or blocks. Between
+ jobs the workers spin briefly, then sleep until the next one.
+ 
+ Work items are handed out through a single atomic word holding the job
+ generation, its size and the next item, so a worker that wakes up late can
+ never claim an item of the next job or one past the end of its own. The audio thread works on the items too, then spins (yielding after
+ a while) until every claimed item is done.
+ */
+struct WorkerPool
+{
+    WorkerPool() = default;
+    ~WorkerPool();
+    
+    void start(int numWorkers, double sampleRate, int samplesPerBlock);
+    void stop();
+    
+    int getNumWorkers() const { return static_cast<int>(workers.size()); }
+    
+    /*
+     calls fn(itemIndex) once for every item, on any thread. Returns when all items are done.
+     Several audio threads can share a pool: whoever finds it busy runs its items itself,
+     rather than waiting on another instance's block.
+     */
+    template<typename Fn>
+    void parallelFor(int numItems, Fn&& fn)
+    {
+        if( workers.empty() || numItems < 2 || busy.exchange(true, std::memory_order_acquire) )
+        {
+            for( int i = 0; i < numItems; ++i )
+                fn(i);
+            
+            return;
+        }
+        
+        using FnType = std::remove_reference_t<Fn>;
+        run(numItems, [](void* context, int item) { (*static_cast<FnType*>(context))(item); }, &fn);
+        
+        busy.store(false, std::memory_order_release);
+    }
+private:
+    using JobFunction = void (*)(void* context, int item);
+    
+    void run(int numItems, JobFunction function, void* context);
+    void wakeWorkers();
+    
+    // returns true if it did any work for the job of this generation
+    bool workOnJob(juce::uint32 generation);
+    
+    static juce::uint32 generationOf(juce::uint64 claim) { return static_cast<juce::uint32>(claim >> 32); }
+    static juce::uint32 sizeOf(juce::uint64 claim) { return static_cast<juce::uint32>(claim >> 16) & 0xffff; }
+    static juce::uint32 itemOf(juce::uint64 claim) { return static_cast<juce::uint32>(claim) & 0xffff; }
+    
+    struct Worker : juce::Thread
+    {
+        Worker(WorkerPool& p, int index);
+        void run() override;
+        
+        WorkerPool& pool;
+        juce::WaitableEvent wakeUp;
+        std::atomic<bool> sleeping {false};
+    };
+    
+    std::vector<std::unique_ptr<Worker>> workers;
+    
+    // bits 32-63: job generation, 16-31: number of items, 0-15: next item to hand out
+    std::atomic<juce::uint64> claim {0};
+    std::atomic<JobFunction> jobFunction {nullptr};
+    std::atomic<void*> jobContext {nullptr};
+    std::atomic<int> itemsDone {0};
+    
+    // held by the thread whose job the pool is running
+    std::atomic<bool> busy {false};
+};
@@ -16,6 +16,7 @@ SimpleMBCompAudioProcessor::SimpleMBCompAudioProcessor()
                      #if ! JucePlugin_IsMidiEffect
                       #if ! JucePlugin_IsSynth
                        .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                       .withInput  ("Sidechain", juce::AudioChannelSet::stereo(), false)
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
@@ -30,65 +31,129 @@ SimpleMBCompAudioProcessor::SimpleMBCompAudioProcessor()
         jassert(param != nullptr);
     };
     
-    floatHelper(lowBandComp.attack, Names::Attack_Low_Band);
-    floatHelper(lowBandComp.release, Names::Release_Low_Band);
-    floatHelper(lowBandComp.threshold, Names::Threshold_Low_Band);
-    
-    floatHelper(midBandComp.attack, Names::Attack_Mid_Band);
-    floatHelper(midBandComp.release, Names::Release_Mid_Band);
-    floatHelper(midBandComp.threshold, Names::Threshold_Mid_Band);
-    
-    floatHelper(highBandComp.attack, Names::Attack_High_Band);
-    floatHelper(highBandComp.release, Names::Release_High_Band);
-    floatHelper(highBandComp.threshold, Names::Threshold_High_Band);
-    
     auto choiceHelper = [&apvts = this->apvts, &params](auto& param, const auto& paramName){
         param = dynamic_cast<juce::AudioParameterChoice*>(apvts.getParameter(params.at(paramName)));
         jassert(param != nullptr);
     };
     
-    choiceHelper(lowBandComp.ratio, Names::Ratio_Low_Band);
-    choiceHelper(midBandComp.ratio, Names::Ratio_Mid_Band);
-    choiceHelper(highBandComp.ratio, Names::Ratio_High_Band);
-    
     auto boolHelper = [&apvts = this->apvts, &params](auto& param, const auto& paramName){
         param = dynamic_cast<juce::AudioParameterBool*>(apvts.getParameter(params.at(paramName)));
         jassert(param != nullptr);
     };
     
-    boolHelper(lowBandComp.bypass, Names::Bypass_Low_Band);
-    boolHelper(midBandComp.bypass, Names::Bypass_Mid_Band);
-    boolHelper(highBandComp.bypass, Names::Bypass_High_Band);
-    
-    boolHelper(lowBandComp.mute, Names::Mute_Low_Band);
-    boolHelper(midBandComp.mute, Names::Mute_Mid_Band);
-    boolHelper(highBandComp.mute, Names::Mute_High_Band);
+    auto bindBands = [&](auto& bands)
+    {
+        auto& lowBandComp = bands[0];
+        auto& midBandComp = bands[1];
+        auto& highBandComp = bands[2];
+        
+        floatHelper(lowBandComp.attack, Names::Attack_Low_Band);
+        floatHelper(lowBandComp.release, Names::Release_Low_Band);
+        floatHelper(lowBandComp.threshold, Names::Threshold_Low_Band);
+        
+        floatHelper(midBandComp.attack, Names::Attack_Mid_Band);
+        floatHelper(midBandComp.release, Names::Release_Mid_Band);
+        floatHelper(midBandComp.threshold, Names::Threshold_Mid_Band);
+        
+        floatHelper(highBandComp.attack, Names::Attack_High_Band);
+        floatHelper(highBandComp.release, Names::Release_High_Band);
+        floatHelper(highBandComp.threshold, Names::Threshold_High_Band);
+        
+        choiceHelper(lowBandComp.ratio, Names::Ratio_Low_Band);
+        choiceHelper(midBandComp.ratio, Names::Ratio_Mid_Band);
+        choiceHelper(highBandComp.ratio, Names::Ratio_High_Band);
+        
+        floatHelper(lowBandComp.sideThreshold, Names::Side_Threshold_Low_Band);
+        floatHelper(midBandComp.sideThreshold, Names::Side_Threshold_Mid_Band);
+        floatHelper(highBandComp.sideThreshold, Names::Side_Threshold_High_Band);
+        
+        floatHelper(lowBandComp.sideAttack, Names::Side_Attack_Low_Band);
+        floatHelper(midBandComp.sideAttack, Names::Side_Attack_Mid_Band);
+        floatHelper(highBandComp.sideAttack, Names::Side_Attack_High_Band);
+        
+        floatHelper(lowBandComp.sideRelease, Names::Side_Release_Low_Band);
+        floatHelper(midBandComp.sideRelease, Names::Side_Release_Mid_Band);
+        floatHelper(highBandComp.sideRelease, Names::Side_Release_High_Band);
+        
+        choiceHelper(lowBandComp.sideRatio, Names::Side_Ratio_Low_Band);
+        choiceHelper(midBandComp.sideRatio, Names::Side_Ratio_Mid_Band);
+        choiceHelper(highBandComp.sideRatio, Names::Side_Ratio_High_Band);
+        
+        boolHelper(lowBandComp.bypass, Names::Bypass_Low_Band);
+        boolHelper(midBandComp.bypass, Names::Bypass_Mid_Band);
+        boolHelper(highBandComp.bypass, Names::Bypass_High_Band);
+        
+        boolHelper(lowBandComp.mute, Names::Mute_Low_Band);
+        boolHelper(midBandComp.mute, Names::Mute_Mid_Band);
+        boolHelper(highBandComp.mute, Names::Mute_High_Band);
+        
+        boolHelper(lowBandComp.solo, Names::Solo_Low_Band);
+        boolHelper(midBandComp.solo, Names::Solo_Mid_Band);
+        boolHelper(highBandComp.solo, Names::Solo_High_Band);
+        
+        floatHelper(lowBandComp.lookahead, Names::Lookahead_Low_Band);
+        floatHelper(midBandComp.lookahead, Names::Lookahead_Mid_Band);
+        floatHelper(highBandComp.lookahead, Names::Lookahead_High_Band);
+        
+        choiceHelper(lowBandComp.detector, Names::Detector_Low_Band);
+        choiceHelper(midBandComp.detector, Names::Detector_Mid_Band);
+        choiceHelper(highBandComp.detector, Names::Detector_High_Band);
+        
+        floatHelper(lowBandComp.detectorWindow, Names::Detector_Window_Low_Band);
+        floatHelper(midBandComp.detectorWindow, Names::Detector_Window_Mid_Band);
+        floatHelper(highBandComp.detectorWindow, Names::Detector_Window_High_Band);
+        
+        choiceHelper(lowBandComp.oversampling, Names::Oversampling_Low_Band);
+        choiceHelper(midBandComp.oversampling, Names::Oversampling_Mid_Band);
+        choiceHelper(highBandComp.oversampling, Names::Oversampling_High_Band);
+        
+        floatHelper(lowBandComp.mix, Names::Mix_Low_Band);
+        floatHelper(midBandComp.mix, Names::Mix_Mid_Band);
+        floatHelper(highBandComp.mix, Names::Mix_High_Band);
+    };
     
-    boolHelper(lowBandComp.solo, Names::Solo_Low_Band);
-    boolHelper(midBandComp.solo, Names::Solo_Mid_Band);
-    boolHelper(highBandComp.solo, Names::Solo_High_Band);
+    bindBands(bandParams);
+    boolHelper(linkChannels, Names::Link_Channels);
     
     floatHelper(lowMidCrossover, Names::Low_Mid_Crossover_Freq);
     floatHelper(midHighCrossover, Names::Mid_High_Crossover_Freq);
+    choiceHelper(crossoverSlope, Names::Crossover_Slope);
     
     floatHelper(inputGainParam, Names::Gain_In);
     floatHelper(outputGainParam, Names::Gain_Out);
     
-    // set one of the filters to high pass. By default both are low pass
-    LP1.setType(juce::dsp::LinkwitzRileyFilterType::lowpass);
-    HP1.setType(juce::dsp::LinkwitzRileyFilterType::highpass);
+    boolHelper(parallelProcessing, Names::Parallel_Processing);
+    choiceHelper(decimatedBands, Names::Decimated_Bands);
+    choiceHelper(offlineOversampling, Names::Offline_Oversampling);
+    boolHelper(offlineRenderQuality, Names::Offline_Render_Quality);
     
-    AP2.setType(juce::dsp::LinkwitzRileyFilterType::allpass);
+    boolHelper(limiterParam, Names::Limiter);
+    floatHelper(limiterCeiling, Names::Limiter_Ceiling);
+    floatHelper(limiterRelease, Names::Limiter_Release);
     
-    LP2.setType(juce::dsp::LinkwitzRileyFilterType::lowpass);
-    HP2.setType(juce::dsp::LinkwitzRileyFilterType::highpass);
+    floatHelper(mixParam, Names::Mix);
+    choiceHelper(stereoMode, Names::Stereo_Mode);
+    boolHelper(externalSidechain, Names::External_Sidechain);
     
+    choiceHelper(linkBusSend, Names::Link_Bus_Send);
+    choiceHelper(linkBusReceive, Names::Link_Bus_Receive);
     
+    choiceHelper(processingMode, Names::Processing_Mode);
+    choiceHelper(spectralBands, Names::Spectral_Bands);
     
+    // the engine only starts or stops what these need in updateResources()
+    for(auto name : { Names::Parallel_Processing, Names::Offline_Render_Quality, Names::Processing_Mode })
+        apvts.addParameterListener(params.at(name), this);
 }
 
 SimpleMBCompAudioProcessor::~SimpleMBCompAudioProcessor()
 {
+    using namespace Params;
+    const auto& params = GetParams();
+    
+    for(auto name : { Names::Parallel_Processing, Names::Offline_Render_Quality, Names::Processing_Mode })
+        apvts.removeParameterListener(params.at(name), this);
+    cancelPendingUpdate();
 }
 
 //==============================================================================
@@ -159,44 +224,23 @@ void SimpleMBCompAudioProcessor::prepareToPlay (double sampleRate, int samplesPe
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
     
-    juce::dsp::ProcessSpec spec;
-    spec.maximumBlockSize = samplesPerBlock;
-    spec.numChannels = getTotalNumOutputChannels();
-    spec.sampleRate = sampleRate;
-    
-    for(auto& compressor : compressors)
-        compressor.prepare(spec);
-    
-    LP1.prepare(spec);
-    HP1.prepare(spec);
-    
-    AP2.prepare(spec);
+    // the chains get built for the parameters they'll start with
+    engine.setParameters(getEngineParameters());
+    engine.setNonRealtime(isNonRealtime());
     
-    LP2.prepare(spec);
-    HP2.prepare(spec);
-    
-//    invAP1.prepare(spec);
-//    invAP2.prepare(spec);
-//
-//    invAPBuffer.setSize(spec.numChannels, samplesPerBlock);
-    
-    inputGain.prepare(spec);
-    outputGain.prepare(spec);
-    
-    inputGain.setRampDurationSeconds(0.05); // 50ms
-    outputGain.setRampDurationSeconds(0.05); // 50ms
-    
-    for( auto& buffer: filterBuffers)
-    {
-        buffer.setSize(spec.numChannels, samplesPerBlock);
-    }
+    // the sidechain's path is only built while the host has the bus enabled
+    auto numKeyChannels = juce::jmin(getChannelCountOfBus(true, 1), getTotalNumOutputChannels());
     
+    // the host picks the precision before preparing, so the other chain stays unallocated
+    engine.prepare(sampleRate, samplesPerBlock, getChannelLayoutOfBus(false, 0), numKeyChannels, isUsingDoublePrecision());
+    setLatencySamples(engine.getLatencySamples());
 }
 
 void SimpleMBCompAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    engine.release();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -206,12 +250,12 @@ bool SimpleMBCompAudioProcessor::isBusesLayoutSupported (const BusesLayout& layo
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Any layout up to ChannelLayout::maxChannels is supported: mono, stereo,
+    // surround/immersive (5.1, 7.1.4...), ambisonics and plain discrete buses.
+    // The DSP kernels are specialised for the common channel counts.
+    auto mainOutput = layouts.getMainOutputChannelSet();
+    if (mainOutput.isDisabled()
+     || mainOutput.size() > ChannelLayout::maxChannels)
         return false;
 
     // This checks if the input layout matches the output layout
@@ -220,121 +264,161 @@ bool SimpleMBCompAudioProcessor::isBusesLayoutSupported (const BusesLayout& layo
         return false;
    #endif
 
+    // The sidechain is optional. When it's on, it is either mono (keys every
+    // channel) or as wide as the main bus (keys each channel with its own)
+    auto sidechain = layouts.getChannelSet (true, 1);
+    if (! sidechain.isDisabled()
+     && sidechain.size() != 1
+     && sidechain.size() != mainOutput.size())
+        return false;
+
     return true;
   #endif
 }
 #endif
 
-void SimpleMBCompAudioProcessor::updateState()
+void SimpleMBCompAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
-    for(auto& compressor : compressors)
-    {
-        compressor.updateCompressorSettings();
-    }
-    
-    auto lowMidCutoffFreq = lowMidCrossover->get();
-    LP1.setCutoffFrequency(lowMidCutoffFreq);
-    HP1.setCutoffFrequency(lowMidCutoffFreq);
-    
-    auto midHighCutoffFreq = midHighCrossover->get();
-    AP2.setCutoffFrequency(midHighCutoffFreq);
-    LP2.setCutoffFrequency(midHighCutoffFreq);
-    HP2.setCutoffFrequency(midHighCutoffFreq);
-    
-    inputGain.setGainDecibels(inputGainParam->get());
-    outputGain.setGainDecibels(outputGainParam->get());
+    processBlockImpl(buffer);
 }
 
-void SimpleMBCompAudioProcessor::splitBands(const juce::AudioBuffer<float> &inputBuffer)
+void SimpleMBCompAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
 {
-    for(auto& fb : filterBuffers)
-    {
-        fb = inputBuffer;
-    }
-    
-    auto fb0Block = juce::dsp::AudioBlock<float>(filterBuffers[0]);
-    auto fb1Block = juce::dsp::AudioBlock<float>(filterBuffers[1]);
-    auto fb2Block = juce::dsp::AudioBlock<float>(filterBuffers[2]);
-    
-    auto fb0Ctx = juce::dsp::ProcessContextReplacing<float>(fb0Block);
-    auto fb1Ctx = juce::dsp::ProcessContextReplacing<float>(fb1Block);
-    auto fb2Ctx = juce::dsp::ProcessContextReplacing<float>(fb2Block);
-    
-    LP1.process(fb0Ctx);
-    AP2.process(fb0Ctx);
-    
-    HP1.process(fb1Ctx);
-    filterBuffers[2] = filterBuffers[1];
-    LP2.process(fb1Ctx);
-    
-    HP2.process(fb2Ctx);
+    processBlockImpl(buffer);
 }
 
-void SimpleMBCompAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+template<typename SampleType>
+void SimpleMBCompAudioProcessor::processBlockImpl(juce::AudioBuffer<SampleType>& hostBuffer)
 {
-    juce::ScopedNoDenormals noDenormals;
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
-        buffer.clear (i, 0, buffer.getNumSamples());
-   
-    updateState();
+        hostBuffer.clear (i, 0, hostBuffer.getNumSamples());
+    
+    engine.setParameters(getEngineParameters());
+    engine.setNonRealtime(isNonRealtime());
     
-    applyGain(buffer, inputGain);
+    // both only refer to the host's channels: the main bus, and the sidechain's after it
+    auto buffer = getBusBuffer(hostBuffer, false, 0);
+    auto sidechain = getBusBuffer(hostBuffer, true, 1);
     
-    splitBands(buffer);
+    engine.process(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), buffer.getNumSamples(),
+                   sidechain.getArrayOfWritePointers(), sidechain.getNumChannels());
     
-    for(size_t i = 0; i < filterBuffers.size(); ++i)
+    // the host gets told asynchronously, so this is fine from the audio thread
+    if( engine.getLatencySamples() != getLatencySamples() )
+        setLatencySamples(engine.getLatencySamples());
+}
+
+MultibandCompressor::Parameters SimpleMBCompAudioProcessor::getEngineParameters() const
+{
+    MultibandCompressor::Parameters parameters;
+    
+    for(size_t i = 0; i < bandParams.size(); ++i)
     {
-        compressors[i].process(filterBuffers[i]);
+        auto& band = bandParams[i];
+        auto& settings = parameters.bands[i];
+    
+        settings.attackMs = band.attack->get();
+        settings.releaseMs = band.release->get();
+        settings.thresholdDecibels = band.threshold->get();
+        settings.ratio = band.ratio->getCurrentChoiceName().getFloatValue();
+    
+        settings.sideAttackMs = band.sideAttack->get();
+        settings.sideReleaseMs = band.sideRelease->get();
+        settings.sideThresholdDecibels = band.sideThreshold->get();
+        settings.sideRatio = band.sideRatio->getCurrentChoiceName().getFloatValue();
+        
+        settings.bypass = band.bypass->get();
+        settings.mute = band.mute->get();
+        settings.solo = band.solo->get();
+        settings.lookaheadMs = band.lookahead->get();
+        settings.detector = band.detector->getIndex();
+        settings.detectorWindowMs = band.detectorWindow->get();
+        settings.oversampling = band.oversampling->getIndex();
+        settings.mix = band.mix->get();
     }
     
-    auto numSamples = buffer.getNumSamples();
-    auto numChannels = buffer.getNumChannels();
+    parameters.lowMidCrossover = lowMidCrossover->get();
+    parameters.midHighCrossover = midHighCrossover->get();
+    parameters.crossoverSlope = crossoverSlope->getIndex();
     
-    // we need to clear our input before we start adding our filter buffers to it
-    buffer.clear();
+    parameters.inputGainDecibels = inputGainParam->get();
+    parameters.outputGainDecibels = outputGainParam->get();
+    parameters.mix = mixParam->get();
     
-    // each channel of our filter buffer needs to be copied back to the input buffer. Write a helper function or lambda to do that
-    auto addFilterBand = [nc = numChannels, ns = numSamples](auto& inputBuffer, const auto& source)
-    {
-        // loop through all channels in the input buffer and copy from source buffer into that
-        for(auto i = 0; i < nc; ++i)
-        {
-            inputBuffer.addFrom(i, 0, source, i, 0, ns); // get sequence of parameters in the function by typing buffer.addFrom
-        }
-    };
+    parameters.linkChannels = linkChannels->get();
+    parameters.midSide = stereoMode->getIndex() == 1;
+    parameters.externalSidechain = externalSidechain->get();
+    parameters.parallelProcessing = parallelProcessing->get();
     
-    auto bandsAreSoloed = false;
-    for(auto& comp : compressors)
-    {
-        if(comp.solo->get())
-        {
-            bandsAreSoloed=true;
-            break;
-        }
-    }
+    parameters.decimatedBands = decimatedBands->getIndex();
+    parameters.offlineOversampling = offlineOversampling->getIndex();
+    parameters.offlineRenderQuality = offlineRenderQuality->get();
+    
+    parameters.limiter = limiterParam->get();
+    parameters.limiterCeilingDecibels = limiterCeiling->get();
+    parameters.limiterReleaseMs = limiterRelease->get();
+    
+    parameters.linkBusSend = linkBusSend->getIndex();
+    parameters.linkBusReceive = linkBusReceive->getIndex();
+
+    parameters.spectral = processingMode->getIndex() == 1;
+    parameters.spectralBands = 16 << spectralBands->getIndex();
+    
+    return parameters;
+}
 
-    if(bandsAreSoloed)
+void SimpleMBCompAudioProcessor::parameterChanged(const juce::String& parameterID, float newValue)
+{
+    // can be the audio thread, when the host automates it
+    triggerAsyncUpdate();
+}
+
+void SimpleMBCompAudioProcessor::handleAsyncUpdate()
+{
+    // starting the workers and allocating the buffers happens while processBlock carries on,
+    // the callback lock is only held to hand them over
+    auto parameters = getEngineParameters();
+    auto resources = engine.buildResources(parameters);
+    
     {
-        for (size_t i=0; i < compressors.size(); ++i) {
-            auto& comp = compressors[i];
-            if(comp.solo->get())
-            {
-                addFilterBand(buffer, filterBuffers[i]);
-            }
-        }
-    } else {
-        for (size_t i=0; i < compressors.size(); ++i) {
-            auto& comp = compressors[i];
-            if (! comp.mute->get()) {
-                addFilterBand(buffer, filterBuffers[i]);
-            }
-        }
+        const juce::ScopedLock sl (getCallbackLock());
+        
+        engine.setParameters(parameters);
+        engine.swapResources(*resources);
     }
     
-    applyGain(buffer, outputGain);
+    // what the engine no longer needs is freed, and the workers stopped, once the lock is released
+    resources.reset();
+}
+
+void SimpleMBCompAudioProcessor::prepareStreams(double sampleRate, int maximumBlockSize, int numStreams, int channelsPerStream)
+{
+    // what prepareToPlay would be told
+    setRateAndBufferSizeDetails(sampleRate, maximumBlockSize);
+    
+    engine.setParameters(getEngineParameters());
+    engine.setNonRealtime(isNonRealtime());
+    engine.prepareStreams(sampleRate, maximumBlockSize, numStreams, channelsPerStream, isUsingDoublePrecision());
+}
+
+void SimpleMBCompAudioProcessor::processStreams(float* const* const* streams, int numSamples)
+{
+    // offline, so whatever the settings need can be built right here
+    engine.setParameters(getEngineParameters());
+    engine.setNonRealtime(isNonRealtime());
+    engine.updateResources();
+    engine.processStreams(streams, numSamples);
+}
+
+void SimpleMBCompAudioProcessor::processStreams(double* const* const* streams, int numSamples)
+{
+    engine.setParameters(getEngineParameters());
+    engine.setNonRealtime(isNonRealtime());
+    engine.updateResources();
+    engine.processStreams(streams, numSamples);
 }
 
 //==============================================================================
@@ -452,6 +536,56 @@ juce::AudioProcessorValueTreeState::ParameterLayout SimpleMBCompAudioProcessor::
                                                       sa,
                                                       3));
 
+    // the side's own settings in mid/side, the mid uses the ones above
+    layout.add(std::make_unique<AudioParameterFloat>(juce::ParameterID{params.at(Names::Side_Threshold_Low_Band), 1},
+                                                     params.at(Names::Side_Threshold_Low_Band),
+                                                     thresholdRange,
+                                                     0));
+    layout.add(std::make_unique<AudioParameterFloat>(juce::ParameterID{params.at(Names::Side_Threshold_Mid_Band), 1},
+                                                     params.at(Names::Side_Threshold_Mid_Band),
+                                                     thresholdRange,
+                                                     0));
+    layout.add(std::make_unique<AudioParameterFloat>(juce::ParameterID{params.at(Names::Side_Threshold_High_Band), 1},
+                                                     params.at(Names::Side_Threshold_High_Band),
+                                                     thresholdRange,
+                                                     0));
+    layout.add(std::make_unique<AudioParameterFloat>(juce::ParameterID{params.at(Names::Side_Attack_Low_Band), 1},
+                                                     params.at(Names::Side_Attack_Low_Band),
+                                                     attackReleaseRange,
+                                                     5));
+    layout.add(std::make_unique<AudioParameterFloat>(juce::ParameterID{params.at(Names::Side_Attack_Mid_Band), 1},
+                                                     params.at(Names::Side_Attack_Mid_Band),
+                                                     attackReleaseRange,
+                                                     5));
+    layout.add(std::make_unique<AudioParameterFloat>(juce::ParameterID{params.at(Names::Side_Attack_High_Band), 1},
+                                                     params.at(Names::Side_Attack_High_Band),
+                                                     attackReleaseRange,
+                                                     5));
+    layout.add(std::make_unique<AudioParameterFloat>(juce::ParameterID{params.at(Names::Side_Release_Low_Band), 1},
+                                                     params.at(Names::Side_Release_Low_Band),
+                                                     attackReleaseRange,
+                                                     250));
+    layout.add(std::make_unique<AudioParameterFloat>(juce::ParameterID{params.at(Names::Side_Release_Mid_Band), 1},
+                                                     params.at(Names::Side_Release_Mid_Band),
+                                                     attackReleaseRange,
+                                                     250));
+    layout.add(std::make_unique<AudioParameterFloat>(juce::ParameterID{params.at(Names::Side_Release_High_Band), 1},
+                                                     params.at(Names::Side_Release_High_Band),
+                                                     attackReleaseRange,
+                                                     250));
+    layout.add(std::make_unique<AudioParameterChoice>(juce::ParameterID{params.at(Names::Side_Ratio_Low_Band), 1},
+                                                      params.at(Names::Side_Ratio_Low_Band),
+                                                      sa,
+                                                      3));
+    layout.add(std::make_unique<AudioParameterChoice>(juce::ParameterID{params.at(Names::Side_Ratio_Mid_Band), 1},
+                                                      params.at(Names::Side_Ratio_Mid_Band),
+                                                      sa,
+                                                      3));
+    layout.add(std::make_unique<AudioParameterChoice>(juce::ParameterID{params.at(Names::Side_Ratio_High_Band), 1},
+                                                      params.at(Names::Side_Ratio_High_Band),
+                                                      sa,
+                                                      3));
+
     layout.add(std::make_unique<AudioParameterBool>(juce::ParameterID{params.at(Names::Bypass_Low_Band), 1},
                                                     params.at(Names::Bypass_Low_Band),
                                                     false));
@@ -490,6 +624,147 @@ juce::AudioProcessorValueTreeState::ParameterLayout SimpleMBCompAudioProcessor::
                                                      params.at(Names::Mid_High_Crossover_Freq),
                                                      NormalisableRange<float>(1000, 20000, 1, 1),
                                                      2000));
+    layout.add(std::make_unique<AudioParameterChoice>(juce::ParameterID{params.at(Names::Crossover_Slope), 1},
+                                                      params.at(Names::Crossover_Slope),
+                                                      juce::StringArray{"12 dB/oct", "24 dB/oct", "48 dB/oct"},
+                                                      1));
+    
+    layout.add(std::make_unique<AudioParameterBool>(juce::ParameterID{params.at(Names::Link_Channels), 1},
+                                                    params.at(Names::Link_Channels),
+                                                    false));
+    layout.add(std::make_unique<AudioParameterBool>(juce::ParameterID{params.at(Names::Parallel_Processing), 1},
+                                                    params.at(Names::Parallel_Processing),
+                                                    false));
+    layout.add(std::make_unique<AudioParameterChoice>(juce::ParameterID{params.at(Names::Decimated_Bands), 1},
+                                                      params.at(Names::Decimated_Bands),
+                                                      juce::StringArray{"Off", "Low Band", "Low + Mid Bands"},
+                                                      0));
+    
+    auto lookaheadRange = NormalisableRange<float>(0, CompressorBand<float>::maxLookaheadMs, 0.1f, 1);
+    layout.add(std::make_unique<AudioParameterFloat>(juce::ParameterID{params.at(Names::Lookahead_Low_Band), 1},
+                                                     params.at(Names::Lookahead_Low_Band),
+                                                     lookaheadRange,
+                                                     0));
+    layout.add(std::make_unique<AudioParameterFloat>(juce::ParameterID{params.at(Names::Lookahead_Mid_Band), 1},
+                                                     params.at(Names::Lookahead_Mid_Band),
+                                                     lookaheadRange,
+                                                     0));
+    layout.add(std::make_unique<AudioParameterFloat>(juce::ParameterID{params.at(Names::Lookahead_High_Band), 1},
+                                                     params.at(Names::Lookahead_High_Band),
+                                                     lookaheadRange,
+                                                     0));
+    
+    // order matches CompressorBand::DetectorMode
+    auto detectorChoices = juce::StringArray{"Peak", "RMS", "Mean Square"};
+    layout.add(std::make_unique<AudioParameterChoice>(juce::ParameterID{params.at(Names::Detector_Low_Band), 1},
+                                                      params.at(Names::Detector_Low_Band),
+                                                      detectorChoices,
+                                                      0));
+    layout.add(std::make_unique<AudioParameterChoice>(juce::ParameterID{params.at(Names::Detector_Mid_Band), 1},
+                                                      params.at(Names::Detector_Mid_Band),
+                                                      detectorChoices,
+                                                      0));
+    layout.add(std::make_unique<AudioParameterChoice>(juce::ParameterID{params.at(Names::Detector_High_Band), 1},
+                                                      params.at(Names::Detector_High_Band),
+                                                      detectorChoices,
+                                                      0));
+    
+    auto detectorWindowRange = NormalisableRange<float>(1, CompressorBand<float>::maxDetectorWindowMs, 1, 1);
+    layout.add(std::make_unique<AudioParameterFloat>(juce::ParameterID{params.at(Names::Detector_Window_Low_Band), 1},
+                                                     params.at(Names::Detector_Window_Low_Band),
+                                                     detectorWindowRange,
+                                                     50));
+    layout.add(std::make_unique<AudioParameterFloat>(juce::ParameterID{params.at(Names::Detector_Window_Mid_Band), 1},
+                                                     params.at(Names::Detector_Window_Mid_Band),
+                                                     detectorWindowRange,
+                                                     50));
+    layout.add(std::make_unique<AudioParameterFloat>(juce::ParameterID{params.at(Names::Detector_Window_High_Band), 1},
+                                                     params.at(Names::Detector_Window_High_Band),
+                                                     detectorWindowRange,
+                                                     50));
+    
+    auto oversamplingChoices = juce::StringArray{"Off", "2x", "4x"};
+    layout.add(std::make_unique<AudioParameterChoice>(juce::ParameterID{params.at(Names::Oversampling_Low_Band), 1},
+                                                      params.at(Names::Oversampling_Low_Band),
+                                                      oversamplingChoices,
+                                                      0));
+    layout.add(std::make_unique<AudioParameterChoice>(juce::ParameterID{params.at(Names::Oversampling_Mid_Band), 1},
+                                                      params.at(Names::Oversampling_Mid_Band),
+                                                      oversamplingChoices,
+                                                      0));
+    layout.add(std::make_unique<AudioParameterChoice>(juce::ParameterID{params.at(Names::Oversampling_High_Band), 1},
+                                                      params.at(Names::Oversampling_High_Band),
+                                                      oversamplingChoices,
+                                                      0));
+    layout.add(std::make_unique<AudioParameterChoice>(juce::ParameterID{params.at(Names::Offline_Oversampling), 1},
+                                                      params.at(Names::Offline_Oversampling),
+                                                      juce::StringArray{"Same As Realtime", "4x", "8x"},
+                                                      0));
+    layout.add(std::make_unique<AudioParameterBool>(juce::ParameterID{params.at(Names::Offline_Render_Quality), 1},
+                                                    params.at(Names::Offline_Render_Quality),
+                                                    false));
+    
+    auto mixRange = NormalisableRange<float>(0, 100, 1, 1);
+    layout.add(std::make_unique<AudioParameterFloat>(juce::ParameterID{params.at(Names::Mix_Low_Band), 1},
+                                                     params.at(Names::Mix_Low_Band),
+                                                     mixRange,
+                                                     100));
+    layout.add(std::make_unique<AudioParameterFloat>(juce::ParameterID{params.at(Names::Mix_Mid_Band), 1},
+                                                     params.at(Names::Mix_Mid_Band),
+                                                     mixRange,
+                                                     100));
+    layout.add(std::make_unique<AudioParameterFloat>(juce::ParameterID{params.at(Names::Mix_High_Band), 1},
+                                                     params.at(Names::Mix_High_Band),
+                                                     mixRange,
+                                                     100));
+    layout.add(std::make_unique<AudioParameterFloat>(juce::ParameterID{params.at(Names::Mix), 1},
+                                                     params.at(Names::Mix),
+                                                     mixRange,
+                                                     100));
+    
+    layout.add(std::make_unique<AudioParameterChoice>(juce::ParameterID{params.at(Names::Stereo_Mode), 1},
+                                                      params.at(Names::Stereo_Mode),
+                                                      juce::StringArray{"Left/Right", "Mid/Side"},
+                                                      0));
+    
+    layout.add(std::make_unique<AudioParameterBool>(juce::ParameterID{params.at(Names::External_Sidechain), 1},
+                                                    params.at(Names::External_Sidechain),
+                                                    false));
+    
+    juce::StringArray linkChannels {"Off"};
+    
+    for(int i = 1; i <= SharedDsp::numLinkChannels; ++i)
+        linkChannels.add(juce::String(i));
+    
+    layout.add(std::make_unique<AudioParameterChoice>(juce::ParameterID{params.at(Names::Link_Bus_Send), 1},
+                                                      params.at(Names::Link_Bus_Send),
+                                                      linkChannels,
+                                                      0));
+    layout.add(std::make_unique<AudioParameterChoice>(juce::ParameterID{params.at(Names::Link_Bus_Receive), 1},
+                                                      params.at(Names::Link_Bus_Receive),
+                                                      linkChannels,
+                                                      0));
+    
+    layout.add(std::make_unique<AudioParameterChoice>(juce::ParameterID{params.at(Names::Processing_Mode), 1},
+                                                      params.at(Names::Processing_Mode),
+                                                      juce::StringArray{"Crossover", "Spectral"},
+                                                      0));
+    layout.add(std::make_unique<AudioParameterChoice>(juce::ParameterID{params.at(Names::Spectral_Bands), 1},
+                                                      params.at(Names::Spectral_Bands),
+                                                      juce::StringArray{"16", "32", "64"},
+                                                      1));
+    
+    layout.add(std::make_unique<AudioParameterBool>(juce::ParameterID{params.at(Names::Limiter), 1},
+                                                    params.at(Names::Limiter),
+                                                    false));
+    layout.add(std::make_unique<AudioParameterFloat>(juce::ParameterID{params.at(Names::Limiter_Ceiling), 1},
+                                                     params.at(Names::Limiter_Ceiling),
+                                                     NormalisableRange<float>(-12, 0, 0.1f, 1),
+                                                     -1));
+    layout.add(std::make_unique<AudioParameterFloat>(juce::ParameterID{params.at(Names::Limiter_Release), 1},
+                                                     params.at(Names::Limiter_Release),
+                                                     NormalisableRange<float>(1, 1000, 1, 0.4f),
+                                                     100));
     
     return layout;
 }
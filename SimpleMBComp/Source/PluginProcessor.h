@@ -27,13 +27,15 @@
 */
 
 #include <JuceHeader.h>
-#include "DSP/CompressorBand.h"
+#include "DSP/MultibandCompressor.h"
 #include "DSP/Params.h"
 
 //==============================================================================
 /**
 */
-class SimpleMBCompAudioProcessor  : public juce::AudioProcessor
+class SimpleMBCompAudioProcessor  : public juce::AudioProcessor,
+                                    private juce::AudioProcessorValueTreeState::Listener,
+                                    private juce::AsyncUpdater
 {
 public:
     //==============================================================================
@@ -49,6 +51,8 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override { return true; }
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -77,41 +81,97 @@ public:
     static APVTS::ParameterLayout createParameterLayout();
     
     APVTS apvts { *this, nullptr, "Parameters", createParameterLayout() };
+    
+    // bytes of band buffers and DSP state this instance holds, valid after prepareToPlay or prepareStreams
+    size_t getDspMemoryFootprint() const { return engine.getDspMemoryFootprint(); }
+    
+    // what every instance in the process shares, and what they all hold between them
+    SharedDsp::Metrics getSharedDspMetrics() const { return engine.getSharedDspMetrics(); }
+    int getNumWorkerThreads() const { return engine.getNumWorkerThreads(); }
+    
+    /*
+     Offline rendering of many independent streams at once, next to processBlock. Every stream
+     has channelsPerStream channels and gets this instance's parameters, see
+     MultibandCompressor::prepareStreams(). The precision is the instance's, so call
+     setProcessingPrecision() first, as a host would. An instance either plays in a host or
+     renders streams, not both.
+     */
+    void prepareStreams(double sampleRate, int maximumBlockSize, int numStreams, int channelsPerStream);
+    
+    // in place, streams[stream][channel]. Any number of samples, it gets cut into maximumBlockSize blocks
+    void processStreams(float* const* const* streams, int numSamples);
+    void processStreams(double* const* const* streams, int numSamples);
+    
+    // the same for every stream, after prepareStreams or processStreams
+    int getStreamLatencySamples() const { return engine.getStreamLatencySamples(); }
 
 private:
-    std::array<CompressorBand, 3> compressors;
-    CompressorBand& lowBandComp = compressors[0];
-    CompressorBand& midBandComp = compressors[1];
-    CompressorBand& highBandComp = compressors[2];
+    // all of the DSP, this class only feeds it the parameters and the host's buses
+    MultibandCompressor engine;
+    
+    // the parameters' current values, as the engine takes them. Read once per block
+    MultibandCompressor::Parameters getEngineParameters() const;
     
-    using Filter = juce::dsp::LinkwitzRileyFilter<float>;
-    //      fc0     fc1
-    Filter  LP1,    AP2,
-            HP1,    LP2,
-                    HP2;
+    // the parameters that start or stop threads or allocate buffers can't take effect on the audio
+    // thread, so their changes get passed on to the engine's buildResources() from the message thread
+    void parameterChanged(const juce::String& parameterID, float newValue) override;
+    void handleAsyncUpdate() override;
     
-//    Filter invAP1, invAP2;
-//    juce::AudioBuffer<float> invAPBuffer; // only one buffer needed because both AP filters with different cutoffs will be in series
+    template<typename SampleType>
+    void processBlockImpl(juce::AudioBuffer<SampleType>& hostBuffer);
+    
+    struct BandParameterPointers
+    {
+        juce::AudioParameterFloat* attack {nullptr};
+        juce::AudioParameterFloat* release {nullptr};
+        juce::AudioParameterFloat* threshold {nullptr};
+        juce::AudioParameterChoice* ratio {nullptr};
+        juce::AudioParameterBool* bypass {nullptr};
+        juce::AudioParameterBool* mute {nullptr};
+        juce::AudioParameterBool* solo {nullptr};
+        juce::AudioParameterFloat* lookahead {nullptr};
+        juce::AudioParameterChoice* detector {nullptr};
+        juce::AudioParameterFloat* detectorWindow {nullptr};
+        juce::AudioParameterChoice* oversampling {nullptr};
+        juce::AudioParameterFloat* mix {nullptr};
+        
+        juce::AudioParameterFloat* sideAttack {nullptr};
+        juce::AudioParameterFloat* sideRelease {nullptr};
+        juce::AudioParameterFloat* sideThreshold {nullptr};
+        juce::AudioParameterChoice* sideRatio {nullptr};
+    };
+    
+    std::array<BandParameterPointers, 3> bandParams; // low, mid, high
+    juce::AudioParameterBool* linkChannels {nullptr};
     
     juce::AudioParameterFloat* lowMidCrossover {nullptr};
     juce::AudioParameterFloat* midHighCrossover {nullptr};
+    juce::AudioParameterChoice* crossoverSlope {nullptr};
     
-    std::array<juce::AudioBuffer<float>, 3> filterBuffers;
-    
-    juce::dsp::Gain<float> inputGain, outputGain;
     juce::AudioParameterFloat* inputGainParam {nullptr};
     juce::AudioParameterFloat* outputGainParam {nullptr};
     
-    template<typename T, typename U>
-    void applyGain(T& buffer, U& gain)
-    {
-        auto block = juce::dsp::AudioBlock<float> (buffer);
-        auto ctx = juce::dsp::ProcessContextReplacing<float> (block);
-        gain.process(ctx);
-    }
+    juce::AudioParameterBool* limiterParam {nullptr};
+    juce::AudioParameterFloat* limiterCeiling {nullptr};
+    juce::AudioParameterFloat* limiterRelease {nullptr};
+    
+    juce::AudioParameterFloat* mixParam {nullptr};
+    
+    // Stereo Mode: 0 = left/right, 1 = mid/side
+    juce::AudioParameterChoice* stereoMode {nullptr};
+    juce::AudioParameterBool* externalSidechain {nullptr};
+    
+    juce::AudioParameterChoice* linkBusSend {nullptr};
+    juce::AudioParameterChoice* linkBusReceive {nullptr};
+    
+    // Processing Mode: 0 = crossover, 1 = spectral. Spectral Bands: 16, 32 or 64
+    juce::AudioParameterChoice* processingMode {nullptr};
+    juce::AudioParameterChoice* spectralBands {nullptr};
     
-    void updateState();
-    void splitBands(const juce::AudioBuffer<float>& inputBuffer);
+    juce::AudioParameterChoice* decimatedBands {nullptr};
+    juce::AudioParameterChoice* offlineOversampling {nullptr};
+    juce::AudioParameterBool* offlineRenderQuality {nullptr};
+    juce::AudioParameterBool* parallelProcessing {nullptr};
     
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SimpleMBCompAudioProcessor)
@@ -0,0 +1,55 @@
+/*
+  ==============================================================================
+
+    Benchmark.cpp
+
+  ==============================================================================
+*/
+
+#include "Benchmark.h"
+
+namespace Benchmark
+{
+    double bestSeconds(const std::function<void()>& run)
+    {
+        auto best = std::numeric_limits<double>::max();
+
+        for(int i = 0; i < numRuns; ++i)
+        {
+            auto start = juce::Time::getMillisecondCounterHiRes();
+            run();
+            best = juce::jmin(best, (juce::Time::getMillisecondCounterHiRes() - start) * 0.001);
+        }
+
+        return best;
+    }
+
+    double realtimeFactor(double seconds, int numSamples, double sampleRate)
+    {
+        return numSamples / sampleRate / juce::jmax(seconds, 1.0e-9);
+    }
+
+    juce::String describe(double realtimeFactor)
+    {
+        return juce::String(realtimeFactor, 1) + "x realtime";
+    }
+
+    template<typename SampleType>
+    void process(MultibandCompressor& engine, std::vector<std::vector<SampleType>>& channels, int blockSize)
+    {
+        auto numChannels = static_cast<int>(channels.size());
+        auto numSamples = static_cast<int>(channels[0].size());
+        std::vector<SampleType*> pointers(channels.size());
+
+        for(int start = 0; start < numSamples; start += blockSize)
+        {
+            for(int ch = 0; ch < numChannels; ++ch)
+                pointers[static_cast<size_t>(ch)] = channels[static_cast<size_t>(ch)].data() + start;
+
+            engine.process(pointers.data(), numChannels, juce::jmin(blockSize, numSamples - start));
+        }
+    }
+
+    template void process<float>(MultibandCompressor&, std::vector<std::vector<float>>&, int);
+    template void process<double>(MultibandCompressor&, std::vector<std::vector<double>>&, int);
+}
@@ -0,0 +1,38 @@
+/*
+  ==============================================================================
+
+    Benchmark.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../Source/DSP/MultibandCompressor.h"
+
+/*
+ Timing for the "Benchmarks" category, which only runs when asked for:
+
+     SimpleMBCompTests --category Benchmarks
+
+ Every figure is the best of a few runs, so whatever else the machine was doing drops out,
+ and is given as how many times faster than realtime the audio went through.
+ */
+namespace Benchmark
+{
+    constexpr int numRuns = 5;
+
+    // the fastest of numRuns calls, in seconds
+    double bestSeconds(const std::function<void()>& run);
+
+    // audio seconds per second of processing
+    double realtimeFactor(double seconds, int numSamples, double sampleRate);
+
+    // "123.4x realtime"
+    juce::String describe(double realtimeFactor);
+
+    // a prepared engine over channels in place, blockSize samples at a time
+    template<typename SampleType>
+    void process(MultibandCompressor& engine, std::vector<std::vector<SampleType>>& channels, int blockSize);
+}
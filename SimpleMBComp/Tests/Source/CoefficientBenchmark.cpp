@@ -0,0 +1,177 @@
+/*
+  ==============================================================================
+
+    CoefficientBenchmark.cpp
+
+  ==============================================================================
+*/
+
+#include "Benchmark.h"
+#include "TestSignals.h"
+#include "ReferenceChain.h"
+#include "../../Source/DSP/Crossover.h"
+
+/*
+ The crossover's cached and ramped coefficients against splitBands() setting the cutoff on
+ its five filters every block. Stereo at 24 dB/oct, the only slope splitBands() had, with
+ the cutoffs held and with them moving every block, down to the short blocks where the
+ per block work counts most. The coefficients are only timed as part of the split, since
+ on their own the compiler is free to drop whatever nothing reads.
+ */
+class CoefficientBenchmark : public juce::UnitTest
+{
+public:
+    CoefficientBenchmark() : juce::UnitTest("Crossover coefficients", "Benchmarks") {}
+
+    void runTest() override
+    {
+        juce::ScopedNoDenormals noDenormals;
+
+        for(auto blockSize : { 16, 64, 512 })
+        {
+            beginTest("Split, " + juce::String(blockSize) + " sample blocks");
+
+            auto input = TestSignals::makeChannels<float>(TestSignals::Kind::noise, numChannels, numSamples, sampleRate, 42);
+
+            for(auto moving : { false, true })
+            {
+                auto crossover = measureCrossoverSplit(input, blockSize, moving);
+                auto reference = measureReferenceSplit(input, blockSize, moving);
+
+                logMessage(juce::String(moving ? "moving" : "held") + " cutoffs: " + Benchmark::describe(crossover)
+                           + " against " + Benchmark::describe(reference) + ", " + juce::String(crossover / reference, 2) + "x");
+            }
+        }
+    }
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int numSamples = 480000;
+    static constexpr int numChannels = 2;
+
+    // a slow sweep in whole Hz, as the parameters move, or the defaults
+    static std::pair<float, float> getCutoffs(int block, bool moving)
+    {
+        if( ! moving )
+            return { 400.f, 2000.f };
+
+        auto step = static_cast<float>(block % 1000);
+        return { 200.f + step, 2000.f + 4.f * step };
+    }
+
+    static juce::dsp::ProcessSpec makeSpec(int blockSize)
+    {
+        juce::dsp::ProcessSpec spec;
+        spec.sampleRate = sampleRate;
+        spec.maximumBlockSize = static_cast<juce::uint32>(blockSize);
+        spec.numChannels = static_cast<juce::uint32>(numChannels);
+        return spec;
+    }
+
+    // the last block of each band
+    static bool allFinite(const std::array<juce::AudioBuffer<float>, 3>& bands)
+    {
+        for(auto& band : bands)
+        {
+            for(int ch = 0; ch < band.getNumChannels(); ++ch)
+            {
+                for(int i = 0; i < band.getNumSamples(); ++i)
+                {
+                    if( ! std::isfinite(band.getReadPointer(ch)[i]) )
+                        return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    struct PreparedCrossover
+    {
+        explicit PreparedCrossover(int blockSize)
+        {
+            auto spec = makeSpec(blockSize);
+            arena.build([this, &spec](Arena& a) { crossover.allocate(a, spec); });
+            crossover.prepare(spec);
+            crossover.setInstructionSet(CpuDispatch::getInstructionSet());
+            crossover.setInputGainDecibels(0.f);
+        }
+
+        Arena arena;
+        Crossover<float> crossover;
+    };
+
+    double measureCrossoverSplit(const std::vector<std::vector<float>>& input, int blockSize, bool moving)
+    {
+        PreparedCrossover prepared(blockSize);
+
+        std::array<std::vector<float>, 3 * numChannels> bandChannels;
+
+        for(auto& channel : bandChannels)
+            channel.resize(static_cast<size_t>(blockSize));
+
+        std::array<std::array<float*, numChannels>, 3> bandPointers;
+        std::array<juce::AudioBuffer<float>, 3> bands;
+
+        for(size_t b = 0; b < bands.size(); ++b)
+        {
+            for(size_t ch = 0; ch < numChannels; ++ch)
+                bandPointers[b][ch] = bandChannels[b * numChannels + ch].data();
+
+            bands[b].setDataToReferTo(bandPointers[b].data(), numChannels, blockSize);
+        }
+
+        std::array<const float*, numChannels> inputPointers;
+
+        auto seconds = Benchmark::bestSeconds([&]
+        {
+            for(int start = 0, block = 0; start + blockSize <= numSamples; start += blockSize, ++block)
+            {
+                for(size_t ch = 0; ch < numChannels; ++ch)
+                    inputPointers[ch] = input[ch].data() + start;
+
+                auto cutoffs = getCutoffs(block, moving);
+                prepared.crossover.setCrossoverFrequencies(cutoffs.first, cutoffs.second);
+
+                juce::AudioBuffer<float> buffer(const_cast<float* const*>(inputPointers.data()), numChannels, blockSize);
+                prepared.crossover.process(buffer, bands);
+            }
+        });
+
+        expect(allFinite(bands));
+
+        return Benchmark::realtimeFactor(seconds, numSamples, sampleRate);
+    }
+
+    double measureReferenceSplit(const std::vector<std::vector<float>>& input, int blockSize, bool moving)
+    {
+        ReferenceChain<float> reference;
+        reference.prepare(sampleRate, blockSize, numChannels);
+
+        MultibandCompressor::Parameters parameters;
+        std::array<const float*, numChannels> inputPointers;
+        const std::array<juce::AudioBuffer<float>, 3>* bands = nullptr;
+
+        auto seconds = Benchmark::bestSeconds([&]
+        {
+            for(int start = 0, block = 0; start + blockSize <= numSamples; start += blockSize, ++block)
+            {
+                for(size_t ch = 0; ch < numChannels; ++ch)
+                    inputPointers[ch] = input[ch].data() + start;
+
+                auto cutoffs = getCutoffs(block, moving);
+                parameters.lowMidCrossover = cutoffs.first;
+                parameters.midHighCrossover = cutoffs.second;
+                reference.setParameters(parameters);
+
+                juce::AudioBuffer<float> buffer(const_cast<float* const*>(inputPointers.data()), numChannels, blockSize);
+                bands = &reference.split(buffer);
+            }
+        });
+
+        expect(allFinite(*bands));
+
+        return Benchmark::realtimeFactor(seconds, numSamples, sampleRate);
+    }
+};
+
+static CoefficientBenchmark coefficientBenchmark;
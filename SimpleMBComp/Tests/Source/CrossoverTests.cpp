@@ -0,0 +1,405 @@
+/*
+  ==============================================================================
+
+    CrossoverTests.cpp
+
+  ==============================================================================
+*/
+
+#include "TestSignals.h"
+#include "ReferenceChain.h"
+#include "../../Source/DSP/Crossover.h"
+
+/*
+ The crossover against splitBands(), on every instruction set, for the channel counts that
+ have kernels of their own and the generic ones in between, down to one sample blocks.
+ The reference runs in double on the same input, snapping to zero on the same blocks.
+ */
+class CrossoverTests : public juce::UnitTest
+{
+public:
+    CrossoverTests() : juce::UnitTest("Crossover", "DSP") {}
+
+    void runTest() override
+    {
+        beginTest("Bands match splitBands(), float");
+        matchesReference<float>(2.0e-6);
+
+        beginTest("Bands match splitBands(), double");
+        matchesReference<double>(1.0e-12);
+
+        beginTest("Bands sum flat, float");
+        sumsFlat<float>(1.0e-4);
+
+        beginTest("Bands sum flat, double");
+        sumsFlat<double>(1.0e-9);
+
+        beginTest("Linear phase bands sum to the delayed input, float");
+        linearPhaseSumsToInput<float>(1.0e-5);
+
+        beginTest("Linear phase bands sum to the delayed input, double");
+        linearPhaseSumsToInput<double>(1.0e-12);
+
+        beginTest("Linear phase bands are zero phase with the slope's magnitudes, float");
+        linearPhaseMatchesSlope<float>(1.0e-6, 1.0e-3);
+
+        beginTest("Linear phase bands are zero phase with the slope's magnitudes, double");
+        linearPhaseMatchesSlope<double>(1.0e-6, 1.0e-3);
+
+        beginTest("Moving cutoffs stay bounded");
+        movingCutoffsStayBounded<float>();
+        movingCutoffsStayBounded<double>();
+    }
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int maximumBlockSize = 512;
+
+    template<typename SampleType>
+    struct Fixture
+    {
+        Fixture(int numChannels, int blockSize, CpuDispatch::InstructionSet instructionSet)
+        {
+            spec.sampleRate = sampleRate;
+            spec.maximumBlockSize = static_cast<juce::uint32>(blockSize);
+            spec.numChannels = static_cast<juce::uint32>(numChannels);
+
+            arena.build([this](Arena& a) { crossover.allocate(a, spec); });
+            crossover.prepare(spec);
+            crossover.setInstructionSet(instructionSet);
+            crossover.setInputGainDecibels(0.f);
+            crossover.setCrossoverFrequencies(400.f, 2000.f);
+
+            for(auto& band : bands)
+                band.resize(static_cast<size_t>(numChannels));
+        }
+
+        // the whole signal through in blocks, the bands are kept channel by channel
+        void process(const std::vector<std::vector<SampleType>>& input, const std::vector<int>& blockSizes,
+                     std::function<void(int start, int numSamples)> beforeBlock = {})
+        {
+            auto numChannels = static_cast<int>(input.size());
+            auto numSamples = static_cast<int>(input[0].size());
+
+            for(auto& band : bands)
+            {
+                for(auto& channel : band)
+                    channel.assign(static_cast<size_t>(numSamples), SampleType(0));
+            }
+
+            std::vector<const SampleType*> inputPointers(input.size());
+            std::array<std::vector<SampleType*>, 3> bandPointers;
+            int start = 0;
+
+            for(auto blockSize : blockSizes)
+            {
+                if( beforeBlock )
+                    beforeBlock(start, blockSize);
+
+                for(int ch = 0; ch < numChannels; ++ch)
+                    inputPointers[static_cast<size_t>(ch)] = input[static_cast<size_t>(ch)].data() + start;
+
+                juce::AudioBuffer<SampleType> inputBuffer(const_cast<SampleType* const*>(inputPointers.data()), numChannels, blockSize);
+                std::array<juce::AudioBuffer<SampleType>, 3> bandBuffers;
+
+                for(size_t b = 0; b < bands.size(); ++b)
+                {
+                    bandPointers[b].clear();
+
+                    for(auto& channel : bands[b])
+                        bandPointers[b].push_back(channel.data() + start);
+
+                    bandBuffers[b].setDataToReferTo(bandPointers[b].data(), numChannels, blockSize);
+                }
+
+                crossover.process(inputBuffer, bandBuffers);
+                start += blockSize;
+            }
+        }
+
+        juce::dsp::ProcessSpec spec;
+        Arena arena;
+        Crossover<SampleType> crossover;
+        std::array<std::vector<std::vector<SampleType>>, 3> bands;
+    };
+
+    // splitBands() over the same blocks, in double
+    static std::array<std::vector<std::vector<double>>, 3> referenceBands(const std::vector<std::vector<double>>& input, const std::vector<int>& blockSizes,
+                                                                          float lowMidCutoff, float midHighCutoff)
+    {
+        auto numChannels = static_cast<int>(input.size());
+
+        ReferenceChain<double> reference;
+        reference.prepare(sampleRate, *std::max_element(blockSizes.begin(), blockSizes.end()), numChannels);
+
+        MultibandCompressor::Parameters parameters;
+        parameters.lowMidCrossover = lowMidCutoff;
+        parameters.midHighCrossover = midHighCutoff;
+        reference.setParameters(parameters);
+
+        std::array<std::vector<std::vector<double>>, 3> bands;
+        std::vector<double*> pointers(input.size());
+        auto block = input;
+        int start = 0;
+
+        for(auto& band : bands)
+            band.assign(input.size(), {});
+
+        for(auto blockSize : blockSizes)
+        {
+            for(int ch = 0; ch < numChannels; ++ch)
+                pointers[static_cast<size_t>(ch)] = block[static_cast<size_t>(ch)].data() + start;
+
+            juce::AudioBuffer<double> buffer(pointers.data(), numChannels, blockSize);
+            auto& filterBuffers = reference.split(buffer);
+
+            for(size_t b = 0; b < bands.size(); ++b)
+            {
+                for(int ch = 0; ch < numChannels; ++ch)
+                {
+                    auto* samples = filterBuffers[b].getReadPointer(ch);
+                    bands[b][static_cast<size_t>(ch)].insert(bands[b][static_cast<size_t>(ch)].end(), samples, samples + blockSize);
+                }
+            }
+
+            start += blockSize;
+        }
+
+        return bands;
+    }
+
+    template<typename SampleType>
+    static std::vector<std::vector<double>> toDouble(const std::vector<std::vector<SampleType>>& channels)
+    {
+        std::vector<std::vector<double>> result;
+
+        for(auto& channel : channels)
+            result.emplace_back(channel.begin(), channel.end());
+
+        return result;
+    }
+
+    template<typename SampleType>
+    void matchesReference(double maxAbsoluteError)
+    {
+        // 0.25 s covers several clicks and the sweep up to 20 kHz
+        auto numSamples = juce::roundToInt(0.25 * sampleRate);
+        auto worstError = 0.0;
+
+        for(auto instructionSet : TestSignals::getInstructionSets())
+        {
+            for(auto numChannels : { 1, 2, 3, 6, 8, 12, 16 })
+            {
+                for(auto blockSize : { 1, 64, maximumBlockSize, -maximumBlockSize })
+                {
+                    // a negative size is a ragged schedule of blocks up to that size
+                    auto blockSizes = TestSignals::makeBlockSizes(numSamples, std::abs(blockSize), blockSize < 0, numChannels);
+
+                    for(auto kind : TestSignals::allKinds)
+                    {
+                        auto input = TestSignals::makeChannels<SampleType>(kind, numChannels, numSamples, sampleRate, 1);
+
+                        Fixture<SampleType> fixture(numChannels, std::abs(blockSize), instructionSet);
+                        fixture.process(input, blockSizes);
+
+                        auto reference = referenceBands(toDouble(input), blockSizes, 400.f, 2000.f);
+                        auto what = juce::String(CpuDispatch::getName(instructionSet)) + ", " + juce::String(numChannels) + " channels, "
+                                  + juce::String(blockSize) + " sample blocks, " + TestSignals::getName(kind);
+
+                        for(size_t b = 0; b < 3; ++b)
+                        {
+                            expect(TestSignals::allFinite(fixture.bands[b]), "band " + juce::String(static_cast<int>(b)) + " isn't finite, " + what);
+
+                            auto error = TestSignals::maxError(fixture.bands[b], reference[b]);
+                            worstError = juce::jmax(worstError, error);
+                            expectLessOrEqual(error, maxAbsoluteError, "band " + juce::String(static_cast<int>(b)) + ", " + what);
+                        }
+                    }
+                }
+            }
+        }
+
+        logMessage("worst error " + juce::String(worstError));
+    }
+
+    // the summed bands' impulse response, as a magnitude in dB at bin k of n
+    static double magnitudeDecibels(const std::vector<double>& response, int k)
+    {
+        std::complex<double> sum = 0.0;
+        auto n = static_cast<double>(response.size());
+
+        for(size_t i = 0; i < response.size(); ++i)
+            sum += response[i] * std::polar(1.0, -juce::MathConstants<double>::twoPi * k * static_cast<double>(i) / n);
+
+        return 20.0 * std::log10(std::abs(sum));
+    }
+
+    template<typename SampleType>
+    void sumsFlat(double maxDeviationDecibels)
+    {
+        constexpr int numSamples = 4096;
+        constexpr int numChannels = 8;
+
+        for(auto instructionSet : TestSignals::getInstructionSets())
+        {
+            for(auto slope : { Crossover<SampleType>::Slope::lr12, Crossover<SampleType>::Slope::lr24, Crossover<SampleType>::Slope::lr48 })
+            {
+                Fixture<SampleType> fixture(numChannels, numSamples, instructionSet);
+                fixture.crossover.setSlope(slope);
+                fixture.crossover.setCrossoverFrequencies(300.f, 3000.f);
+
+                std::vector<std::vector<SampleType>> impulse(numChannels, std::vector<SampleType>(numSamples, SampleType(0)));
+
+                for(auto& channel : impulse)
+                    channel[0] = SampleType(1);
+
+                fixture.process(impulse, { numSamples });
+
+                for(int ch = 0; ch < numChannels; ++ch)
+                {
+                    std::vector<double> sum(numSamples, 0.0);
+
+                    for(auto& band : fixture.bands)
+                    {
+                        for(int i = 0; i < numSamples; ++i)
+                            sum[static_cast<size_t>(i)] += static_cast<double>(band[static_cast<size_t>(ch)][static_cast<size_t>(i)]);
+                    }
+
+                    auto deviation = 0.0;
+
+                    for(int k = 1; k < numSamples / 2; k += 5)
+                        deviation = juce::jmax(deviation, std::abs(magnitudeDecibels(sum, k)));
+
+                    expectLessOrEqual(deviation, maxDeviationDecibels, juce::String(CpuDispatch::getName(instructionSet))
+                                      + ", slope " + juce::String(static_cast<int>(slope)) + ", channel " + juce::String(ch));
+                }
+            }
+        }
+    }
+
+    template<typename SampleType>
+    void linearPhaseSumsToInput(double maxAbsoluteError)
+    {
+        auto numSamples = juce::roundToInt(0.25 * sampleRate);
+
+        for(auto instructionSet : TestSignals::getInstructionSets())
+        {
+            for(auto numChannels : { 1, 2, 6 })
+            {
+                for(auto kind : TestSignals::allKinds)
+                {
+                    Fixture<SampleType> fixture(numChannels, maximumBlockSize, instructionSet);
+
+                    fixture.crossover.swapLinearPhase(fixture.crossover.buildLinearPhase());
+                    fixture.crossover.setLinearPhase(true);
+                    expect(fixture.crossover.isLinearPhase());
+
+                    auto input = TestSignals::makeChannels<SampleType>(kind, numChannels, numSamples, sampleRate, 7);
+                    fixture.process(input, TestSignals::makeBlockSizes(numSamples, maximumBlockSize, true, numChannels));
+
+                    std::vector<std::vector<double>> sum(input.size(), std::vector<double>(input[0].size(), 0.0));
+
+                    for(auto& band : fixture.bands)
+                    {
+                        for(size_t ch = 0; ch < sum.size(); ++ch)
+                        {
+                            for(size_t i = 0; i < sum[ch].size(); ++i)
+                                sum[ch][i] += static_cast<double>(band[ch][i]);
+                        }
+                    }
+
+                    expectLessOrEqual(TestSignals::maxError(sum, input, fixture.crossover.getLatencySamples()), maxAbsoluteError,
+                                      juce::String(CpuDispatch::getName(instructionSet)) + ", " + juce::String(numChannels) + " channels, " + TestSignals::getName(kind));
+                }
+            }
+        }
+    }
+
+    // impulse responses, in ragged blocks so the partitions of the convolution fall anywhere in them.
+    // Symmetric about the latency, and the low band's magnitude is the IIR lowpass's
+    template<typename SampleType>
+    void linearPhaseMatchesSlope(double maxAsymmetry, double maxMagnitudeError)
+    {
+        using Slope = typename Crossover<SampleType>::Slope;
+
+        for(auto slope : { Slope::lr12, Slope::lr24, Slope::lr48 })
+        {
+            Fixture<SampleType> fixture(2, maximumBlockSize, CpuDispatch::InstructionSet::baseline);
+
+            fixture.crossover.swapLinearPhase(fixture.crossover.buildLinearPhase());
+            fixture.crossover.setSlope(slope);
+            fixture.crossover.setLinearPhase(true);
+
+            auto latency = fixture.crossover.getLatencySamples();
+            auto numSamples = 2 * latency + 2000;
+
+            // a different offset per channel, so each meets the partitions at another point
+            std::array<int, 2> impulses { 100, 1077 };
+            std::vector<std::vector<SampleType>> input(2, std::vector<SampleType>(static_cast<size_t>(numSamples), SampleType(0)));
+
+            for(size_t ch = 0; ch < impulses.size(); ++ch)
+                input[ch][static_cast<size_t>(impulses[ch])] = SampleType(1);
+
+            fixture.process(input, TestSignals::makeBlockSizes(numSamples, maximumBlockSize, true, 36));
+
+            auto order = slope == Slope::lr12 ? 2.0 : (slope == Slope::lr24 ? 4.0 : 8.0);
+            auto what = "slope " + juce::String(static_cast<int>(slope));
+
+            for(size_t ch = 0; ch < impulses.size(); ++ch)
+            {
+                auto centre = static_cast<size_t>(impulses[ch] + latency);
+                auto asymmetry = 0.0;
+
+                for(auto* band : { &fixture.bands[0][ch], &fixture.bands[2][ch] })
+                {
+                    for(size_t d = 1; d <= static_cast<size_t>(latency); ++d)
+                        asymmetry = juce::jmax(asymmetry, std::abs(static_cast<double>((*band)[centre + d] - (*band)[centre - d])));
+                }
+
+                expectLessOrEqual(asymmetry, maxAsymmetry, what);
+
+                for(auto frequency : { 50.0, 200.0, 400.0, 1000.0, 4000.0 })
+                {
+                    std::complex<double> response;
+
+                    for(size_t i = 0; i < fixture.bands[0][ch].size(); ++i)
+                        response += static_cast<double>(fixture.bands[0][ch][i]) * std::polar(1.0, -juce::MathConstants<double>::twoPi * frequency * static_cast<double>(i) / sampleRate);
+
+                    auto r = std::tan(juce::MathConstants<double>::pi * frequency / sampleRate) / std::tan(juce::MathConstants<double>::pi * 400.0 / sampleRate);
+                    auto expected = 1.0 / (1.0 + std::pow(r, order));
+
+                    expectLessOrEqual(std::abs(std::abs(response) - expected), maxMagnitudeError, what + ", " + juce::String(frequency) + " Hz");
+                }
+            }
+        }
+    }
+
+    // the cutoffs glide every block, across most of the range and back
+    template<typename SampleType>
+    void movingCutoffsStayBounded()
+    {
+        auto numSamples = juce::roundToInt(0.5 * sampleRate);
+
+        for(auto instructionSet : TestSignals::getInstructionSets())
+        {
+            Fixture<SampleType> fixture(2, maximumBlockSize, instructionSet);
+            auto input = TestSignals::makeChannels<SampleType>(TestSignals::Kind::noise, 2, numSamples, sampleRate, 3);
+
+            fixture.process(input, TestSignals::makeBlockSizes(numSamples, maximumBlockSize, true, 5), [&fixture, numSamples](int start, int)
+            {
+                auto position = std::sin(juce::MathConstants<double>::pi * start / numSamples);
+                auto lowMid = static_cast<float>(20.0 * std::pow(50.0, position));
+                fixture.crossover.setCrossoverFrequencies(lowMid, lowMid * 8.f);
+            });
+
+            for(auto& band : fixture.bands)
+            {
+                expect(TestSignals::allFinite(band), CpuDispatch::getName(instructionSet));
+
+                // an LR band peaks a little over its input, a coefficient glitch would be far louder
+                expectLessOrEqual(TestSignals::peak(band), 2.0 * TestSignals::peak(input), CpuDispatch::getName(instructionSet));
+            }
+        }
+    }
+};
+
+static CrossoverTests crossoverTests;
@@ -0,0 +1,80 @@
+/*
+  ==============================================================================
+
+    InstructionSetBenchmark.cpp
+
+  ==============================================================================
+*/
+
+#include "Benchmark.h"
+#include "TestSignals.h"
+
+/*
+ The engine on every instruction set the machine has, float and double, from mono up to
+ 16 channels, each against the baseline kernels. The override is set before prepare(),
+ where the engine picks its kernels, and cleared again straight after.
+ */
+class InstructionSetBenchmark : public juce::UnitTest
+{
+public:
+    InstructionSetBenchmark() : juce::UnitTest("Instruction sets", "Benchmarks") {}
+
+    void runTest() override
+    {
+        beginTest("float");
+        compare<float>();
+
+        beginTest("double");
+        compare<double>();
+    }
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int numSamples = 480000;
+    static constexpr int blockSize = 512;
+
+    template<typename SampleType>
+    void compare()
+    {
+        for(auto numChannels : { 1, 2, 6, 12, 16 })
+        {
+            auto input = TestSignals::makeChannels<SampleType>(TestSignals::Kind::noise, numChannels, numSamples, sampleRate, 43);
+            auto baseline = 0.0;
+
+            for(auto instructionSet : TestSignals::getInstructionSets())
+            {
+                auto speed = measure(input, instructionSet);
+
+                if( instructionSet == CpuDispatch::InstructionSet::baseline )
+                    baseline = speed;
+
+                logMessage(juce::String(numChannels) + (numChannels == 1 ? " channel, " : " channels, ") + CpuDispatch::getName(instructionSet)
+                           + ": " + Benchmark::describe(speed) + ", " + juce::String(speed / baseline, 2) + "x baseline");
+            }
+        }
+    }
+
+    template<typename SampleType>
+    double measure(std::vector<std::vector<SampleType>> channels, CpuDispatch::InstructionSet instructionSet)
+    {
+        MultibandCompressor::Parameters parameters;
+
+        for(auto& band : parameters.bands)
+            band.thresholdDecibels = -24.f;
+
+        CpuDispatch::setOverride(instructionSet);
+
+        MultibandCompressor engine;
+        engine.setParameters(parameters);
+        engine.prepare(sampleRate, blockSize, juce::AudioChannelSet::canonicalChannelSet(static_cast<int>(channels.size())), 0,
+                       std::is_same<SampleType, double>::value);
+
+        CpuDispatch::clearOverride();
+
+        auto seconds = Benchmark::bestSeconds([&] { Benchmark::process(engine, channels, blockSize); });
+        expect(TestSignals::allFinite(channels));
+
+        return Benchmark::realtimeFactor(seconds, numSamples, sampleRate);
+    }
+};
+
+static InstructionSetBenchmark instructionSetBenchmark;
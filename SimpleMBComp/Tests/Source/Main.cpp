@@ -0,0 +1,35 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+
+/*
+ Runs every test against the DSP in Source/DSP and exits non-zero if any failed.
+ --category <name> runs just that category, for anything slow that shouldn't run by default.
+ */
+int main(int argc, char* argv[])
+{
+    juce::String category = "DSP";
+
+    for(int i = 1; i + 1 < argc; ++i)
+    {
+        if( juce::String(argv[i]) == "--category" )
+            category = argv[i + 1];
+    }
+
+    juce::UnitTestRunner runner;
+    runner.setAssertOnFailure(false);
+    runner.runTestsInCategory(category);
+
+    int numFailures = 0;
+
+    for(int i = 0; i < runner.getNumResults(); ++i)
+        numFailures += runner.getResult(i)->failures;
+
+    return numFailures > 0 ? 1 : 0;
+}
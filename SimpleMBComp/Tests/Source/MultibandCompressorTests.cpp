@@ -0,0 +1,602 @@
+/*
+  ==============================================================================
+
+    MultibandCompressorTests.cpp
+
+  ==============================================================================
+*/
+
+#include "TestSignals.h"
+#include "ReferenceChain.h"
+
+/*
+ The whole engine. Where it does what the old chain did, it has to stay within the
+ crossover's rounding and the gain computer's tangent error of ReferenceChain. With the
+ compressors idle, the modes that resample have to put out the delayed reference's bands
+ through the same halfbands, and the linear phase crossover the delayed input. Every path,
+ on every instruction set, has to render bit for bit the same twice over, and the worker
+ pool, the instruction sets and processStreams() bit for bit what the plain serial engine does.
+ */
+class MultibandCompressorTests : public juce::UnitTest
+{
+public:
+    MultibandCompressorTests() : juce::UnitTest("MultibandCompressor", "DSP") {}
+
+    void runTest() override
+    {
+        beginTest("Matches the reference chain, float");
+        matchesReference<float>();
+
+        beginTest("Matches the reference chain, double");
+        matchesReference<double>();
+
+        beginTest("Resampling modes pass the input through when idle, float");
+        resamplingModesPassThrough<float>();
+
+        beginTest("Resampling modes pass the input through when idle, double");
+        resamplingModesPassThrough<double>();
+
+        beginTest("Repeated runs are bit exact, float");
+        repeatedRunsAreBitExact<float>();
+
+        beginTest("Repeated runs are bit exact, double");
+        repeatedRunsAreBitExact<double>();
+
+        beginTest("Worker pool matches serial processing");
+        workerPoolMatchesSerial<float>();
+        workerPoolMatchesSerial<double>();
+
+        beginTest("Instruction sets agree");
+        instructionSetsAgree<float>();
+        instructionSetsAgree<double>();
+
+        beginTest("Streams match separate instances");
+        streamsMatchSeparateInstances<float>();
+        streamsMatchSeparateInstances<double>();
+    }
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int maximumBlockSize = 512;
+
+    /*
+     With the oversamplers' halfbands applied to the reference too, what's left is rounding and
+     the decimators' passband ripple, -80 dB on each of the four passes down and back up. A band
+     out of line by a sample would be a few hundredths off at the low crossover alone.
+     */
+    static constexpr double maxResamplingError = 1.0e-3;
+
+    std::map<juce::String, double> worstErrors;
+
+    template<typename SampleType>
+    using Channels = std::vector<std::vector<SampleType>>;
+
+    struct Setup
+    {
+        MultibandCompressor::Parameters parameters;
+        CpuDispatch::InstructionSet instructionSet = CpuDispatch::InstructionSet::baseline;
+        bool nonRealtime = false;
+        int preparations = 1;
+        juce::String name;
+    };
+
+    // every band compressing, each differently
+    static MultibandCompressor::Parameters makeCompressing()
+    {
+        MultibandCompressor::Parameters parameters;
+        parameters.inputGainDecibels = 3.f;
+        parameters.outputGainDecibels = -2.f;
+
+        std::array<float, 3> thresholds { -30.f, -24.f, -18.f }, ratios { 2.f, 4.f, 8.f };
+        std::array<float, 3> attacks { 10.f, 5.f, 1.f }, releases { 250.f, 100.f, 50.f };
+
+        for(size_t i = 0; i < parameters.bands.size(); ++i)
+        {
+            parameters.bands[i].thresholdDecibels = thresholds[i];
+            parameters.bands[i].ratio = ratios[i];
+            parameters.bands[i].attackMs = attacks[i];
+            parameters.bands[i].releaseMs = releases[i];
+        }
+
+        return parameters;
+    }
+
+    // a fresh engine over the whole input, in the given blocks
+    template<typename SampleType>
+    static Channels<SampleType> render(const Setup& setup, Channels<SampleType> channels, const std::vector<int>& blockSizes, int* latencySamples = nullptr)
+    {
+        auto numChannels = static_cast<int>(channels.size());
+
+        // the engine picks its kernels in prepare()
+        CpuDispatch::setOverride(setup.instructionSet);
+
+        MultibandCompressor engine;
+        engine.setParameters(setup.parameters);
+        engine.setNonRealtime(setup.nonRealtime);
+
+        for(int i = 0; i < setup.preparations; ++i)
+            engine.prepare(sampleRate, maximumBlockSize, juce::AudioChannelSet::canonicalChannelSet(numChannels), 0, std::is_same<SampleType, double>::value);
+
+        std::vector<SampleType*> pointers(channels.size());
+        int start = 0;
+
+        for(auto blockSize : blockSizes)
+        {
+            for(int ch = 0; ch < numChannels; ++ch)
+                pointers[static_cast<size_t>(ch)] = channels[static_cast<size_t>(ch)].data() + start;
+
+            engine.process(pointers.data(), numChannels, blockSize);
+            start += blockSize;
+        }
+
+        if( latencySamples != nullptr )
+            *latencySamples = engine.getLatencySamples();
+
+        CpuDispatch::clearOverride();
+        return channels;
+    }
+
+    static Channels<double> renderReference(const MultibandCompressor::Parameters& parameters, Channels<double> channels, const std::vector<int>& blockSizes)
+    {
+        auto numChannels = static_cast<int>(channels.size());
+
+        ReferenceChain<double> reference;
+        reference.prepare(sampleRate, maximumBlockSize, numChannels);
+        reference.setParameters(parameters);
+
+        std::vector<double*> pointers(channels.size());
+        int start = 0;
+
+        for(auto blockSize : blockSizes)
+        {
+            for(int ch = 0; ch < numChannels; ++ch)
+                pointers[static_cast<size_t>(ch)] = channels[static_cast<size_t>(ch)].data() + start;
+
+            juce::AudioBuffer<double> buffer(pointers.data(), numChannels, blockSize);
+            reference.process(buffer);
+            start += blockSize;
+        }
+
+        return channels;
+    }
+
+    // the idle reference's bands as splitBands() leaves them. They sum to what the idle chain
+    // puts out once its gains have faded in
+    static std::array<Channels<double>, 3> splitReference(const Channels<double>& input, const std::vector<int>& blockSizes)
+    {
+        auto numChannels = static_cast<int>(input.size());
+
+        ReferenceChain<double> reference;
+        reference.prepare(sampleRate, maximumBlockSize, numChannels);
+        reference.setParameters(MultibandCompressor::Parameters());
+
+        std::array<Channels<double>, 3> bands;
+        bands.fill(Channels<double>(input.size(), std::vector<double>(input[0].size())));
+
+        std::vector<const double*> pointers(input.size());
+        int start = 0;
+
+        for(auto blockSize : blockSizes)
+        {
+            for(int ch = 0; ch < numChannels; ++ch)
+                pointers[static_cast<size_t>(ch)] = input[static_cast<size_t>(ch)].data() + start;
+
+            juce::AudioBuffer<double> buffer(const_cast<double* const*>(pointers.data()), numChannels, blockSize);
+            auto& split = reference.split(buffer);
+
+            for(size_t b = 0; b < bands.size(); ++b)
+            {
+                for(int ch = 0; ch < numChannels; ++ch)
+                    std::copy_n(split[b].getReadPointer(ch), blockSize, bands[b][static_cast<size_t>(ch)].data() + start);
+            }
+
+            start += blockSize;
+        }
+
+        return bands;
+    }
+
+    /*
+     Up and back down through the oversampler BandOversampler builds for this many stages, with
+     nothing in between: what the engine does to a band with its compressor idle. Comes out
+     delayed by the oversampler's latency, which is returned, so the halfbands' ringing ahead
+     of the signal is kept too.
+     */
+    static int roundTrip(Channels<double>& channels, int numStages, const std::vector<int>& blockSizes)
+    {
+        if( numStages == 0 )
+            return 0;
+
+        auto latency = 0;
+
+        for(auto& channel : channels)
+        {
+            juce::dsp::Oversampling<double> oversampling(1, static_cast<size_t>(numStages), juce::dsp::Oversampling<double>::filterHalfBandFIREquiripple, true, true);
+            oversampling.initProcessing(static_cast<size_t>(maximumBlockSize));
+            latency = juce::roundToInt(oversampling.getLatencyInSamples());
+
+            auto* data = channel.data();
+
+            for(auto blockSize : blockSizes)
+            {
+                juce::dsp::AudioBlock<double> block(&data, 1, static_cast<size_t>(blockSize));
+                oversampling.processSamplesUp(block);
+                oversampling.processSamplesDown(block);
+                data += blockSize;
+            }
+        }
+
+        return latency;
+    }
+
+    // the reference's bands, each through the oversampling its band runs at, lined up with the slowest
+    // like the engine lines them up, and summed. Returns the latency they were lined up at
+    static int resampleReference(const std::array<Channels<double>, 3>& bands, const std::array<int, 3>& oversamplingStages,
+                                 const std::vector<int>& blockSizes, Channels<double>& sum)
+    {
+        auto resampled = bands;
+        std::array<int, 3> latencies;
+
+        for(size_t b = 0; b < bands.size(); ++b)
+            latencies[b] = roundTrip(resampled[b], oversamplingStages[b], blockSizes);
+
+        auto latency = *std::max_element(latencies.begin(), latencies.end());
+        sum.assign(bands[0].size(), std::vector<double>(bands[0][0].size()));
+
+        for(size_t b = 0; b < bands.size(); ++b)
+        {
+            auto delay = static_cast<size_t>(latency - latencies[b]);
+
+            for(size_t ch = 0; ch < sum.size(); ++ch)
+            {
+                for(size_t i = delay; i < sum[ch].size(); ++i)
+                    sum[ch][i] += resampled[b][ch][i - delay];
+            }
+        }
+
+        return latency;
+    }
+
+    template<typename SampleType>
+    static Channels<double> toDouble(const Channels<SampleType>& channels)
+    {
+        Channels<double> result;
+
+        for(auto& channel : channels)
+            result.emplace_back(channel.begin(), channel.end());
+
+        return result;
+    }
+
+    template<typename SampleType>
+    void matchesReference()
+    {
+        auto numSamples = juce::roundToInt(0.5 * sampleRate);
+
+        /*
+         The tangent can compress each band up to about 1% more than the curve at ratio 8,
+         and the bands sum, so the error is held to 1% of the loudest band sum the reference
+         puts out, with room for the three bands to err the same way at once.
+         */
+        constexpr double maxRelativeError = 0.03;
+        auto worstRelativeError = 0.0;
+
+        for(auto instructionSet : TestSignals::getInstructionSets())
+        {
+            for(auto numChannels : { 1, 2, 6, 16 })
+            {
+                for(auto ragged : { false, true })
+                {
+                    auto blockSizes = TestSignals::makeBlockSizes(numSamples, maximumBlockSize, ragged, numChannels);
+
+                    for(auto kind : TestSignals::allKinds)
+                    {
+                        Setup setup;
+                        setup.parameters = makeCompressing();
+                        setup.instructionSet = instructionSet;
+
+                        auto input = TestSignals::makeChannels<SampleType>(kind, numChannels, numSamples, sampleRate, 21);
+                        auto output = render(setup, input, blockSizes);
+                        auto reference = renderReference(setup.parameters, toDouble(input), blockSizes);
+
+                        auto what = juce::String(CpuDispatch::getName(instructionSet)) + ", " + juce::String(numChannels) + " channels, "
+                                  + (ragged ? "ragged blocks, " : "full blocks, ") + TestSignals::getName(kind);
+
+                        expect(TestSignals::allFinite(output), "not finite, " + what);
+
+                        auto level = TestSignals::peak(reference);
+                        auto error = TestSignals::maxError(output, reference);
+
+                        if( level > 0.0 )
+                        {
+                            worstRelativeError = juce::jmax(worstRelativeError, error / level);
+                            expectLessOrEqual(error, maxRelativeError * level, what);
+                        }
+                        else
+                        {
+                            expectEquals(error, 0.0, "silence in, silence out, " + what);
+                        }
+                    }
+                }
+            }
+        }
+
+        logMessage("worst error " + juce::String(worstRelativeError) + " of the reference's peak");
+    }
+
+    /*
+     What the engine puts out with its compressors idle, against what it should: the idle reference
+     chain's bands for the minimum phase modes, the input itself for the linear phase one, either through
+     the same oversampling. The engine's output is delayed by its latency, the expected output by
+     expectedLatency, so they get lined up first.
+     */
+    template<typename SampleType>
+    void expectsDelayed(const Setup& setup, const Channels<SampleType>& input, const Channels<double>& expected, int expectedLatency,
+                        const std::vector<int>& blockSizes, double maxAbsoluteError, const juce::String& what)
+    {
+        int latencySamples = 0;
+        auto output = render(setup, input, blockSizes, &latencySamples);
+        auto error = TestSignals::maxError(output, expected, latencySamples - expectedLatency);
+
+        expect(TestSignals::allFinite(output), "not finite, " + what);
+        expectLessOrEqual(error, maxAbsoluteError, what);
+        worstErrors[setup.name] = juce::jmax(worstErrors[setup.name], error);
+    }
+
+    template<typename SampleType>
+    void resamplingModesPassThrough()
+    {
+        auto numSamples = juce::roundToInt(0.5 * sampleRate);
+        worstErrors.clear();
+
+        for(auto instructionSet : TestSignals::getInstructionSets())
+        {
+            for(auto numChannels : { 1, 2, 6 })
+            {
+                auto blockSizes = TestSignals::makeBlockSizes(numSamples, maximumBlockSize, true, numChannels);
+
+                for(auto kind : TestSignals::allKinds)
+                {
+                    auto input = TestSignals::makeChannels<SampleType>(kind, numChannels, numSamples, sampleRate, 31);
+
+                    // nothing reaches a 0 dB threshold, so the reference is the split's bands summed
+                    MultibandCompressor::Parameters idle;
+                    auto bands = splitReference(toDouble(input), blockSizes);
+
+                    // prepared twice, so the gains don't fade in the way they do after the first prepare():
+                    // the input gain's ramp and the output gain's would be the latency apart
+                    Setup setup;
+                    setup.instructionSet = instructionSet;
+                    setup.preparations = 2;
+
+                    auto what = [&setup, numChannels, kind]
+                    {
+                        return setup.name + ", " + CpuDispatch::getName(setup.instructionSet) + ", " + juce::String(numChannels) + " channels, " + TestSignals::getName(kind);
+                    };
+
+                    // the bands the decimators take down have nothing left near their passband's edge
+                    Channels<double> reference;
+                    auto latency = resampleReference(bands, { 0, 0, 0 }, blockSizes, reference);
+
+                    for(auto decimatedBands : { 1, 2 })
+                    {
+                        setup.name = "decimated bands " + juce::String(decimatedBands);
+                        setup.parameters = idle;
+                        setup.parameters.decimatedBands = decimatedBands;
+                        expectsDelayed(setup, input, reference, latency, blockSizes, maxResamplingError, what());
+                    }
+
+                    setup.name = "oversampled bands";
+                    setup.parameters = idle;
+                    setup.parameters.bands[0].oversampling = 1;
+                    setup.parameters.bands[2].oversampling = 2;
+                    latency = resampleReference(bands, { 1, 0, 2 }, blockSizes, reference);
+                    expectsDelayed(setup, input, reference, latency, blockSizes, maxResamplingError, what());
+
+                    // the linear phase bands sum back to the input itself, and render quality runs every band at 4x
+                    setup.name = "offline render quality";
+                    setup.parameters = idle;
+                    setup.parameters.offlineRenderQuality = true;
+                    setup.nonRealtime = true;
+                    reference = toDouble(input);
+                    latency = roundTrip(reference, 2, blockSizes);
+                    expectsDelayed(setup, input, reference, latency, blockSizes, maxResamplingError, what());
+                }
+            }
+        }
+
+        for(auto& worst : worstErrors)
+            logMessage(worst.first + ": worst error " + juce::String(worst.second));
+    }
+
+    // one of each of the optimised paths, on top of compressing bands
+    static std::vector<Setup> makeVariants(int numChannels)
+    {
+        std::vector<Setup> variants;
+
+        auto add = [&variants](const juce::String& name, std::function<void(Setup&)> change)
+        {
+            Setup setup;
+            setup.name = name;
+            setup.parameters = makeCompressing();
+            change(setup);
+            variants.push_back(setup);
+        };
+
+        add("compressing", [](Setup&) {});
+        add("parallel processing", [](Setup& s) { s.parameters.parallelProcessing = true; });
+        add("detectors and resampling", [](Setup& s)
+        {
+            s.parameters.decimatedBands = 2;
+            s.parameters.bands[0].detector = 2;
+            s.parameters.bands[1].oversampling = 1;
+            s.parameters.bands[2].detector = 1;
+        });
+        add("linked lookahead and limiter", [](Setup& s)
+        {
+            s.parameters.linkChannels = true;
+            s.parameters.limiter = true;
+
+            for(auto& band : s.parameters.bands)
+                band.lookaheadMs = 5.f;
+        });
+        add("mix and slopes", [](Setup& s)
+        {
+            s.parameters.crossoverSlope = 2;
+            s.parameters.mix = 70.f;
+            s.parameters.bands[1].mix = 50.f;
+        });
+        add("offline render quality", [](Setup& s)
+        {
+            s.parameters.offlineRenderQuality = true;
+            s.nonRealtime = true;
+        });
+        add("spectral", [](Setup& s) { s.parameters.spectral = true; });
+
+        if( numChannels == 2 )
+            add("mid/side", [](Setup& s) { s.parameters.midSide = true; });
+
+        return variants;
+    }
+
+    template<typename SampleType>
+    void repeatedRunsAreBitExact()
+    {
+        auto numSamples = juce::roundToInt(0.5 * sampleRate);
+
+        for(auto instructionSet : TestSignals::getInstructionSets())
+        {
+            for(auto numChannels : { 2, 6, 16 })
+            {
+                // a different kind of signal on every channel
+                Channels<SampleType> input;
+
+                for(int ch = 0; ch < numChannels; ++ch)
+                    input.push_back(TestSignals::make<SampleType>(TestSignals::allKinds[static_cast<size_t>(ch) % TestSignals::allKinds.size()], numSamples, sampleRate, 41 + ch));
+
+                auto blockSizes = TestSignals::makeBlockSizes(numSamples, maximumBlockSize, true, numChannels);
+
+                for(auto setup : makeVariants(numChannels))
+                {
+                    setup.instructionSet = instructionSet;
+
+                    auto first = render(setup, input, blockSizes);
+                    auto second = render(setup, input, blockSizes);
+
+                    auto what = setup.name + ", " + juce::String(CpuDispatch::getName(instructionSet)) + ", " + juce::String(numChannels) + " channels";
+
+                    expect(TestSignals::allFinite(first), "not finite, " + what);
+                    expect(TestSignals::areIdentical(first, second), what);
+                }
+            }
+        }
+    }
+
+    template<typename SampleType>
+    void workerPoolMatchesSerial()
+    {
+        auto numSamples = juce::roundToInt(0.5 * sampleRate);
+
+        for(auto numChannels : { 6, 16 })
+        {
+            auto input = TestSignals::makeChannels<SampleType>(TestSignals::Kind::noise, numChannels, numSamples, sampleRate, 51);
+            auto blockSizes = TestSignals::makeBlockSizes(numSamples, maximumBlockSize, true, numChannels);
+
+            for(auto linked : { false, true })
+            {
+                Setup serial;
+                serial.parameters = makeCompressing();
+                serial.parameters.linkChannels = linked;
+
+                auto parallel = serial;
+                parallel.parameters.parallelProcessing = true;
+
+                expect(TestSignals::areIdentical(render(serial, input, blockSizes), render(parallel, input, blockSizes)),
+                       juce::String(numChannels) + " channels" + (linked ? ", linked" : ""));
+            }
+        }
+    }
+
+    // the wider kernels run the same arithmetic in the same order, only more lanes at once. That only
+    // holds bit for bit with Source/DSP built without contraction, see CpuDispatch.h
+    template<typename SampleType>
+    void instructionSetsAgree()
+    {
+        auto numSamples = juce::roundToInt(0.5 * sampleRate);
+
+        for(auto numChannels : { 1, 2, 3, 6, 8, 16 })
+        {
+            auto input = TestSignals::makeChannels<SampleType>(TestSignals::Kind::sweep, numChannels, numSamples, sampleRate, 61);
+            auto blockSizes = TestSignals::makeBlockSizes(numSamples, maximumBlockSize, true, numChannels);
+
+            Setup baseline;
+            baseline.parameters = makeCompressing();
+            auto expected = render(baseline, input, blockSizes);
+
+            for(auto instructionSet : TestSignals::getInstructionSets())
+            {
+                auto setup = baseline;
+                setup.instructionSet = instructionSet;
+
+                expect(TestSignals::areIdentical(render(setup, input, blockSizes), expected),
+                       juce::String(CpuDispatch::getName(instructionSet)) + ", " + juce::String(numChannels) + " channels");
+            }
+        }
+    }
+
+    // a stream is a lane of the batch's kernels where a lone instance has the scalar ones, so this
+    // is exact for the same reason the instruction sets agree
+    template<typename SampleType>
+    void streamsMatchSeparateInstances()
+    {
+        auto numSamples = juce::roundToInt(0.5 * sampleRate);
+        auto useDoublePrecision = std::is_same<SampleType, double>::value;
+
+        for(auto channelsPerStream : { 1, 2, 6 })
+        {
+            constexpr int numStreams = 5;
+            std::vector<Channels<SampleType>> streams;
+
+            for(int s = 0; s < numStreams; ++s)
+                streams.push_back(TestSignals::makeChannels<SampleType>(TestSignals::allKinds[static_cast<size_t>(s)], channelsPerStream, numSamples, sampleRate, 71 + s));
+
+            auto parameters = makeCompressing();
+            parameters.limiter = true;
+
+            MultibandCompressor engine;
+            engine.setParameters(parameters);
+            engine.prepareStreams(sampleRate, maximumBlockSize, numStreams, channelsPerStream, useDoublePrecision);
+
+            auto rendered = streams;
+            std::vector<std::vector<SampleType*>> channelPointers;
+            std::vector<SampleType* const*> streamPointers;
+
+            for(auto& stream : rendered)
+            {
+                channelPointers.emplace_back();
+
+                for(auto& channel : stream)
+                    channelPointers.back().push_back(channel.data());
+            }
+
+            for(auto& pointers : channelPointers)
+                streamPointers.push_back(pointers.data());
+
+            engine.processStreams(streamPointers.data(), numSamples);
+
+            for(int s = 0; s < numStreams; ++s)
+            {
+                Setup single;
+                single.parameters = parameters;
+
+                int latencySamples = 0;
+                auto expected = render(single, streams[static_cast<size_t>(s)], TestSignals::makeBlockSizes(numSamples, maximumBlockSize, false, 0), &latencySamples);
+                auto what = juce::String(channelsPerStream) + " channels per stream, stream " + juce::String(s);
+
+                expectEquals(engine.getStreamLatencySamples(), latencySamples, what);
+                expect(TestSignals::areIdentical(rendered[static_cast<size_t>(s)], expected), what);
+            }
+        }
+    }
+};
+
+static MultibandCompressorTests multibandCompressorTests;
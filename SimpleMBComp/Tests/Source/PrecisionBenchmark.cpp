@@ -0,0 +1,101 @@
+/*
+  ==============================================================================
+
+    PrecisionBenchmark.cpp
+
+  ==============================================================================
+*/
+
+#include "Benchmark.h"
+#include "TestSignals.h"
+
+/*
+ The float and double engines side by side, and the double bus the way it went before the
+ double path: converted to float, processed, converted back.
+ */
+class PrecisionBenchmark : public juce::UnitTest
+{
+public:
+    PrecisionBenchmark() : juce::UnitTest("Float and double", "Benchmarks") {}
+
+    void runTest() override
+    {
+        for(auto numChannels : { 1, 2, 6, 12 })
+        {
+            beginTest(juce::String(numChannels) + " channels at 48 kHz, " + juce::String(blockSize) + " sample blocks");
+
+            auto floatInput = TestSignals::makeChannels<float>(TestSignals::Kind::noise, numChannels, numSamples, sampleRate, 29);
+            auto doubleInput = TestSignals::makeChannels<double>(TestSignals::Kind::noise, numChannels, numSamples, sampleRate, 29);
+
+            logMessage("float: " + Benchmark::describe(measure(floatInput, nullptr)));
+            logMessage("double: " + Benchmark::describe(measure(doubleInput, nullptr)));
+
+            std::vector<std::vector<float>> converted(floatInput.size(), std::vector<float>(static_cast<size_t>(numSamples)));
+            logMessage("double through float: " + Benchmark::describe(measure(doubleInput, &converted)));
+        }
+    }
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int numSamples = 480000;
+    static constexpr int blockSize = 512;
+
+    static MultibandCompressor::Parameters makeParameters()
+    {
+        MultibandCompressor::Parameters parameters;
+
+        for(auto& band : parameters.bands)
+            band.thresholdDecibels = -24.f;
+
+        return parameters;
+    }
+
+    // converted != nullptr runs a double bus through the float engine, block by block, as the host used to
+    template<typename SampleType>
+    double measure(std::vector<std::vector<SampleType>> channels, std::vector<std::vector<float>>* converted)
+    {
+        auto numChannels = static_cast<int>(channels.size());
+        auto processInFloat = converted != nullptr;
+
+        MultibandCompressor engine;
+        engine.setParameters(makeParameters());
+        engine.prepare(sampleRate, blockSize, juce::AudioChannelSet::canonicalChannelSet(numChannels), 0,
+                       std::is_same<SampleType, double>::value && ! processInFloat);
+
+        auto seconds = Benchmark::bestSeconds([&]
+        {
+            if( ! processInFloat )
+            {
+                Benchmark::process(engine, channels, blockSize);
+                return;
+            }
+
+            std::vector<float*> pointers(channels.size());
+
+            for(int start = 0; start < numSamples; start += blockSize)
+            {
+                auto length = juce::jmin(blockSize, numSamples - start);
+
+                for(size_t ch = 0; ch < channels.size(); ++ch)
+                {
+                    pointers[ch] = (*converted)[ch].data() + start;
+
+                    for(int i = 0; i < length; ++i)
+                        pointers[ch][i] = static_cast<float>(channels[ch][static_cast<size_t>(start + i)]);
+                }
+
+                engine.process(pointers.data(), numChannels, length);
+
+                for(size_t ch = 0; ch < channels.size(); ++ch)
+                {
+                    for(int i = 0; i < length; ++i)
+                        channels[ch][static_cast<size_t>(start + i)] = pointers[ch][i];
+                }
+            }
+        });
+
+        expect(TestSignals::allFinite(channels));
+        return Benchmark::realtimeFactor(seconds, numSamples, sampleRate);
+    }
+};
+
+static PrecisionBenchmark precisionBenchmark;
@@ -0,0 +1,158 @@
+/*
+  ==============================================================================
+
+    ReferenceChain.cpp
+
+  ==============================================================================
+*/
+
+#include "ReferenceChain.h"
+
+template<typename SampleType>
+void ReferenceChain<SampleType>::prepare(double sampleRate, int maximumBlockSize, int numChannels)
+{
+    juce::dsp::ProcessSpec spec;
+    spec.maximumBlockSize = static_cast<juce::uint32>(maximumBlockSize);
+    spec.numChannels = static_cast<juce::uint32>(numChannels);
+    spec.sampleRate = sampleRate;
+
+    for(auto& compressor : compressors)
+        compressor.prepare(spec);
+
+    LP1.setType(juce::dsp::LinkwitzRileyFilterType::lowpass);
+    HP1.setType(juce::dsp::LinkwitzRileyFilterType::highpass);
+    AP2.setType(juce::dsp::LinkwitzRileyFilterType::allpass);
+    LP2.setType(juce::dsp::LinkwitzRileyFilterType::lowpass);
+    HP2.setType(juce::dsp::LinkwitzRileyFilterType::highpass);
+
+    for(auto* filter : { &LP1, &HP1, &AP2, &LP2, &HP2 })
+        filter->prepare(spec);
+
+    inputGain.prepare(spec);
+    outputGain.prepare(spec);
+
+    inputGain.setRampDurationSeconds(0.05); // 50ms
+    outputGain.setRampDurationSeconds(0.05); // 50ms
+
+    for(auto& buffer : filterBuffers)
+        buffer.setSize(numChannels, maximumBlockSize);
+}
+
+template<typename SampleType>
+void ReferenceChain<SampleType>::updateState()
+{
+    for(size_t i = 0; i < compressors.size(); ++i)
+    {
+        auto& band = parameters.bands[i];
+        compressors[i].setAttack(static_cast<SampleType>(band.attackMs));
+        compressors[i].setRelease(static_cast<SampleType>(band.releaseMs));
+        compressors[i].setThreshold(static_cast<SampleType>(band.thresholdDecibels));
+        compressors[i].setRatio(static_cast<SampleType>(band.ratio));
+    }
+
+    auto lowMidCutoffFreq = static_cast<SampleType>(parameters.lowMidCrossover);
+    LP1.setCutoffFrequency(lowMidCutoffFreq);
+    HP1.setCutoffFrequency(lowMidCutoffFreq);
+
+    auto midHighCutoffFreq = static_cast<SampleType>(parameters.midHighCrossover);
+    AP2.setCutoffFrequency(midHighCutoffFreq);
+    LP2.setCutoffFrequency(midHighCutoffFreq);
+    HP2.setCutoffFrequency(midHighCutoffFreq);
+
+    inputGain.setGainDecibels(static_cast<SampleType>(parameters.inputGainDecibels));
+    outputGain.setGainDecibels(static_cast<SampleType>(parameters.outputGainDecibels));
+}
+
+template<typename SampleType>
+void ReferenceChain<SampleType>::splitBands(const juce::AudioBuffer<SampleType>& inputBuffer)
+{
+    auto numChannels = inputBuffer.getNumChannels();
+    auto numSamples = inputBuffer.getNumSamples();
+
+    // the plugin copied the buffer over with operator=, this is the same without reallocating
+    for(auto& fb : filterBuffers)
+    {
+        fb.setSize(numChannels, numSamples, false, false, true);
+
+        for(int ch = 0; ch < numChannels; ++ch)
+            fb.copyFrom(ch, 0, inputBuffer, ch, 0, numSamples);
+    }
+
+    auto fb0Block = juce::dsp::AudioBlock<SampleType>(filterBuffers[0]);
+    auto fb1Block = juce::dsp::AudioBlock<SampleType>(filterBuffers[1]);
+    auto fb2Block = juce::dsp::AudioBlock<SampleType>(filterBuffers[2]);
+
+    auto fb0Ctx = juce::dsp::ProcessContextReplacing<SampleType>(fb0Block);
+    auto fb1Ctx = juce::dsp::ProcessContextReplacing<SampleType>(fb1Block);
+    auto fb2Ctx = juce::dsp::ProcessContextReplacing<SampleType>(fb2Block);
+
+    LP1.process(fb0Ctx);
+    AP2.process(fb0Ctx);
+
+    HP1.process(fb1Ctx);
+
+    for(int ch = 0; ch < numChannels; ++ch)
+        filterBuffers[2].copyFrom(ch, 0, filterBuffers[1], ch, 0, numSamples);
+
+    LP2.process(fb1Ctx);
+
+    HP2.process(fb2Ctx);
+}
+
+template<typename SampleType>
+const std::array<juce::AudioBuffer<SampleType>, 3>& ReferenceChain<SampleType>::split(const juce::AudioBuffer<SampleType>& buffer)
+{
+    updateState();
+    splitBands(buffer);
+    return filterBuffers;
+}
+
+template<typename SampleType>
+void ReferenceChain<SampleType>::process(juce::AudioBuffer<SampleType>& buffer)
+{
+    updateState();
+
+    auto applyGain = [](juce::AudioBuffer<SampleType>& b, juce::dsp::Gain<SampleType>& gain)
+    {
+        auto block = juce::dsp::AudioBlock<SampleType>(b);
+        auto ctx = juce::dsp::ProcessContextReplacing<SampleType>(block);
+        gain.process(ctx);
+    };
+
+    applyGain(buffer, inputGain);
+
+    splitBands(buffer);
+
+    for(size_t i = 0; i < filterBuffers.size(); ++i)
+    {
+        auto block = juce::dsp::AudioBlock<SampleType>(filterBuffers[i]);
+        auto context = juce::dsp::ProcessContextReplacing<SampleType>(block);
+
+        context.isBypassed = parameters.bands[i].bypass;
+
+        compressors[i].process(context);
+    }
+
+    auto numSamples = buffer.getNumSamples();
+    auto numChannels = buffer.getNumChannels();
+
+    buffer.clear();
+
+    auto bandsAreSoloed = std::any_of(parameters.bands.begin(), parameters.bands.end(), [](const BandParameters& band) { return band.solo; });
+
+    for(size_t i = 0; i < filterBuffers.size(); ++i)
+    {
+        auto& band = parameters.bands[i];
+
+        if( bandsAreSoloed ? ! band.solo : band.mute )
+            continue;
+
+        for(int ch = 0; ch < numChannels; ++ch)
+            buffer.addFrom(ch, 0, filterBuffers[i], ch, 0, numSamples);
+    }
+
+    applyGain(buffer, outputGain);
+}
+
+template struct ReferenceChain<float>;
+template struct ReferenceChain<double>;
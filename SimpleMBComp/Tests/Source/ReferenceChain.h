@@ -0,0 +1,48 @@
+/*
+  ==============================================================================
+
+    ReferenceChain.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../Source/DSP/MultibandCompressor.h"
+
+/*
+ The plugin's signal path as it was before any of the optimised DSP, kept as the reference
+ the rest is held against: the input gain, splitBands() through five juce::dsp::LinkwitzRileyFilters,
+ one juce::dsp::Compressor per band the way CompressorBand wrapped it, the band sum with mute
+ and solo, and the output gain.
+
+ It only knows the settings that chain had: the crossover frequencies at 24 dB/oct, each band's
+ attack, release, threshold, ratio, bypass, mute and solo, and the two gains. Every block is
+ processed exactly as processBlock() did, so the filters snap to zero at the same points.
+ */
+template<typename SampleType>
+struct ReferenceChain
+{
+    void prepare(double sampleRate, int maximumBlockSize, int numChannels);
+
+    // read at the start of every block, like updateState() read the plugin's parameters
+    void setParameters(const MultibandCompressor::Parameters& newParameters) { parameters = newParameters; }
+
+    // in place, up to maximumBlockSize samples
+    void process(juce::AudioBuffer<SampleType>& buffer);
+
+    // the bands as splitBands() left them, without the gains or compressors
+    const std::array<juce::AudioBuffer<SampleType>, 3>& split(const juce::AudioBuffer<SampleType>& buffer);
+private:
+    void updateState();
+    void splitBands(const juce::AudioBuffer<SampleType>& inputBuffer);
+
+    MultibandCompressor::Parameters parameters;
+
+    juce::dsp::LinkwitzRileyFilter<SampleType> LP1, HP1, AP2, LP2, HP2;
+    std::array<juce::dsp::Compressor<SampleType>, 3> compressors;
+    juce::dsp::Gain<SampleType> inputGain, outputGain;
+
+    std::array<juce::AudioBuffer<SampleType>, 3> filterBuffers;
+};
@@ -0,0 +1,124 @@
+/*
+  ==============================================================================
+
+    StreamsBenchmark.cpp
+
+  ==============================================================================
+*/
+
+#include "Benchmark.h"
+#include "TestSignals.h"
+
+/*
+ processStreams() against one engine per stream, the way a render server would otherwise
+ run them, for mono and stereo streams with and without the limiter. Given as streams per
+ core: how many of them one thread keeps up with in realtime.
+ */
+class StreamsBenchmark : public juce::UnitTest
+{
+public:
+    StreamsBenchmark() : juce::UnitTest("Streams", "Benchmarks") {}
+
+    void runTest() override
+    {
+        for(auto channelsPerStream : { 1, 2 })
+        {
+            for(auto limiter : { false, true })
+            {
+                beginTest(juce::String(channelsPerStream == 1 ? "Mono" : "Stereo") + (limiter ? " streams, limiter on" : " streams"));
+
+                for(auto numStreams : { 16, 64 })
+                {
+                    std::vector<std::vector<std::vector<float>>> streams;
+
+                    for(int s = 0; s < numStreams; ++s)
+                        streams.push_back(TestSignals::makeChannels<float>(TestSignals::Kind::noise, channelsPerStream, numSamples, sampleRate, 48 + s));
+
+                    auto batched = measureBatched(streams, limiter);
+                    auto separate = measureSeparate(streams, limiter);
+
+                    logMessage(juce::String(numStreams) + " streams: " + juce::String(batched, 1) + " per core against "
+                               + juce::String(separate, 1) + " as separate instances, " + juce::String(batched / separate, 2) + "x");
+                }
+            }
+        }
+    }
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int numSamples = 96000;
+    static constexpr int blockSize = 512;
+
+    using Streams = std::vector<std::vector<std::vector<float>>>;
+
+    static MultibandCompressor::Parameters makeParameters(bool limiter)
+    {
+        MultibandCompressor::Parameters parameters;
+        parameters.limiter = limiter;
+
+        for(auto& band : parameters.bands)
+            band.thresholdDecibels = -24.f;
+
+        return parameters;
+    }
+
+    static double streamsPerCore(double seconds, int numStreams)
+    {
+        return numStreams * Benchmark::realtimeFactor(seconds, numSamples, sampleRate);
+    }
+
+    double measureBatched(Streams streams, bool limiter)
+    {
+        auto numStreams = static_cast<int>(streams.size());
+
+        MultibandCompressor engine;
+        engine.setParameters(makeParameters(limiter));
+        engine.prepareStreams(sampleRate, blockSize, numStreams, static_cast<int>(streams[0].size()));
+
+        std::vector<std::vector<float*>> channelPointers;
+        std::vector<float* const*> streamPointers;
+
+        for(auto& stream : streams)
+        {
+            channelPointers.emplace_back();
+
+            for(auto& channel : stream)
+                channelPointers.back().push_back(channel.data());
+        }
+
+        for(auto& pointers : channelPointers)
+            streamPointers.push_back(pointers.data());
+
+        auto seconds = Benchmark::bestSeconds([&] { engine.processStreams(streamPointers.data(), numSamples); });
+
+        for(auto& stream : streams)
+            expect(TestSignals::allFinite(stream));
+
+        return streamsPerCore(seconds, numStreams);
+    }
+
+    double measureSeparate(Streams streams, bool limiter)
+    {
+        auto numStreams = static_cast<int>(streams.size());
+        std::vector<std::unique_ptr<MultibandCompressor>> engines;
+
+        for(int s = 0; s < numStreams; ++s)
+        {
+            engines.push_back(std::make_unique<MultibandCompressor>());
+            engines.back()->setParameters(makeParameters(limiter));
+            engines.back()->prepare(sampleRate, blockSize, juce::AudioChannelSet::canonicalChannelSet(static_cast<int>(streams[0].size())), 0, false);
+        }
+
+        auto seconds = Benchmark::bestSeconds([&]
+        {
+            for(size_t s = 0; s < streams.size(); ++s)
+                Benchmark::process(*engines[s], streams[s], blockSize);
+        });
+
+        for(auto& stream : streams)
+            expect(TestSignals::allFinite(stream));
+
+        return streamsPerCore(seconds, numStreams);
+    }
+};
+
+static StreamsBenchmark streamsBenchmark;
@@ -0,0 +1,198 @@
+/*
+  ==============================================================================
+
+    TestSignals.cpp
+
+  ==============================================================================
+*/
+
+#include "TestSignals.h"
+
+namespace TestSignals
+{
+    const char* getName(Kind kind)
+    {
+        switch (kind)
+        {
+            case Kind::sweep: return "sweep";
+            case Kind::noise: return "noise";
+            case Kind::transients: return "transients";
+            case Kind::silence: return "silence";
+            case Kind::denormals: return "denormals";
+        }
+
+        return "";
+    }
+
+    template<typename SampleType>
+    std::vector<SampleType> make(Kind kind, int numSamples, double sampleRate, int seed)
+    {
+        std::vector<SampleType> x(static_cast<size_t>(numSamples), SampleType(0));
+        juce::Random random(seed);
+
+        auto noise = [&random] { return random.nextDouble() * 2.0 - 1.0; };
+
+        auto duration = numSamples / sampleRate;
+        auto clickPeriod = juce::roundToInt(0.1 * sampleRate);
+
+        for( int i = 0; i < numSamples; ++i )
+        {
+            auto t = i / sampleRate;
+            auto& sample = x[static_cast<size_t>(i)];
+
+            switch (kind)
+            {
+                case Kind::sweep:
+                {
+                    auto rate = std::log(1000.0) / duration;
+                    auto phase = juce::MathConstants<double>::twoPi * 20.0 * (std::exp(rate * t) - 1.0) / rate;
+                    sample = static_cast<SampleType>(0.5 * std::sin(phase));
+                    break;
+                }
+                case Kind::noise:
+                    sample = static_cast<SampleType>(0.5 * noise());
+                    break;
+                case Kind::transients:
+                {
+                    auto position = i % clickPeriod;
+
+                    if( position == 0 )
+                        sample = SampleType(0.9);
+                    else
+                        sample = static_cast<SampleType>(0.5 * std::exp(-position / 40.0) * noise());
+                    break;
+                }
+                case Kind::silence:
+                    break;
+                case Kind::denormals:
+                    // the filters and envelopes ring down through the denormal range after the impulse,
+                    // and the noise keeps feeding it
+                    sample = i == 0 ? SampleType(0.5) : static_cast<SampleType>(noise() * std::numeric_limits<SampleType>::min());
+                    break;
+            }
+        }
+
+        return x;
+    }
+
+    template<typename SampleType>
+    std::vector<std::vector<SampleType>> makeChannels(Kind kind, int numChannels, int numSamples, double sampleRate, int seed)
+    {
+        std::vector<std::vector<SampleType>> channels;
+
+        for( int ch = 0; ch < numChannels; ++ch )
+            channels.push_back(make<SampleType>(kind, numSamples, sampleRate, seed + ch));
+
+        return channels;
+    }
+
+    std::vector<int> makeBlockSizes(int numSamples, int maximumBlockSize, bool ragged, int seed)
+    {
+        std::vector<int> blockSizes;
+        juce::Random random(seed);
+
+        for( int start = 0; start < numSamples; )
+        {
+            auto blockSize = ragged ? 1 + random.nextInt(maximumBlockSize) : maximumBlockSize;
+            blockSize = juce::jmin(blockSize, numSamples - start);
+
+            blockSizes.push_back(blockSize);
+            start += blockSize;
+        }
+
+        return blockSizes;
+    }
+
+    template<typename SampleType>
+    bool allFinite(const std::vector<std::vector<SampleType>>& channels)
+    {
+        for( auto& channel : channels )
+        {
+            for( auto sample : channel )
+            {
+                if( ! std::isfinite(sample) )
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    template<typename SampleType>
+    bool areIdentical(const std::vector<std::vector<SampleType>>& a, const std::vector<std::vector<SampleType>>& b)
+    {
+        if( a.size() != b.size() )
+            return false;
+
+        for( size_t ch = 0; ch < a.size(); ++ch )
+        {
+            if( a[ch].size() != b[ch].size() )
+                return false;
+
+            // bit for bit, so -0 and 0 or two NaNs don't pass for each other
+            if( std::memcmp(a[ch].data(), b[ch].data(), a[ch].size() * sizeof(SampleType)) != 0 )
+                return false;
+        }
+
+        return true;
+    }
+
+    template<typename SampleA, typename SampleB>
+    double maxError(const std::vector<std::vector<SampleA>>& a, const std::vector<std::vector<SampleB>>& b, int delaySamples)
+    {
+        double error = 0.0;
+
+        for( size_t ch = 0; ch < a.size(); ++ch )
+        {
+            for( size_t i = 0; i < a[ch].size(); ++i )
+            {
+                auto delayed = i < static_cast<size_t>(delaySamples) ? 0.0 : static_cast<double>(b[ch][i - static_cast<size_t>(delaySamples)]);
+                error = juce::jmax(error, std::abs(static_cast<double>(a[ch][i]) - delayed));
+            }
+        }
+
+        return error;
+    }
+
+    template<typename SampleType>
+    double peak(const std::vector<std::vector<SampleType>>& channels)
+    {
+        double level = 0.0;
+
+        for( auto& channel : channels )
+        {
+            for( auto sample : channel )
+                level = juce::jmax(level, std::abs(static_cast<double>(sample)));
+        }
+
+        return level;
+    }
+
+    std::vector<CpuDispatch::InstructionSet> getInstructionSets()
+    {
+        std::vector<CpuDispatch::InstructionSet> instructionSets;
+
+        for( auto instructionSet : { CpuDispatch::InstructionSet::baseline, CpuDispatch::InstructionSet::avx2, CpuDispatch::InstructionSet::avx512 } )
+        {
+            if( CpuDispatch::isAvailable(instructionSet) )
+                instructionSets.push_back(instructionSet);
+        }
+
+        return instructionSets;
+    }
+
+    template std::vector<float> make<float>(Kind, int, double, int);
+    template std::vector<double> make<double>(Kind, int, double, int);
+    template std::vector<std::vector<float>> makeChannels<float>(Kind, int, int, double, int);
+    template std::vector<std::vector<double>> makeChannels<double>(Kind, int, int, double, int);
+    template bool allFinite<float>(const std::vector<std::vector<float>>&);
+    template bool allFinite<double>(const std::vector<std::vector<double>>&);
+    template bool areIdentical<float>(const std::vector<std::vector<float>>&, const std::vector<std::vector<float>>&);
+    template bool areIdentical<double>(const std::vector<std::vector<double>>&, const std::vector<std::vector<double>>&);
+    template double maxError<float, float>(const std::vector<std::vector<float>>&, const std::vector<std::vector<float>>&, int);
+    template double maxError<float, double>(const std::vector<std::vector<float>>&, const std::vector<std::vector<double>>&, int);
+    template double maxError<double, float>(const std::vector<std::vector<double>>&, const std::vector<std::vector<float>>&, int);
+    template double maxError<double, double>(const std::vector<std::vector<double>>&, const std::vector<std::vector<double>>&, int);
+    template double peak<float>(const std::vector<std::vector<float>>&);
+    template double peak<double>(const std::vector<std::vector<double>>&);
+}
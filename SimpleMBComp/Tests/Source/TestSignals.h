@@ -0,0 +1,58 @@
+/*
+  ==============================================================================
+
+    TestSignals.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../Source/DSP/CpuDispatch.h"
+
+/*
+ The inputs every optimised path is run over, and the measures the tests hold them to.
+ Everything is generated from a seed, so a failure reproduces exactly.
+ */
+namespace TestSignals
+{
+    enum class Kind
+    {
+        sweep,      // log sine sweep, 20 Hz to 20 kHz over the whole signal
+        noise,      // white, at mix bus level
+        transients, // a click every 100 ms with a short noise tail
+        silence,
+        denormals,  // an impulse, then noise below the smallest normal number
+    };
+
+    constexpr std::array<Kind, 5> allKinds { Kind::sweep, Kind::noise, Kind::transients, Kind::silence, Kind::denormals };
+
+    const char* getName(Kind kind);
+
+    template<typename SampleType>
+    std::vector<SampleType> make(Kind kind, int numSamples, double sampleRate, int seed);
+
+    // each channel with its own seed, so linked and unlinked paths see different material per channel
+    template<typename SampleType>
+    std::vector<std::vector<SampleType>> makeChannels(Kind kind, int numChannels, int numSamples, double sampleRate, int seed);
+
+    // block sizes that add up to numSamples: all maximumBlockSize, or random ones up to it when ragged
+    std::vector<int> makeBlockSizes(int numSamples, int maximumBlockSize, bool ragged, int seed);
+
+    template<typename SampleType>
+    bool allFinite(const std::vector<std::vector<SampleType>>& channels);
+
+    template<typename SampleType>
+    bool areIdentical(const std::vector<std::vector<SampleType>>& a, const std::vector<std::vector<SampleType>>& b);
+
+    // largest |a - b| over every channel, with b delayed by delaySamples (the samples before it compare against 0)
+    template<typename SampleA, typename SampleB>
+    double maxError(const std::vector<std::vector<SampleA>>& a, const std::vector<std::vector<SampleB>>& b, int delaySamples = 0);
+
+    template<typename SampleType>
+    double peak(const std::vector<std::vector<SampleType>>& channels);
+
+    // every instruction set this machine can run, each optimised path is tested on all of them
+    std::vector<CpuDispatch::InstructionSet> getInstructionSets();
+}
@@ -0,0 +1,82 @@
+/*
+  ==============================================================================
+
+    ThreadScalingBenchmark.cpp
+
+  ==============================================================================
+*/
+
+#include "Benchmark.h"
+#include "TestSignals.h"
+
+/*
+ Parallel processing on the bus it's for, 7.1.4 at 192 kHz, from the audio thread alone up to
+ one thread per core. The shared worker pool is started here with each count before the engine
+ asks for it, and the engine takes it as it finds it, the way a second instance would.
+ */
+class ThreadScalingBenchmark : public juce::UnitTest
+{
+public:
+    ThreadScalingBenchmark() : juce::UnitTest("Thread scaling", "Benchmarks") {}
+
+    void runTest() override
+    {
+        auto maxThreads = juce::SystemStats::getNumCpus();
+
+        for(auto blockSize : { 256, 1024 })
+        {
+            beginTest("7.1.4 at 192 kHz, " + juce::String(blockSize) + " sample blocks, 1 to " + juce::String(maxThreads) + " threads");
+
+            auto channelSet = juce::AudioChannelSet::create7point1point4();
+            auto input = TestSignals::makeChannels<float>(TestSignals::Kind::noise, channelSet.size(), numSamples, sampleRate, 28);
+            auto oneThread = 0.0;
+
+            for(int numThreads = 1; numThreads <= maxThreads; ++numThreads)
+            {
+                auto speed = measure(input, channelSet, blockSize, numThreads - 1);
+
+                if( numThreads == 1 )
+                    oneThread = speed;
+
+                logMessage(juce::String(numThreads) + (numThreads == 1 ? " thread: " : " threads: ") + Benchmark::describe(speed)
+                           + ", " + juce::String(speed / oneThread, 2) + "x one thread");
+            }
+        }
+    }
+private:
+    static constexpr double sampleRate = 192000.0;
+    static constexpr int numSamples = 192000;
+
+    double measure(std::vector<std::vector<float>> channels, const juce::AudioChannelSet& channelSet, int blockSize, int numWorkers)
+    {
+        juce::SharedResourcePointer<SharedDsp> sharedDsp;
+
+        if( numWorkers > 0 )
+            sharedDsp->acquireWorkerPool(numWorkers, sampleRate, blockSize);
+
+        auto seconds = 0.0;
+
+        {
+            MultibandCompressor::Parameters parameters;
+            parameters.parallelProcessing = numWorkers > 0;
+
+            for(auto& band : parameters.bands)
+                band.thresholdDecibels = -24.f;
+
+            MultibandCompressor engine;
+            engine.setParameters(parameters);
+            engine.prepare(sampleRate, blockSize, channelSet, 0, false);
+
+            // the same audio goes round again on every run, the engine just carries on
+            seconds = Benchmark::bestSeconds([&] { Benchmark::process(engine, channels, blockSize); });
+            expect(TestSignals::allFinite(channels));
+        }
+
+        if( numWorkers > 0 )
+            sharedDsp->releaseWorkerPool();
+
+        return Benchmark::realtimeFactor(seconds, numSamples, sampleRate);
+    }
+};
+
+static ThreadScalingBenchmark threadScalingBenchmark;
@@ -0,0 +1,198 @@
+/*
+  ==============================================================================
+
+    TrimBenchmark.cpp
+
+  ==============================================================================
+*/
+
+#include "Benchmark.h"
+#include "TestSignals.h"
+#include "ReferenceChain.h"
+#include "../../Source/DSP/Crossover.h"
+
+/*
+ The input trim folded into the crossover's first read against the two passes it replaced:
+ juce::dsp::Gain over the host buffer in place, then the split. The split after the gain pass
+ is timed both as the crossover at 0 dB, so only the extra pass differs, and as splitBands(),
+ the whole path as it was. Stereo, with the trim held and with it moving every 100 blocks so
+ the ramp runs part of the time. Every path gets the block copied in first, the way a host
+ hands it over, so the gain pass has a buffer of its own to write.
+ */
+class TrimBenchmark : public juce::UnitTest
+{
+public:
+    TrimBenchmark() : juce::UnitTest("Input trim", "Benchmarks") {}
+
+    void runTest() override
+    {
+        juce::ScopedNoDenormals noDenormals;
+
+        for(auto blockSize : { 64, 512 })
+        {
+            beginTest("Trim and split, " + juce::String(blockSize) + " sample blocks");
+
+            auto input = TestSignals::makeChannels<float>(TestSignals::Kind::noise, numChannels, numSamples, sampleRate, 44);
+
+            for(auto moving : { false, true })
+            {
+                auto fused = measureFused(input, blockSize, moving);
+                auto twoPass = measureTwoPass(input, blockSize, moving);
+                auto reference = measureReference(input, blockSize, moving);
+
+                logMessage(juce::String(moving ? "moving" : "held") + " trim: " + Benchmark::describe(fused)
+                           + " against " + Benchmark::describe(twoPass) + " with a gain pass, " + juce::String(fused / twoPass, 2)
+                           + "x, and " + Benchmark::describe(reference) + " through splitBands(), " + juce::String(fused / reference, 2) + "x");
+            }
+        }
+    }
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int numSamples = 480000;
+    static constexpr int numChannels = 2;
+    static constexpr double rampSeconds = 0.05;
+
+    static float getTrimDecibels(int block, bool moving)
+    {
+        if( ! moving )
+            return -6.f;
+
+        return (block / 100) % 2 == 0 ? -6.f : 3.f;
+    }
+
+    static juce::dsp::ProcessSpec makeSpec(int blockSize)
+    {
+        juce::dsp::ProcessSpec spec;
+        spec.sampleRate = sampleRate;
+        spec.maximumBlockSize = static_cast<juce::uint32>(blockSize);
+        spec.numChannels = static_cast<juce::uint32>(numChannels);
+        return spec;
+    }
+
+    static bool allFinite(const std::array<juce::AudioBuffer<float>, 3>& bands)
+    {
+        for(auto& band : bands)
+        {
+            for(int ch = 0; ch < band.getNumChannels(); ++ch)
+            {
+                for(int i = 0; i < band.getNumSamples(); ++i)
+                {
+                    if( ! std::isfinite(band.getReadPointer(ch)[i]) )
+                        return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    struct PreparedCrossover
+    {
+        explicit PreparedCrossover(int blockSize)
+        {
+            auto spec = makeSpec(blockSize);
+            arena.build([this, &spec](Arena& a) { crossover.allocate(a, spec); });
+            crossover.prepare(spec);
+            crossover.setInstructionSet(CpuDispatch::getInstructionSet());
+            crossover.setInputGainRampDurationSeconds(rampSeconds);
+            crossover.setInputGainDecibels(0.f);
+
+            for(auto& band : bands)
+                band.setSize(numChannels, blockSize);
+        }
+
+        Arena arena;
+        Crossover<float> crossover;
+        std::array<juce::AudioBuffer<float>, 3> bands;
+    };
+
+    // the host's block: each pass calls process with the next one copied in
+    template<typename Process>
+    static double time(const std::vector<std::vector<float>>& input, int blockSize, Process&& process)
+    {
+        juce::AudioBuffer<float> block(numChannels, blockSize);
+
+        auto seconds = Benchmark::bestSeconds([&]
+        {
+            for(int start = 0, index = 0; start + blockSize <= numSamples; start += blockSize, ++index)
+            {
+                for(int ch = 0; ch < numChannels; ++ch)
+                    block.copyFrom(ch, 0, input[static_cast<size_t>(ch)].data() + start, blockSize);
+
+                process(block, index);
+            }
+        });
+
+        return Benchmark::realtimeFactor(seconds, numSamples, sampleRate);
+    }
+
+    double measureFused(const std::vector<std::vector<float>>& input, int blockSize, bool moving)
+    {
+        PreparedCrossover prepared(blockSize);
+
+        auto speed = time(input, blockSize, [&](juce::AudioBuffer<float>& block, int index)
+        {
+            prepared.crossover.setInputGainDecibels(getTrimDecibels(index, moving));
+            prepared.crossover.process(block, prepared.bands);
+        });
+
+        expect(allFinite(prepared.bands));
+
+        return speed;
+    }
+
+    static void prepareGain(juce::dsp::Gain<float>& gain, int blockSize)
+    {
+        gain.prepare(makeSpec(blockSize));
+        gain.setRampDurationSeconds(rampSeconds);
+    }
+
+    static void applyGain(juce::dsp::Gain<float>& gain, juce::AudioBuffer<float>& block, float decibels)
+    {
+        gain.setGainDecibels(decibels);
+
+        juce::dsp::AudioBlock<float> audioBlock(block);
+        gain.process(juce::dsp::ProcessContextReplacing<float>(audioBlock));
+    }
+
+    double measureTwoPass(const std::vector<std::vector<float>>& input, int blockSize, bool moving)
+    {
+        PreparedCrossover prepared(blockSize);
+        juce::dsp::Gain<float> gain;
+        prepareGain(gain, blockSize);
+
+        auto speed = time(input, blockSize, [&](juce::AudioBuffer<float>& block, int index)
+        {
+            applyGain(gain, block, getTrimDecibels(index, moving));
+            prepared.crossover.process(block, prepared.bands);
+        });
+
+        expect(allFinite(prepared.bands));
+
+        return speed;
+    }
+
+    double measureReference(const std::vector<std::vector<float>>& input, int blockSize, bool moving)
+    {
+        ReferenceChain<float> reference;
+        reference.prepare(sampleRate, blockSize, numChannels);
+        reference.setParameters(MultibandCompressor::Parameters());
+
+        juce::dsp::Gain<float> gain;
+        prepareGain(gain, blockSize);
+
+        const std::array<juce::AudioBuffer<float>, 3>* bands = nullptr;
+
+        auto speed = time(input, blockSize, [&](juce::AudioBuffer<float>& block, int index)
+        {
+            applyGain(gain, block, getTrimDecibels(index, moving));
+            bands = &reference.split(block);
+        });
+
+        expect(allFinite(*bands));
+
+        return speed;
+    }
+};
+
+static TrimBenchmark trimBenchmark;